@@ -16,6 +16,11 @@ typedef struct fs_emu_buffer {
     //int buffer_width;
     //int buffer_height;
     char line[FS_EMU_MAX_LINES];
+    // lines which differ from the buffer with sequence number dirty_seq
+    // (all lines are dirty when dirty_seq is -1)
+    char dirty[FS_EMU_MAX_LINES];
+    int dirty_seq;
+    int dirty_count;
     int flags;
 } fs_emu_buffer;
 
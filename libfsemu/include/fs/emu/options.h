@@ -7,7 +7,9 @@
 #define OPTION_FULLSCREEN "fullscreen"
 #define OPTION_FULLSCREEN_MODE "fullscreen_mode"
 #define OPTION_NOTIFICATION_DURATION "notification_duration"
+#define OPTION_SCREENSHOTS_INTERVAL "screenshots_interval"
 #define OPTION_SCREENSHOTS_OUTPUT_DIR "screenshots_output_dir"
+#define OPTION_SCREENSHOTS_OUTPUT_FORMAT "screenshots_output_format"
 #define OPTION_STDOUT "stdout"
 #define OPTION_SCALE "scale"
 #define OPTION_STRETCH "stretch"
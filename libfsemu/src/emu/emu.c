@@ -37,6 +37,7 @@
 #include "input.h"
 #include "libfsemu.h"
 #include "netplay.h"
+#include "screenshot.h"
 #include "theme.h"
 #include "video.h"
 
@@ -480,6 +481,7 @@ int fs_emu_run(fs_emu_main_function function)
 #endif
 
     fs_emu_audio_shutdown();
+    fs_emu_screenshot_shutdown();
     fse_log("[FSE] Returning from fs_emu_run\n");
     return result;
 }
@@ -33,6 +33,7 @@
 #include "hud.h"
 #include "menu.h"
 #include "scanlines.h"
+#include "screenshot.h"
 #include "texture.h"
 #include "theme.h"
 #include "util.h"
@@ -69,6 +70,15 @@ static int g_texture_filter = GL_LINEAR;
 static int g_frame_texture_black_left = 100000;
 static int g_frame_texture_black_top = 100000;
 
+// sequence number and source rectangle of the video buffer currently
+// uploaded to g_frame_texture (-1 when the texture content is unknown)
+static int g_frame_texture_seq = -1;
+static int g_frame_texture_upload_x = 0;
+static int g_frame_texture_upload_y = 0;
+static int g_frame_texture_upload_w = 0;
+static int g_frame_texture_upload_h = 0;
+static int g_frame_texture_source_width = 0;
+
 // crop coordinates of emulator video frame
 static fs_emu_rect g_crop = {};
 
@@ -152,6 +162,7 @@ static void context_notification_handler(int notification, void *data)
             CHECK_GL_ERROR();
             g_frame_texture = 0;
         }
+        g_frame_texture_seq = -1;
     }
     else if (notification == FS_GL_CONTEXT_CREATE) {
         setup_opengl();
@@ -268,6 +279,22 @@ static void create_texture_if_needed(int width, int height)
     // blanks the border if necessary
     g_frame_texture_black_left = 100000;
     g_frame_texture_black_top = 100000;
+    g_frame_texture_seq = -1;
+}
+
+static void upload_texture_lines(uint8_t *start, int width, int upload_w,
+        int bpp, int first, int count, int format, int type)
+{
+    uint8_t *data = start + first * width * bpp;
+#ifdef USE_GLES
+    /* we don't have unpack padding in GLES. uploading full width lines instead */
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first, width, count,
+            format, type, data);
+#else
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first, upload_w, count,
+            format, type, data);
+#endif
+    CHECK_GL_ERROR();
 }
 
 static void fix_border(fs_emu_video_buffer *buffer, int *upload_x,
@@ -333,91 +360,79 @@ static void fix_border(fs_emu_video_buffer *buffer, int *upload_x,
     *upload_h = uh;
 }
 
-#define R5G6B5_MASK_R 0xf800
-#define R5G6B5_MASK_G 0x07e0
-#define R5G6B5_MASK_B 0x001f
-#define R5G6B5_SHIFT_R 11
-#define R5G6B5_SHIFT_G 5
-#define R5G6B5_SHIFT_B 0
-
-#define R5G5B5A1_MASK_R 0xf800
-#define R5G5B5A1_MASK_G 0x07c0
-#define R5G5B5A1_MASK_B 0x003e
-#define R5G5B5A1_SHIFT_R 11
-#define R5G5B5A1_SHIFT_G 6
-#define R5G5B5A1_SHIFT_B 1
-
-static void save_screenshot(const char *path, int cx, int cy, int cw, int ch,
-        int count, uint8_t *frame, int frame_width, int frame_height,
-        int frame_bpp)
-{
-    fs_log("writing screenshot to %s\n", path);
-
-    uint8_t *out_data = malloc(cw * ch * 3);
-    int row_len = cw * frame_bpp;
-    int frame_format = fs_emu_get_video_format();
+static char *g_screenshots_dir = NULL;
+static char *g_screenshots_prefix = NULL;
+static const char *g_screenshots_ext = "png";
+static int g_screenshots_mask = 7;
+static int g_screenshots_interval = -1;
+static int g_screenshots_interval_missed = 0;
 
-    for (int y = 0; y < ch; y++) {
-        uint8_t *ip = frame + ((cy + y) * frame_width + cx) * frame_bpp;
-        uint8_t *op = out_data + y * cw * 3;
-        if (frame_format == FS_EMU_VIDEO_FORMAT_BGRA) {
-            for (int x = 0; x < row_len; x += frame_bpp) {
-#ifdef WORDS_BIGENDIAN
-                *op++ = ip[x + 1];
-                *op++ = ip[x + 2];
-                *op++ = ip[x + 3];
-#else
-                *op++ = ip[x + 2];
-                *op++ = ip[x + 1];
-                *op++ = ip[x + 0];
-#endif
-            }
-        }
-        else if (frame_format == FS_EMU_VIDEO_FORMAT_RGBA) {
-            for (int x = 0; x < row_len; x += frame_bpp) {
-                *op++ = ip[x + 0];
-                *op++ = ip[x + 1];
-                *op++ = ip[x + 2];
-            }
+// Only reads the option, the rest of the screenshot configuration (which
+// checks the output directory) is loaded when something is captured.
+static int screenshots_interval(void)
+{
+    if (g_screenshots_interval < 0) {
+        g_screenshots_interval = fs_config_get_int(
+                OPTION_SCREENSHOTS_INTERVAL);
+        if (g_screenshots_interval == FS_CONFIG_NONE ||
+                g_screenshots_interval < 0) {
+            g_screenshots_interval = 0;
         }
-        else if (frame_format == FS_EMU_VIDEO_FORMAT_R5G6B5) {
-            for (int x = 0; x < row_len; x += frame_bpp) {
-                unsigned short *p = (unsigned short *) (ip + x);
-                unsigned char c;
-                c = (*p & R5G6B5_MASK_R) >> R5G6B5_SHIFT_R;
-                *op++ = (c << 3) | (c >> 2);
-                c = (*p & R5G6B5_MASK_G) >> R5G6B5_SHIFT_G;
-                *op++ = (c << 2) | (c >> 4);
-                c = (*p & R5G6B5_MASK_B) >> R5G6B5_SHIFT_B;
-                *op++ = (c << 3) | (c >> 2);
-            }
+    }
+    return g_screenshots_interval;
+}
+
+static void load_screenshot_config(void)
+{
+    if (g_screenshots_dir != NULL) {
+        return;
+    }
+    char *path = fs_config_get_string(OPTION_SCREENSHOTS_OUTPUT_DIR);
+    if (path) {
+        path = fs_emu_path_expand_and_free(path);
+        if (fs_path_exists(path)) {
+            g_screenshots_dir = path;
         }
-        else if (frame_format == FS_EMU_VIDEO_FORMAT_R5G5B5A1) {
-            for (int x = 0; x < row_len; x += frame_bpp) {
-                unsigned short *p = (unsigned short *) (ip + x);
-                unsigned char c;
-                c = (*p & R5G5B5A1_MASK_R) >> R5G5B5A1_SHIFT_R;
-                *op++ = (c << 3) | (c >> 2);
-                c = (*p & R5G5B5A1_MASK_G) >> R5G5B5A1_SHIFT_G;
-                *op++ = (c << 3) | (c >> 2);
-                c = (*p & R5G5B5A1_MASK_B) >> R5G5B5A1_SHIFT_B;
-                *op++ = (c << 3) | (c >> 2);
-            }
+        else {
+            fs_emu_warning("Directory does not exist: %s", path);
+            g_free(path);
         }
     }
+    if (!g_screenshots_dir) {
+        g_screenshots_dir = g_strdup(fs_get_desktop_dir());
+    }
+    g_screenshots_mask = fs_config_get_int("screenshots_output_mask");
+    if (g_screenshots_mask == FS_CONFIG_NONE) {
+        g_screenshots_mask = 7;
+    }
 
-    int result = fs_image_save_data(path, out_data, cw, ch, 3);
-    if (result) {
-        fs_log("saved screenshot\n");
+    g_screenshots_prefix = fs_config_get_string(
+            "screenshots_output_prefix");
+    if (!g_screenshots_prefix) {
+        g_screenshots_prefix = g_strdup("fs-uae");
     }
-    else {
-        fs_log("error saving screenshot\n");
+
+    const char *format = fs_config_get_const_string(
+            OPTION_SCREENSHOTS_OUTPUT_FORMAT);
+    if (format && strcmp(format, "ppm") == 0) {
+        g_screenshots_ext = "ppm";
     }
-    free(out_data);
-#if 0
-    free(name);
-    free(path);
-#endif
+}
+
+static void save_screenshot(const char *type, const char *suffix, int cx,
+        int cy, int cw, int ch, uint8_t *frame, int frame_width, int frame_bpp)
+{
+    char *name = g_strdup_printf("%s-%s-%s.%s", g_screenshots_prefix, type,
+            suffix, g_screenshots_ext);
+    char *path = g_build_filename(g_screenshots_dir, name, NULL);
+    if (g_fs_emu_screenshot) {
+        // Not logged for screenshots_interval captures
+        fs_log("writing screenshot to %s\n", path);
+    }
+    fs_emu_screenshot_queue(path, frame, frame_width, frame_bpp,
+            cx, cy, cw, ch);
+    g_free(path);
+    g_free(name);
 }
 
 static int update_texture(void)
@@ -439,6 +454,7 @@ static int update_texture(void)
     }
     int is_new_frame = 1;
     static int last_seq_no = -1;
+    int prev_seq_no = last_seq_no;
     if (buffer->seq == last_seq_no + 1) {
         // normal
     }
@@ -457,6 +473,7 @@ static int update_texture(void)
         //fs_log("lost %d frame(s)\n", lost_frame_count);
     }
     last_seq_no = buffer->seq;
+    int is_repeated_frame = !is_new_frame;
 
     is_new_frame = 1;
 
@@ -486,35 +503,7 @@ static int update_texture(void)
     // (keyboard shortcut), but screenshot is saved here, as soon as possible.
 
     if (g_fs_emu_screenshot > 0) {
-        static char* screenshots_dir = NULL;
-        static char* screenshots_prefix = NULL;
-        static int screenshots_mask = 7;
-        if (screenshots_dir == NULL) {
-            char *path = fs_config_get_string(OPTION_SCREENSHOTS_OUTPUT_DIR);
-            if (path) {
-                path = fs_emu_path_expand_and_free(path);
-                if (fs_path_exists(path)) {
-                    screenshots_dir = path;
-                }
-                else {
-                    fs_emu_warning("Directory does not exist: %s", path);
-                    g_free(path);
-                }
-            }
-            if (!screenshots_dir) {
-                screenshots_dir = g_strdup(fs_get_desktop_dir());
-            }
-            screenshots_mask = fs_config_get_int("screenshots_output_mask");
-            if (screenshots_mask == FS_CONFIG_NONE) {
-                screenshots_mask = 7;
-            }
-
-            screenshots_prefix = fs_config_get_string(
-                    "screenshots_output_prefix");
-            if (!screenshots_prefix) {
-                screenshots_prefix = g_strdup("fs-uae");
-            }
-        }
+        load_screenshot_config();
 
         static int total_count = 0;
         if (g_fs_emu_screenshot == 1) {
@@ -538,28 +527,20 @@ static int update_texture(void)
             count += 1;
             total_count += 1;
 
-            if (screenshots_mask & 1) {
-                name = g_strdup_printf("%s-%s-%s-%02d.png",
-                        screenshots_prefix, "full", strbuf, count);
-                path = g_build_filename(screenshots_dir, name, NULL);
-                save_screenshot(path, 0, 0, width, height, count, frame,
-                        width, height, bpp);
-                g_free(path);
-                g_free(name);
+            char suffix[32];
+            snprintf(suffix, sizeof(suffix), "%s-%02d", strbuf, count);
+            if (g_screenshots_mask & 1) {
+                save_screenshot("full", suffix, 0, 0, width, height, frame,
+                        width, bpp);
             }
-            if (screenshots_mask & 2) {
-                name = g_strdup_printf("%s-%s-%s-%02d.png",
-                        screenshots_prefix, "crop", strbuf, count);
-                path = g_build_filename(screenshots_dir, name, NULL);
-                save_screenshot(path, g_crop.x, g_crop.y, g_crop.w, g_crop.h,
-                        count, frame, width, height, bpp);
-                g_free(path);
-                g_free(name);
+            if (g_screenshots_mask & 2) {
+                save_screenshot("crop", suffix, g_crop.x, g_crop.y, g_crop.w,
+                        g_crop.h, frame, width, bpp);
             }
-            if (screenshots_mask & 4) {
+            if (g_screenshots_mask & 4) {
                 name = g_strdup_printf("%s-%s-%s-%02d.png",
-                        screenshots_prefix, "real", strbuf, count);
-                path = g_build_filename(screenshots_dir, name, NULL);
+                        g_screenshots_prefix, "real", strbuf, count);
+                path = g_build_filename(g_screenshots_dir, name, NULL);
                 fs_ml_video_screenshot(path);
                 g_free(path);
                 g_free(name);
@@ -578,6 +559,42 @@ static int update_texture(void)
         }
     }
 
+    // With screenshots_interval set, every n-th frame is saved (numbered by
+    // frame sequence number), e.g. for automated comparison of the output.
+
+    if (!is_repeated_frame && screenshots_interval() > 0) {
+        int interval = g_screenshots_interval;
+        if (prev_seq_no >= 0 && buffer->seq > prev_seq_no + 1) {
+            // Lost frames never reach us and cannot be captured. Drops
+            // due to a full queue are logged by fs_emu_screenshot_queue.
+            int missed = (buffer->seq - 1) / interval -
+                    prev_seq_no / interval;
+            if (missed > 0) {
+                int before = g_screenshots_interval_missed;
+                g_screenshots_interval_missed += missed;
+                if (before == 0 || before / 100 !=
+                        g_screenshots_interval_missed / 100) {
+                    fs_log("screenshots_interval: %d frame(s) to capture "
+                            "were lost before rendering\n",
+                            g_screenshots_interval_missed);
+                }
+            }
+        }
+        if (buffer->seq % interval == 0) {
+            load_screenshot_config();
+            char suffix[32];
+            snprintf(suffix, sizeof(suffix), "%08d", buffer->seq);
+            if (g_screenshots_mask & 1) {
+                save_screenshot("full", suffix, 0, 0, width, height, frame,
+                        width, bpp);
+            }
+            if (g_screenshots_mask & 2) {
+                save_screenshot("crop", suffix, g_crop.x, g_crop.y, g_crop.w,
+                        g_crop.h, frame, width, bpp);
+            }
+        }
+    }
+
     int upload_x, upload_y, upload_w, upload_h;
     g_effective_viewport_mode = g_viewport_mode;
     if (buffer->flags & FS_EMU_FORCE_VIEWPORT_CROP_FLAG) {
@@ -642,16 +659,48 @@ static int update_texture(void)
 
     uint8_t *gl_buffer_start = frame + ((upload_y * width) + upload_x) * bpp;
 
-#ifdef USE_GLES
-    /* we don't have unpack padding in GLES. uploading full width lines instead */
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, upload_h,
-            gl_buffer_format, gl_buffer_type, gl_buffer_start);
-#else
+    // the texture can be updated incrementally only if it contains the
+    // buffer which the dirty lines were computed against, uploaded from
+    // the same source rectangle (the filters always process entire frames)
+    if (filter || upload_x != g_frame_texture_upload_x ||
+            upload_y != g_frame_texture_upload_y ||
+            upload_w != g_frame_texture_upload_w ||
+            upload_h != g_frame_texture_upload_h ||
+            width != g_frame_texture_source_width ||
+            upload_y + upload_h > FS_EMU_MAX_LINES) {
+        g_frame_texture_seq = -1;
+    }
+
+#ifndef USE_GLES
     fs_gl_unpack_row_length(width);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, upload_w, upload_h,
-            gl_buffer_format, gl_buffer_type, gl_buffer_start);
 #endif
-    CHECK_GL_ERROR();
+    if (g_frame_texture_seq != -1 && buffer->seq == g_frame_texture_seq) {
+        // the texture already contains this frame
+    } else if (g_frame_texture_seq != -1 &&
+            buffer->dirty_seq == g_frame_texture_seq) {
+        int y = 0;
+        while (y < upload_h) {
+            if (!buffer->dirty[upload_y + y]) {
+                y++;
+                continue;
+            }
+            int first = y;
+            while (y < upload_h && buffer->dirty[upload_y + y]) {
+                y++;
+            }
+            upload_texture_lines(gl_buffer_start, width, upload_w, bpp,
+                    first, y - first, gl_buffer_format, gl_buffer_type);
+        }
+    } else {
+        upload_texture_lines(gl_buffer_start, width, upload_w, bpp,
+                0, upload_h, gl_buffer_format, gl_buffer_type);
+    }
+    g_frame_texture_seq = filter ? -1 : buffer->seq;
+    g_frame_texture_upload_x = upload_x;
+    g_frame_texture_upload_y = upload_y;
+    g_frame_texture_upload_w = upload_w;
+    g_frame_texture_upload_h = upload_h;
+    g_frame_texture_source_width = width;
 
     int update_black_border = 1;
     if (update_black_border) {
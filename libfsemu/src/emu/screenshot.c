@@ -0,0 +1,235 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fs/emu.h>
+#include <fs/emu/video.h>
+#include <fs/glib.h>
+#include <fs/image.h>
+#include <fs/log.h>
+#include <fs/thread.h>
+
+#include "screenshot.h"
+
+// Screenshots are encoded on a worker thread, so saving them (possibly on
+// every frame) does not cause frame drops on the render thread. The queue
+// is bounded; when the worker falls behind, new screenshots are dropped
+// instead of blocking rendering.
+
+#define SCREENSHOT_QUEUE_SIZE 16
+
+typedef struct screenshot_job {
+    char *path;
+    int format;
+    int width;
+    int height;
+    int bpp;
+    uint8_t *data;
+} screenshot_job;
+
+static struct {
+    fs_thread *thread;
+    fs_mutex *mutex;
+    fs_condition *condition;
+    screenshot_job *queue[SCREENSHOT_QUEUE_SIZE];
+    int head;
+    int count;
+    int quit;
+    int dropped;
+} g_screenshot;
+
+#define R5G6B5_MASK_R 0xf800
+#define R5G6B5_MASK_G 0x07e0
+#define R5G6B5_MASK_B 0x001f
+#define R5G6B5_SHIFT_R 11
+#define R5G6B5_SHIFT_G 5
+#define R5G6B5_SHIFT_B 0
+
+#define R5G5B5A1_MASK_R 0xf800
+#define R5G5B5A1_MASK_G 0x07c0
+#define R5G5B5A1_MASK_B 0x003e
+#define R5G5B5A1_SHIFT_R 11
+#define R5G5B5A1_SHIFT_G 6
+#define R5G5B5A1_SHIFT_B 1
+
+static void convert_to_rgb(screenshot_job *job, uint8_t *out_data)
+{
+    int row_len = job->width * job->bpp;
+    for (int y = 0; y < job->height; y++) {
+        uint8_t *ip = job->data + y * row_len;
+        uint8_t *op = out_data + y * job->width * 3;
+        if (job->format == FS_EMU_VIDEO_FORMAT_BGRA) {
+            for (int x = 0; x < row_len; x += job->bpp) {
+#ifdef WORDS_BIGENDIAN
+                *op++ = ip[x + 1];
+                *op++ = ip[x + 2];
+                *op++ = ip[x + 3];
+#else
+                *op++ = ip[x + 2];
+                *op++ = ip[x + 1];
+                *op++ = ip[x + 0];
+#endif
+            }
+        }
+        else if (job->format == FS_EMU_VIDEO_FORMAT_RGBA) {
+            for (int x = 0; x < row_len; x += job->bpp) {
+                *op++ = ip[x + 0];
+                *op++ = ip[x + 1];
+                *op++ = ip[x + 2];
+            }
+        }
+        else if (job->format == FS_EMU_VIDEO_FORMAT_R5G6B5) {
+            for (int x = 0; x < row_len; x += job->bpp) {
+                unsigned short *p = (unsigned short *) (ip + x);
+                unsigned char c;
+                c = (*p & R5G6B5_MASK_R) >> R5G6B5_SHIFT_R;
+                *op++ = (c << 3) | (c >> 2);
+                c = (*p & R5G6B5_MASK_G) >> R5G6B5_SHIFT_G;
+                *op++ = (c << 2) | (c >> 4);
+                c = (*p & R5G6B5_MASK_B) >> R5G6B5_SHIFT_B;
+                *op++ = (c << 3) | (c >> 2);
+            }
+        }
+        else if (job->format == FS_EMU_VIDEO_FORMAT_R5G5B5A1) {
+            for (int x = 0; x < row_len; x += job->bpp) {
+                unsigned short *p = (unsigned short *) (ip + x);
+                unsigned char c;
+                c = (*p & R5G5B5A1_MASK_R) >> R5G5B5A1_SHIFT_R;
+                *op++ = (c << 3) | (c >> 2);
+                c = (*p & R5G5B5A1_MASK_G) >> R5G5B5A1_SHIFT_G;
+                *op++ = (c << 3) | (c >> 2);
+                c = (*p & R5G5B5A1_MASK_B) >> R5G5B5A1_SHIFT_B;
+                *op++ = (c << 3) | (c >> 2);
+            }
+        }
+    }
+}
+
+static int save_ppm(const char *path, uint8_t *data, int width, int height)
+{
+    FILE *f = g_fopen(path, "wb");
+    if (f == NULL) {
+        return 0;
+    }
+    fprintf(f, "P6\n%d %d\n255\n", width, height);
+    int result = fwrite(data, width * 3, height, f) == (size_t) height;
+    if (fclose(f) != 0) {
+        result = 0;
+    }
+    return result;
+}
+
+static void save_screenshot(screenshot_job *job)
+{
+    uint8_t *out_data = g_malloc(job->width * job->height * 3);
+    convert_to_rgb(job, out_data);
+    int result;
+    if (g_str_has_suffix(job->path, ".ppm")) {
+        result = save_ppm(job->path, out_data, job->width, job->height);
+    } else {
+        result = fs_image_save_data(job->path, out_data, job->width,
+                job->height, 3);
+    }
+    if (!result) {
+        fs_log("error saving screenshot %s\n", job->path);
+    }
+    g_free(out_data);
+}
+
+static void *screenshot_thread(void *data)
+{
+    fs_mutex_lock(g_screenshot.mutex);
+    while (1) {
+        while (g_screenshot.count == 0 && !g_screenshot.quit) {
+            fs_condition_wait(g_screenshot.condition, g_screenshot.mutex);
+        }
+        if (g_screenshot.count == 0) {
+            break;
+        }
+        screenshot_job *job = g_screenshot.queue[g_screenshot.head];
+        g_screenshot.head = (g_screenshot.head + 1) % SCREENSHOT_QUEUE_SIZE;
+        g_screenshot.count--;
+        fs_mutex_unlock(g_screenshot.mutex);
+
+        save_screenshot(job);
+        g_free(job->data);
+        g_free(job->path);
+        g_free(job);
+
+        fs_mutex_lock(g_screenshot.mutex);
+    }
+    fs_mutex_unlock(g_screenshot.mutex);
+    return NULL;
+}
+
+int fs_emu_screenshot_queue(const char *path, const uint8_t *frame,
+        int frame_width, int frame_bpp, int cx, int cy, int cw, int ch)
+{
+    if (cw <= 0 || ch <= 0) {
+        return 0;
+    }
+    if (g_screenshot.thread == NULL) {
+        g_screenshot.mutex = fs_mutex_create();
+        g_screenshot.condition = fs_condition_create();
+        g_screenshot.thread = fs_thread_create(
+                "screenshot", screenshot_thread, NULL);
+        if (g_screenshot.thread == NULL) {
+            fs_log("could not start screenshot thread\n");
+            return 0;
+        }
+    }
+
+    fs_mutex_lock(g_screenshot.mutex);
+    int full = g_screenshot.count == SCREENSHOT_QUEUE_SIZE;
+    fs_mutex_unlock(g_screenshot.mutex);
+    if (full) {
+        // Logging every dropped screenshot would only make things worse
+        if (g_screenshot.dropped++ % 100 == 0) {
+            fs_log("screenshot queue is full, dropped %d screenshot(s)\n",
+                    g_screenshot.dropped);
+        }
+        return 0;
+    }
+
+    screenshot_job *job = g_new0(screenshot_job, 1);
+    job->path = g_strdup(path);
+    job->format = fs_emu_get_video_format();
+    job->width = cw;
+    job->height = ch;
+    job->bpp = frame_bpp;
+    job->data = g_malloc(cw * ch * frame_bpp);
+    int row_len = cw * frame_bpp;
+    for (int y = 0; y < ch; y++) {
+        memcpy(job->data + y * row_len,
+                frame + ((cy + y) * frame_width + cx) * frame_bpp, row_len);
+    }
+
+    // Only this thread adds jobs, so there is still room in the queue
+    fs_mutex_lock(g_screenshot.mutex);
+    int tail = (g_screenshot.head + g_screenshot.count) %
+            SCREENSHOT_QUEUE_SIZE;
+    g_screenshot.queue[tail] = job;
+    g_screenshot.count++;
+    fs_condition_signal(g_screenshot.condition);
+    fs_mutex_unlock(g_screenshot.mutex);
+    return 1;
+}
+
+void fs_emu_screenshot_shutdown(void)
+{
+    if (g_screenshot.thread == NULL) {
+        return;
+    }
+    fs_mutex_lock(g_screenshot.mutex);
+    g_screenshot.quit = 1;
+    fs_condition_signal(g_screenshot.condition);
+    fs_mutex_unlock(g_screenshot.mutex);
+    fs_thread_wait(g_screenshot.thread);
+    fs_thread_free(g_screenshot.thread);
+    g_screenshot.thread = NULL;
+    g_screenshot.quit = 0;
+}
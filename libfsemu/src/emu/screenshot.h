@@ -0,0 +1,16 @@
+#ifndef LIBFSEMU_SCREENSHOT_H_
+#define LIBFSEMU_SCREENSHOT_H_
+
+#include <stdint.h>
+
+// Queue a screenshot of the cx, cy, cw, ch region of frame for saving.
+// The pixels are copied, conversion and encoding is done by a worker
+// thread. The image is saved as PPM if path ends with .ppm, otherwise as
+// PNG. Returns 0 (and drops the screenshot) if the queue is full.
+int fs_emu_screenshot_queue(const char *path, const uint8_t *frame,
+        int frame_width, int frame_bpp, int cx, int cy, int cw, int ch);
+
+// Wait for queued screenshots to be written and stop the worker thread.
+void fs_emu_screenshot_shutdown(void);
+
+#endif // LIBFSEMU_SCREENSHOT_H_
@@ -36,6 +36,7 @@ int fs_emu_video_buffer_init(int width, int height, int bpp) {
         g_video_buffers[i].data = g_malloc0(g_video_buffers[i].size);
         //memset(g_video_buffers[i].data, 0, g_video_buffers[i].size);
         g_video_buffers[i].aspect = 1.0;
+        g_video_buffers[i].dirty_seq = -1;
         //g_video_buffers[i].buffer_width = width;
         //g_video_buffers[i].buffer_height = height;
     }
@@ -114,11 +115,24 @@ int fs_emu_video_buffer_grow(fs_emu_video_buffer *buffer, int width,
     return 1;
 }
 
+static void mark_all_lines_dirty(fs_emu_video_buffer *buffer) {
+    int height = MIN(buffer->height, FS_EMU_MAX_LINES);
+    memset(buffer->dirty, 1, height);
+    buffer->dirty_seq = -1;
+    buffer->dirty_count = height;
+}
+
 static void copy_buffer_data(fs_emu_video_buffer *new_buffer,
         fs_emu_video_buffer *old_buffer) {
     if (!old_buffer) {
+        mark_all_lines_dirty(new_buffer);
         return;
     }
+    // the line data can only be compared when the layout is unchanged
+    int compare = old_buffer->seq != 0 &&
+            old_buffer->width == new_buffer->width &&
+            old_buffer->height == new_buffer->height &&
+            old_buffer->bpp == new_buffer->bpp;
 
     int src_stride = old_buffer->width * old_buffer->bpp;
     int dst_stride = new_buffer->width * new_buffer->bpp;
@@ -153,14 +167,26 @@ static void copy_buffer_data(fs_emu_video_buffer *new_buffer,
 #if 0
     }
 #endif
-    // actually copy the lines
+    if (last_line >= FS_EMU_MAX_LINES) {
+        last_line = FS_EMU_MAX_LINES - 1;
+    }
+    // actually copy the lines, and find out which of the rendered lines
+    // actually changed, so the renderer only needs to upload those
+    int dirty_count = 0;
     for (int y = first_line; y <= last_line; y++) {
         if (new_buffer->line[y]) {
             memcpy(dst, src, width * g_fs_emu_video_bpp);
+            new_buffer->dirty[y] = !compare;
+        } else {
+            new_buffer->dirty[y] = !compare ||
+                    memcmp(dst, src, width * g_fs_emu_video_bpp) != 0;
         }
+        dirty_count += new_buffer->dirty[y];
         src += src_stride;
         dst += dst_stride;
     }
+    new_buffer->dirty_seq = compare ? old_buffer->seq : -1;
+    new_buffer->dirty_count = dirty_count;
 }
 
 void fs_emu_video_buffer_update_lines(fs_emu_video_buffer *buffer) {
@@ -298,60 +298,53 @@ static void akiko_c2p_do (void)
 	}
 }
 #else
-/* Optimised Chunky-to-Planar algorithm by Mequa */
-static uae_u32 akiko_precalc_shift[32];
-static uae_u32 akiko_precalc_bytenum[32][8];
-static void akiko_precalculate (void)
-{
-	uae_u32 i, j;
-	for (i = 0; i < 32; i++) {
-		akiko_precalc_shift  [(int)i] = 1 << i;
-		for (j = 0; j < 8; j++) {
-			akiko_precalc_bytenum[(int)i][(int)j] = (i >> 3) + ((7 - j) << 2);
-		}
+/* The 32 chunky bytes, in order, are akiko_buffer[7] to akiko_buffer[0],
+ * least significant byte first. akiko_result[i] collects bit i of every
+ * byte, a 32x8 bit matrix transpose.
+ */
+#if !defined(WORDS_BIGENDIAN) && defined(__GNUC__) && defined(__SSE2__)
+#define AKIKO_C2P_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef AKIKO_C2P_SSE2
+static void akiko_c2p_do (void)
+{
+	__m128i lo = _mm_loadu_si128 ((__m128i*)&akiko_buffer[4]);
+	__m128i hi = _mm_loadu_si128 ((__m128i*)&akiko_buffer[0]);
+
+	lo = _mm_shuffle_epi32 (lo, _MM_SHUFFLE (0, 1, 2, 3));
+	hi = _mm_shuffle_epi32 (hi, _MM_SHUFFLE (0, 1, 2, 3));
+	/* movemask collects the top bit of every byte, shift the next bit up */
+	for (int i = 7; i >= 0; i--) {
+		akiko_result[i] = _mm_movemask_epi8 (lo) | (_mm_movemask_epi8 (hi) << 16);
+		lo = _mm_add_epi8 (lo, lo);
+		hi = _mm_add_epi8 (hi, hi);
 	}
 }
-
+#else
 static void akiko_c2p_do (void)
 {
-	int i;
+	int i, j;
 
-	for (i = 0; i < 8; i++) {
-		akiko_result[i]    =  (((akiko_buffer[0] & akiko_precalc_shift[i])    != 0) << (akiko_precalc_bytenum[i][0])   )
-				    	   |  (((akiko_buffer[1] & akiko_precalc_shift[i])    != 0) << (akiko_precalc_bytenum[i][1])   )
-				    	   |  (((akiko_buffer[2] & akiko_precalc_shift[i])    != 0) << (akiko_precalc_bytenum[i][2])   )
-				    	   |  (((akiko_buffer[3] & akiko_precalc_shift[i])    != 0) << (akiko_precalc_bytenum[i][3])   )
-				    	   |  (((akiko_buffer[4] & akiko_precalc_shift[i])    != 0) << (akiko_precalc_bytenum[i][4])   )
-				    	   |  (((akiko_buffer[5] & akiko_precalc_shift[i])    != 0) << (akiko_precalc_bytenum[i][5])   )
-				    	   |  (((akiko_buffer[6] & akiko_precalc_shift[i])    != 0) << (akiko_precalc_bytenum[i][6])   )
-				    	   |  (((akiko_buffer[7] & akiko_precalc_shift[i])    != 0) << (akiko_precalc_bytenum[i][7])   )
-						   |  (((akiko_buffer[0] & akiko_precalc_shift[i+8])  != 0) << (akiko_precalc_bytenum[i+8][0]) )
-				    	   |  (((akiko_buffer[1] & akiko_precalc_shift[i+8])  != 0) << (akiko_precalc_bytenum[i+8][1]) )
-				    	   |  (((akiko_buffer[2] & akiko_precalc_shift[i+8])  != 0) << (akiko_precalc_bytenum[i+8][2]) )
-				    	   |  (((akiko_buffer[3] & akiko_precalc_shift[i+8])  != 0) << (akiko_precalc_bytenum[i+8][3]) )
-				    	   |  (((akiko_buffer[4] & akiko_precalc_shift[i+8])  != 0) << (akiko_precalc_bytenum[i+8][4]) )
-				    	   |  (((akiko_buffer[5] & akiko_precalc_shift[i+8])  != 0) << (akiko_precalc_bytenum[i+8][5]) )
-				    	   |  (((akiko_buffer[6] & akiko_precalc_shift[i+8])  != 0) << (akiko_precalc_bytenum[i+8][6]) )
-				    	   |  (((akiko_buffer[7] & akiko_precalc_shift[i+8])  != 0) << (akiko_precalc_bytenum[i+8][7]) )
-						   |  (((akiko_buffer[0] & akiko_precalc_shift[i+16]) != 0) << (akiko_precalc_bytenum[i+16][0]))
-				    	   |  (((akiko_buffer[1] & akiko_precalc_shift[i+16]) != 0) << (akiko_precalc_bytenum[i+16][1]))
-				    	   |  (((akiko_buffer[2] & akiko_precalc_shift[i+16]) != 0) << (akiko_precalc_bytenum[i+16][2]))
-				    	   |  (((akiko_buffer[3] & akiko_precalc_shift[i+16]) != 0) << (akiko_precalc_bytenum[i+16][3]))
-				    	   |  (((akiko_buffer[4] & akiko_precalc_shift[i+16]) != 0) << (akiko_precalc_bytenum[i+16][4]))
-				    	   |  (((akiko_buffer[5] & akiko_precalc_shift[i+16]) != 0) << (akiko_precalc_bytenum[i+16][5]))
-				    	   |  (((akiko_buffer[6] & akiko_precalc_shift[i+16]) != 0) << (akiko_precalc_bytenum[i+16][6]))
-				    	   |  (((akiko_buffer[7] & akiko_precalc_shift[i+16]) != 0) << (akiko_precalc_bytenum[i+16][7]))
-						   |  (((akiko_buffer[0] & akiko_precalc_shift[i+24]) != 0) << (akiko_precalc_bytenum[i+24][0]))
-				    	   |  (((akiko_buffer[1] & akiko_precalc_shift[i+24]) != 0) << (akiko_precalc_bytenum[i+24][1]))
-				    	   |  (((akiko_buffer[2] & akiko_precalc_shift[i+24]) != 0) << (akiko_precalc_bytenum[i+24][2]))
-				    	   |  (((akiko_buffer[3] & akiko_precalc_shift[i+24]) != 0) << (akiko_precalc_bytenum[i+24][3]))
-				    	   |  (((akiko_buffer[4] & akiko_precalc_shift[i+24]) != 0) << (akiko_precalc_bytenum[i+24][4]))
-				    	   |  (((akiko_buffer[5] & akiko_precalc_shift[i+24]) != 0) << (akiko_precalc_bytenum[i+24][5]))
-				    	   |  (((akiko_buffer[6] & akiko_precalc_shift[i+24]) != 0) << (akiko_precalc_bytenum[i+24][6]))
-				    	   |  (((akiko_buffer[7] & akiko_precalc_shift[i+24]) != 0) << (akiko_precalc_bytenum[i+24][7]));
+	for (i = 0; i < 8; i++)
+		akiko_result[i] = 0;
+	/* 8x8 bit transposes of 8 chunky bytes at a time */
+	for (j = 0; j < 4; j++) {
+		uae_u64 x = akiko_buffer[7 - 2 * j] | ((uae_u64)akiko_buffer[6 - 2 * j] << 32);
+		uae_u64 t;
+		t = (x ^ (x >> 7)) & 0x00aa00aa00aa00aaULL;
+		x ^= t ^ (t << 7);
+		t = (x ^ (x >> 14)) & 0x0000cccc0000ccccULL;
+		x ^= t ^ (t << 14);
+		t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ULL;
+		x ^= t ^ (t << 28);
+		for (i = 0; i < 8; i++)
+			akiko_result[i] |= ((x >> (8 * i)) & 0xff) << (8 * j);
 	}
 }
 #endif
+#endif
 
 static void akiko_c2p_write (int offset, uae_u32 v)
 {
@@ -2072,7 +2065,6 @@ int akiko_init (void)
 	if (!currprefs.cs_cd32cd)
 		return 0;
 	akiko_free ();
-	akiko_precalculate ();
 	unitnum = -1;
 	sys_cddev_open ();
 	sector_buffer_1 = xmalloc (uae_u8, SECTOR_BUFFER_SIZE * 2352);
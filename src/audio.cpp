@@ -2073,9 +2073,24 @@ static void update_audio_volcnt(int cycles, float evtime, bool nextsmp)
 	(*sample_handler) ();
 }
 
+/* Warp mode discards all output, so there is no point in synthesizing
+ * samples. The channel state machines (DMA requests, interrupts) still
+ * run from update_audio. */
+STATIC_INLINE bool audio_synthesize (void)
+{
+	if (currprefs.produce_sound <= 1)
+		return false;
+#ifdef AVIOUTPUT
+	if (avioutput_enabled && avioutput_audio)
+		return true;
+#endif
+	return !currprefs.turbo_emulation;
+}
+
 void update_audio (void)
 {
 	unsigned long int n_cycles = 0;
+	bool synth;
 #if SOUNDSTUFF > 1
 	static int samplecounter;
 #endif
@@ -2087,10 +2102,11 @@ void update_audio (void)
 	if (!is_audio_active ())
 		goto end;
 
+	synth = audio_synthesize ();
 	n_cycles = get_cycles () - last_cycles;
 	while (n_cycles > 0) {
 		unsigned long int best_evtime = n_cycles + 1;
-		unsigned long rounded;
+		unsigned long rounded = 0;
 		int i;
 
 		for (i = 0; i < AUDIO_CHANNELS_PAULA; i++) {
@@ -2102,22 +2118,25 @@ void update_audio (void)
 				best_evtime= audio_stream[i].evtime;
 		}
 
-		/* next_sample_evtime >= 0 so floor() behaves as expected */
-		rounded = floorf (next_sample_evtime);
 		float nevtime = next_sample_evtime;
-		if ((next_sample_evtime - rounded) >= 0.5)
-			rounded++;
-
-		if (currprefs.produce_sound > 1 && best_evtime > rounded)
-			best_evtime = rounded;
+		if (synth) {
+			/* next_sample_evtime >= 0 so floor() behaves as expected */
+			rounded = floorf (next_sample_evtime);
+			if ((next_sample_evtime - rounded) >= 0.5)
+				rounded++;
+			if (best_evtime > rounded)
+				best_evtime = rounded;
+		}
 
 		if (best_evtime > n_cycles)
 			best_evtime = n_cycles;
 
 		/* Decrease time-to-wait counters */
-		next_sample_evtime -= best_evtime;
+		if (synth) {
+			next_sample_evtime -= best_evtime;
+		}
 
-		if (currprefs.produce_sound > 1) {
+		if (synth) {
 			if (sample_prehandler)
 				sample_prehandler (best_evtime / CYCLE_UNIT);
 			if (extra_sample_prehandler)
@@ -2135,7 +2154,7 @@ void update_audio (void)
 
 		n_cycles -= best_evtime;
 
-		if (currprefs.produce_sound > 1) {
+		if (synth) {
 			if (currprefs.sound_volcnt) {
 				bool nextsmp = false;
 				if (rounded == best_evtime) {
@@ -917,6 +917,187 @@ int sys_command_cd_toc (int unitnum, struct cd_toc_head *toc)
 	return v;
 }
 
+/* Sector cache with sequential readahead
+
+   Direct mapped on the sector number, each entry holds one whole sector
+   as returned by the backend fill function. Reading the sector after the
+   previously read one queues a readahead of the following sectors, which
+   a background thread reads into the cache. All fill calls (foreground
+   and readahead) are serialized. */
+
+#define BLKDEV_CACHE_SECTORS 1024
+#define BLKDEV_CACHE_READAHEAD 32
+
+struct blkdev_cache_entry
+{
+	int sector;
+	int type;
+	bool valid;
+	uae_u8 data[BLKDEV_CACHE_SECTOR_SIZE];
+};
+
+struct blkdev_cache
+{
+	struct blkdev_cache_entry *entries;
+	blkdev_cache_fill_func fill;
+	void *userdata;
+	uae_sem_t lock;
+	uae_sem_t fill_sem;
+	uae_sem_t readahead_sem;
+	uae_thread_id tid;
+	volatile bool quit;
+	int last_sector, last_type;
+	int ra_sector, ra_type, ra_count;
+	int hits, misses, readaheads;
+};
+
+static struct blkdev_cache_entry *blkdev_cache_find (struct blkdev_cache *bc, int sector, int type)
+{
+	struct blkdev_cache_entry *e = &bc->entries[sector & (BLKDEV_CACHE_SECTORS - 1)];
+	if (e->valid && e->sector == sector && e->type == type)
+		return e;
+	return NULL;
+}
+
+static void blkdev_cache_insert (struct blkdev_cache *bc, int sector, int type, const uae_u8 *data)
+{
+	struct blkdev_cache_entry *e = &bc->entries[sector & (BLKDEV_CACHE_SECTORS - 1)];
+	e->sector = sector;
+	e->type = type;
+	e->valid = true;
+	memcpy (e->data, data, BLKDEV_CACHE_SECTOR_SIZE);
+}
+
+static void *blkdev_cache_thread (void *v)
+{
+	struct blkdev_cache *bc = (struct blkdev_cache*)v;
+	uae_u8 buf[BLKDEV_CACHE_SECTOR_SIZE];
+
+	for (;;) {
+		uae_sem_wait (&bc->readahead_sem);
+		if (bc->quit)
+			break;
+		for (;;) {
+			uae_sem_wait (&bc->fill_sem);
+			uae_sem_wait (&bc->lock);
+			bool go = bc->ra_count > 0 && !bc->quit;
+			int sector = bc->ra_sector;
+			int type = bc->ra_type;
+			bool cached = false;
+			if (go) {
+				bc->ra_sector++;
+				bc->ra_count--;
+				cached = blkdev_cache_find (bc, sector, type) != NULL;
+			}
+			uae_sem_post (&bc->lock);
+			if (go && !cached) {
+				bool ok = bc->fill (bc->userdata, sector, type, buf);
+				uae_sem_wait (&bc->lock);
+				if (ok) {
+					blkdev_cache_insert (bc, sector, type, buf);
+					bc->readaheads++;
+				} else if (bc->ra_type == type && bc->ra_sector == sector + 1) {
+					// end of track, no point in reading further
+					bc->ra_count = 0;
+				}
+				uae_sem_post (&bc->lock);
+			}
+			uae_sem_post (&bc->fill_sem);
+			if (!go)
+				break;
+		}
+	}
+	return NULL;
+}
+
+struct blkdev_cache *blkdev_cache_alloc (blkdev_cache_fill_func fill, void *userdata)
+{
+	struct blkdev_cache *bc = xcalloc (struct blkdev_cache, 1);
+	bc->entries = xcalloc (struct blkdev_cache_entry, BLKDEV_CACHE_SECTORS);
+	bc->fill = fill;
+	bc->userdata = userdata;
+	bc->last_sector = -2;
+	uae_sem_init (&bc->lock, 0, 1);
+	uae_sem_init (&bc->fill_sem, 0, 1);
+	uae_sem_init (&bc->readahead_sem, 0, 0);
+	uae_start_thread (_T("blkdev_cache"), blkdev_cache_thread, bc, &bc->tid);
+	return bc;
+}
+
+/* cancel readahead and wait until the thread no longer calls fill */
+void blkdev_cache_stop (struct blkdev_cache *bc)
+{
+	if (!bc)
+		return;
+	uae_sem_wait (&bc->lock);
+	bc->ra_count = 0;
+	uae_sem_post (&bc->lock);
+	uae_sem_wait (&bc->fill_sem);
+	uae_sem_post (&bc->fill_sem);
+}
+
+void blkdev_cache_free (struct blkdev_cache *bc)
+{
+	if (!bc)
+		return;
+	blkdev_cache_stop (bc);
+	bc->quit = true;
+	uae_sem_post (&bc->readahead_sem);
+	uae_wait_thread (bc->tid);
+	uae_end_thread (&bc->tid);
+	write_log (_T("CD cache: %d hits, %d misses, %d sectors read ahead\n"), bc->hits, bc->misses, bc->readaheads);
+	uae_sem_destroy (&bc->lock);
+	uae_sem_destroy (&bc->fill_sem);
+	uae_sem_destroy (&bc->readahead_sem);
+	xfree (bc->entries);
+	xfree (bc);
+}
+
+/* read size bytes at offset of a sector, false if fill failed */
+bool blkdev_cache_read (struct blkdev_cache *bc, int sector, int type, uae_u8 *data, int offset, int size)
+{
+	struct blkdev_cache_entry *e;
+	bool ok = true;
+
+	uae_sem_wait (&bc->lock);
+	e = blkdev_cache_find (bc, sector, type);
+	if (e) {
+		memcpy (data, e->data + offset, size);
+		bc->hits++;
+	} else {
+		bc->misses++;
+	}
+	if (sector == bc->last_sector + 1 && type == bc->last_type) {
+		// sequential, keep BLKDEV_CACHE_READAHEAD sectors ahead
+		int start = sector + 1;
+		if (bc->ra_count > 0 && bc->ra_type == type && bc->ra_sector > start && bc->ra_sector <= start + BLKDEV_CACHE_READAHEAD)
+			start = bc->ra_sector;
+		bool idle = bc->ra_count == 0;
+		bc->ra_sector = start;
+		bc->ra_type = type;
+		bc->ra_count = sector + 1 + BLKDEV_CACHE_READAHEAD - start;
+		if (idle && bc->ra_count > 0)
+			uae_sem_post (&bc->readahead_sem);
+	}
+	bc->last_sector = sector;
+	bc->last_type = type;
+	uae_sem_post (&bc->lock);
+	if (e)
+		return true;
+
+	uae_u8 buf[BLKDEV_CACHE_SECTOR_SIZE];
+	uae_sem_wait (&bc->fill_sem);
+	ok = bc->fill (bc->userdata, sector, type, buf);
+	uae_sem_post (&bc->fill_sem);
+	if (!ok)
+		return false;
+	uae_sem_wait (&bc->lock);
+	blkdev_cache_insert (bc, sector, type, buf);
+	uae_sem_post (&bc->lock);
+	memcpy (data, buf + offset, size);
+	return true;
+}
+
 /* read one cd sector */
 int sys_command_cd_read (int unitnum, uae_u8 *data, int block, int size)
 {
@@ -78,7 +78,10 @@ struct cdtoc
 	int pregap; // sectors of silence
 	int postgap; // sectors of silence
 	audenc enctype;
-	int writeoffset;
+	FLAC__StreamDecoder *flac;
+	uae_u8 *flacbuf; // decoded window, flacbufstart to flacbufstart + flacbuflen
+	uae_s64 flacbufstart;
+	int flacbuflen, flacbufsize;
 	int subcode;
 #ifdef WITH_CHD
 	const cdrom_track_info *chdtrack;
@@ -117,6 +120,7 @@ struct cdunit {
 	volatile int cda_bufon[2];
 	cda_audio *cda;
 	struct cd_audio_state cas;
+	struct blkdev_cache *cache;
 };
 
 static struct cdunit cdunits[MAX_TOTAL_SCSI_DEVICES];
@@ -161,8 +165,36 @@ static struct cdtoc *findtoc (struct cdunit *cdu, int *sectorp, bool data)
 	return NULL;
 }
 
+// Data sectors are read through the blkdev sector cache. The cache type
+// is the toc index and, for CHD, the CHD track type.
+static bool cache_fill (void *userdata, int sector, int type, uae_u8 *data)
+{
+	struct cdunit *cdu = (struct cdunit*)userdata;
+	int idx = type >> 8;
+	bool ok = false;
+
+	if (idx >= cdu->tracks)
+		return false;
+	struct cdtoc *t = &cdu->toc[idx];
+	if (sector < 0 || sector >= (t[1].address - t[1].index1) - (t->address - t->index1))
+		return false;
+	// also protects the handles against getsub_deinterleaved()
+	uae_sem_wait (&cdu->sub_sem);
+	if (t->enctype == ENC_CHD) {
+#ifdef WITH_CHD
+		ok = cdrom_read_data(cdu->chd_cdf, sector + t->offset, data, type & 0xff, true) != 0;
+#endif
+	} else if (t->handle) {
+		zfile_fseek (t->handle, t->offset + (uae_u64)sector * (t->size + t->skipsize), SEEK_SET);
+		ok = zfile_fread (data, 1, t->size, t->handle) == t->size;
+	}
+	uae_sem_post (&cdu->sub_sem);
+	return ok;
+}
+
 static int do_read (struct cdunit *cdu, struct cdtoc *t, uae_u8 *data, int sector, int offset, int size, bool audio)
 {
+	int idx = t - &cdu->toc[0];
 	if (t->enctype == ENC_CHD) {
 #ifdef WITH_CHD
 		int type = CD_TRACK_MODE1_RAW;
@@ -186,7 +218,12 @@ static int do_read (struct cdunit *cdu, struct cdtoc *t, uae_u8 *data, int secto
 		}
 		if (audio && size == 2352)
 			type = CD_TRACK_AUDIO;
-		if (cdrom_read_data(cdu->chd_cdf, sector + t->offset, tmpbuf, type, true)) {
+		if (!audio && cdu->cache && offset + size <= 2352 && blkdev_cache_read (cdu->cache, sector, (idx << 8) | type, data, offset, size))
+			return 1;
+		uae_sem_wait (&cdu->sub_sem);
+		int ok = cdrom_read_data(cdu->chd_cdf, sector + t->offset, tmpbuf, type, true);
+		uae_sem_post (&cdu->sub_sem);
+		if (ok) {
 			memcpy(data, tmpbuf + offset, size);
 			return 1;
 		}
@@ -194,17 +231,31 @@ static int do_read (struct cdunit *cdu, struct cdtoc *t, uae_u8 *data, int secto
 #endif
 	} else if (t->handle) {
 		int ssize = t->size + t->skipsize;
+		if (!audio && cdu->cache && offset + size <= t->size && blkdev_cache_read (cdu->cache, sector, idx << 8, data, offset, size))
+			return 1;
+		// the readahead thread may be using the same handle
+		uae_sem_wait (&cdu->sub_sem);
 		zfile_fseek (t->handle, t->offset + (uae_u64)sector * ssize + offset, SEEK_SET);
-		return zfile_fread (data, 1, size, t->handle) == size;
+		int ok = zfile_fread (data, 1, size, t->handle) == size;
+		uae_sem_post (&cdu->sub_sem);
+		return ok;
 	}
 	return 0;
 }
 
 // WOHOO, library that supports virtual file access functions. Perfect!
+//
+// FLAC tracks are not unpacked, they are decoded while playing. Only a
+// small window of decoded samples is kept: reads just after the window
+// decode forward, anything else seeks (using the seek table if the file
+// has one).
+#define FLAC_BUFFER_SIZE (64 * 2352)
+#define FLAC_SEEK_DISTANCE (75 * 2352)
+
 static void flac_metadata_callback (const FLAC__StreamDecoder *decoder, const FLAC__StreamMetadata *metadata, void *client_data)
 {
 	struct cdtoc *t = (struct cdtoc*)client_data;
-	if (t->data)
+	if (t->flac)
 		return;
 	if(metadata->type == FLAC__METADATA_TYPE_STREAMINFO) {
 		t->filesize = metadata->data.stream_info.total_samples * (metadata->data.stream_info.bits_per_sample / 8) * metadata->data.stream_info.channels;
@@ -217,12 +268,33 @@ static void flac_error_callback (const FLAC__StreamDecoder *decoder, FLAC__Strea
 static FLAC__StreamDecoderWriteStatus flac_write_callback (const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data)
 {
 	struct cdtoc *t = (struct cdtoc*)client_data;
-	uae_u16 *p = (uae_u16*)(t->data + t->writeoffset);
 	int size = 4;
-	for (int i = 0; i < frame->header.blocksize && t->writeoffset < t->filesize - size; i++, t->writeoffset += size) {
+	uae_s64 start = frame->header.number.sample_number * size;
+	int len = frame->header.blocksize * size;
+	if (!t->flacbuf)
+		return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+	// after a seek the first frame starts at the target sample
+	if (start != t->flacbufstart + t->flacbuflen) {
+		t->flacbufstart = start;
+		t->flacbuflen = 0;
+	}
+	// always room for two frames, FLAC allows up to 65535 samples per frame
+	if (len > t->flacbufsize / 2) {
+		t->flacbufsize = len * 2;
+		t->flacbuf = xrealloc (uae_u8, t->flacbuf, t->flacbufsize);
+	}
+	if (t->flacbuflen + len > t->flacbufsize) {
+		int drop = t->flacbuflen + len - t->flacbufsize;
+		memmove (t->flacbuf, t->flacbuf + drop, t->flacbuflen - drop);
+		t->flacbufstart += drop;
+		t->flacbuflen -= drop;
+	}
+	uae_u16 *p = (uae_u16*)(t->flacbuf + t->flacbuflen);
+	for (int i = 0; i < frame->header.blocksize; i++) {
 		*p++ = (FLAC__int16)buffer[0][i];
 		*p++ = (FLAC__int16)buffer[1][i];
 	}
+	t->flacbuflen += len;
 	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
 }
 static FLAC__StreamDecoderReadStatus file_read_callback (const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data)
@@ -269,22 +341,73 @@ static void flac_get_size (struct cdtoc *t)
 		FLAC__stream_decoder_delete (decoder);
 	}
 }
-static uae_u8 *flac_get_data (struct cdtoc *t)
+static void flac_close (struct cdtoc *t)
+{
+	if (t->flac)
+		FLAC__stream_decoder_delete (t->flac);
+	t->flac = NULL;
+	xfree (t->flacbuf);
+	t->flacbuf = NULL;
+	t->flacbufstart = 0;
+	t->flacbuflen = 0;
+	t->flacbufsize = 0;
+}
+static bool flac_open (struct cdunit *cdu, struct cdtoc *t)
 {
-	write_log (_T("FLAC: unpacking '%s'..\n"), zfile_getname (t->handle));
-	t->writeoffset = 0;
+	if (t->flac)
+		return true;
+	// only the track that is playing keeps its decoder
+	for (int i = 0; i < sizeof cdu->toc / sizeof (struct cdtoc); i++) {
+		if (cdu->toc[i].flac)
+			flac_close (&cdu->toc[i]);
+	}
 	FLAC__StreamDecoder *decoder = FLAC__stream_decoder_new ();
-	if (decoder) {
-		FLAC__stream_decoder_set_md5_checking (decoder, false);
-		int init_status = FLAC__stream_decoder_init_stream (decoder,
-			&file_read_callback, &file_seek_callback, &file_tell_callback,
-			&file_len_callback, &file_eof_callback,
-			&flac_write_callback, &flac_metadata_callback, &flac_error_callback, t);
-		FLAC__stream_decoder_process_until_end_of_stream (decoder);
+	if (!decoder)
+		return false;
+	FLAC__stream_decoder_set_md5_checking (decoder, false);
+	if (FLAC__stream_decoder_init_stream (decoder,
+		&file_read_callback, &file_seek_callback, &file_tell_callback,
+		&file_len_callback, &file_eof_callback,
+		&flac_write_callback, &flac_metadata_callback, &flac_error_callback, t) != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+		write_log (_T("FLAC: couldn't open '%s'\n"), zfile_getname (t->handle));
 		FLAC__stream_decoder_delete (decoder);
-		write_log (_T("FLAC: %s unpacked\n"), zfile_getname (t->handle));
+		return false;
+	}
+	t->flac = decoder;
+	t->flacbufsize = FLAC_BUFFER_SIZE;
+	t->flacbuf = xmalloc (uae_u8, t->flacbufsize);
+	t->flacbufstart = 0;
+	t->flacbuflen = 0;
+	if (!FLAC__stream_decoder_process_until_end_of_metadata (decoder)) {
+		write_log (_T("FLAC: couldn't read metadata of '%s'\n"), zfile_getname (t->handle));
+		flac_close (t);
+		return false;
+	}
+	write_log (_T("FLAC: streaming '%s'\n"), zfile_getname (t->handle));
+	return true;
+}
+static bool flac_read (struct cdunit *cdu, struct cdtoc *t, uae_u8 *data, uae_s64 offset, int size)
+{
+	if (offset < 0 || offset + size > t->filesize || !flac_open (cdu, t))
+		return false;
+	if (offset < t->flacbufstart || offset > t->flacbufstart + t->flacbuflen + FLAC_SEEK_DISTANCE) {
+		t->flacbuflen = 0;
+		if (!FLAC__stream_decoder_seek_absolute (t->flac, offset / 4)) {
+			write_log (_T("FLAC: seek to %lld failed\n"), offset);
+			FLAC__stream_decoder_flush (t->flac);
+			return false;
+		}
 	}
-	return t->data;
+	while (offset + size > t->flacbufstart + t->flacbuflen) {
+		if (FLAC__stream_decoder_get_state (t->flac) == FLAC__STREAM_DECODER_END_OF_STREAM)
+			return false;
+		if (!FLAC__stream_decoder_process_single (t->flac))
+			return false;
+	}
+	if (offset < t->flacbufstart)
+		return false;
+	memcpy (data, t->flacbuf + (offset - t->flacbufstart), size);
+	return true;
 }
 
 void sub_to_interleaved (const uae_u8 *s, uae_u8 *d)
@@ -415,21 +538,18 @@ static void *cdda_unpack_func (void *v)
 			uae_u8 b;
 			zfile_fread (&b, 1, 1, t->handle);
 			zfile_fseek (t->handle, pos, SEEK_SET);
-			if (!t->data && (t->enctype == AUDENC_MP3 || t->enctype == AUDENC_FLAC)) {
+			// FLAC is decoded while playing, mp3decoder can only unpack whole tracks
+			if (!t->data && t->enctype == AUDENC_MP3) {
 				t->data = xcalloc (uae_u8, t->filesize + 2352);
 				cdimage_unpack_active = 1;
 				if (t->data) {
-					if (t->enctype == AUDENC_MP3) {
-						if (!mp3dec) {
-							try {
-								mp3dec = new mp3decoder();
-							} catch (exception) { };
-						}
-						if (mp3dec)
-							t->data = mp3dec->get (t->handle, t->data, t->filesize);
-					} else if (t->enctype == AUDENC_FLAC) {
-						flac_get_data (t);
+					if (!mp3dec) {
+						try {
+							mp3dec = new mp3decoder();
+						} catch (exception) { };
 					}
+					if (mp3dec)
+						t->data = mp3dec->get (t->handle, t->data, t->filesize);
 				}
 			}
 		}
@@ -656,9 +776,11 @@ static bool cdda_play_func2 (struct cdunit *cdu, int *outpos)
 							int totalsize = t->size + t->skipsize;
 							int offset = t->offset;
 							if (offset >= 0) {
-								if ((t->enctype == AUDENC_MP3 || t->enctype == AUDENC_FLAC) && t->data) {
+								if (t->enctype == AUDENC_MP3 && t->data) {
 									if (t->filesize >= sector * totalsize + offset + t->size)
 										memcpy (dst, t->data + sector * totalsize + offset, t->size);
+								} else if (t->enctype == AUDENC_FLAC) {
+									flac_read (cdu, t, dst, (uae_s64)sector * totalsize + offset, t->size);
 								} else if (t->enctype == AUDENC_PCM) {
 									if (sector * totalsize + offset + totalsize < t->filesize) {
 										zfile_fseek (t->handle, (uae_u64)sector * totalsize + offset, SEEK_SET);
@@ -830,6 +952,8 @@ static int command_play (int unitnum, int startlsn, int endlsn, int scan, play_s
 			Sleep (10);
 		cdu->cdda_play = 0;
 	}
+	// the play thread reads the image without locking
+	blkdev_cache_stop (cdu->cache);
 	cdu->cd_last_pos = startlsn;
 	cdu->cdda_start = startlsn;
 	cdu->cdda_end = endlsn;
@@ -2222,8 +2346,12 @@ static void unload_image (struct cdunit *cdu)
 {
 	int i;
 
+	blkdev_cache_free (cdu->cache);
+	cdu->cache = NULL;
+
 	for (i = 0; i < sizeof cdu->toc / sizeof (struct cdtoc); i++) {
 		struct cdtoc *t = &cdu->toc[i];
+		flac_close (t);
 		zfile_fclose (t->handle);
 		if (t->handle != t->subhandle)
 			zfile_fclose (t->subhandle);
@@ -2259,6 +2387,8 @@ static int open_device (int unitnum, const TCHAR *ident, int flags)
 			cfgfile_resolve_path_out_load(cdu->imgname_in, cdu->imgname_out, MAX_DPATH, PATH_CD);
 			parse_image(cdu, cdu->imgname_out);
 		}
+		if (cdu->tracks)
+			cdu->cache = blkdev_cache_alloc (cache_fill, cdu);
 		cdu->open = true;
 		cdu->enabled = true;
 		cdu->cdda_volume[0] = 0x7fff;
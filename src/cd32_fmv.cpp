@@ -816,89 +816,218 @@ static void cl450_write_dram(int addr, uae_u16 w)
 static struct zfile *videodump;
 #endif
 
-static void cl450_parse_frame(void)
-{
 #ifdef WITH_LIBMPEG2
+/* libmpeg2 runs on a separate thread, one job at a time. A job parses
+ * until a frame has been decoded (and converted to RGB) into the next
+ * free videoram buffer, or until libmpeg2 needs more data. Everything
+ * the emulated CL450 does (stream buffer, NewPacket accounting, DRAM,
+ * interrupts, frame queue) stays on the emulation thread, which feeds the
+ * stream data and applies the results of a job when it has finished.
+ * Results are applied by the 8 line poll in the hsync handler, so
+ * CL_INT_SEQ_V, the DRAM writes and the new frame appear at least 8 lines
+ * after the job was started, and 8 lines later for each time the job ran
+ * out of stream data. Parsing used to be done (and applied) inline.
+ */
+static uae_thread_id cl450_decode_tid;
+static uae_sem_t cl450_decode_start_sem, cl450_decode_done_sem;
+static volatile bool cl450_decode_quit;
+static bool cl450_decode_busy;
+
+/* Job parameters, written by the emulation thread before a job starts */
+static int cl450_decode_slot;
+static int cl450_decode_colormode;
+
+/* Job results, written by the decode thread */
+static bool cl450_decode_needdata;
+static bool cl450_decode_sequence, cl450_decode_gop, cl450_decode_frame;
+static int cl450_decode_rate, cl450_decode_width, cl450_decode_height, cl450_decode_pixbytes;
+static uae_u16 cl450_decode_timecode[2];
+
+static void cl450_decode_job(void)
+{
+	cl450_decode_needdata = false;
+	cl450_decode_sequence = cl450_decode_gop = cl450_decode_frame = false;
 	for (;;) {
 		mpeg2_state_t mpeg_state = mpeg2_parse(mpeg_decoder);
 		switch (mpeg_state)
 		{
 			case STATE_BUFFER:
-			{
-				int bufsize = cl450_buffer_offset;
-				if (bufsize == 0)
-					return;
-				while (bufsize > 0 && cl450_newpacket_mode) {
-					struct cl450_newpacket *np = &cl450_newpacket_buffer[cl450_newpacket_offset_read];
-					if (cl450_newpacket_offset_read == cl450_newpacket_offset_write)
-						return;
-					int size = np->length > bufsize ? bufsize : np->length;
-
-					if (np->length == 0) {
-						write_log(_T("CL450 no matching newpacket!?\n"));
-						return;
-					}
-
-					np->length -= size;
-					bufsize -= size;
-					if (np->length > 0)
-						break;
-					//write_log(_T("CL450: NewPacket %d done\n"), cl450_newpacket_offset_read);
-					cl450_newpacket_offset_read++;
-					cl450_newpacket_offset_read &= CL450_NEWPACKET_BUFFER_SIZE - 1;
-				}
-#if DUMP_VIDEO
-				if (!videodump)
-					videodump = zfile_fopen(_T("c:\\temp\\1.mpg"), _T("wb"));
-				zfile_fwrite(&ram[CL450_MPEG_BUFFER], 1, cl450_buffer_offset, videodump);
-#endif
-				memcpy(&fmv_ram_bank.baseaddr[CL450_MPEG_DECODE_BUFFER] + libmpeg_offset, &fmv_ram_bank.baseaddr[CL450_MPEG_BUFFER], cl450_buffer_offset);
-				mpeg2_buffer(mpeg_decoder, &fmv_ram_bank.baseaddr[CL450_MPEG_DECODE_BUFFER] + libmpeg_offset, &fmv_ram_bank.baseaddr[CL450_MPEG_DECODE_BUFFER] + libmpeg_offset + cl450_buffer_offset);
-				libmpeg_offset += cl450_buffer_offset;
-				if (libmpeg_offset >= CL450_MPEG_DECODE_BUFFER_SIZE - CL450_MPEG_BUFFER_SIZE)
-					libmpeg_offset = 0;
-				cl450_buffer_offset = 0;
-			}
-			break;
+				cl450_decode_needdata = true;
+				return;
 			case STATE_SEQUENCE:
-				cl450_frame_pixbytes = currprefs.color_mode != 5 ? 2 : 4;
-				mpeg2_convert(mpeg_decoder, cl450_frame_pixbytes == 2 ? mpeg2convert_rgb16 : mpeg2convert_rgb32, NULL);
-				cl450_set_status(CL_INT_SEQ_V);
-				cl450_frame_rate = mpeg_info->sequence->frame_period ? 27000000 / mpeg_info->sequence->frame_period : 0;
-				cl450_frame_width = mpeg_info->sequence->width;
-				cl450_frame_height = mpeg_info->sequence->height;
-				cl450_write_dram(CL_DRAM_PICTURE_RATE, cl450_frame_rate);
-				cl450_write_dram(CL_DRAM_H_SIZE, cl450_frame_width);
-				cl450_write_dram(CL_DRAM_V_SIZE, cl450_frame_height);
+				cl450_decode_pixbytes = cl450_decode_colormode != 5 ? 2 : 4;
+				mpeg2_convert(mpeg_decoder, cl450_decode_pixbytes == 2 ? mpeg2convert_rgb16 : mpeg2convert_rgb32, NULL);
+				cl450_decode_rate = mpeg_info->sequence->frame_period ? 27000000 / mpeg_info->sequence->frame_period : 0;
+				cl450_decode_width = mpeg_info->sequence->width;
+				cl450_decode_height = mpeg_info->sequence->height;
+				cl450_decode_sequence = true;
 				break;
 			case STATE_PICTURE:
 				break;
 			case STATE_GOP:
-				cl450_write_dram(CL_DRAM_TIME_CODE_0, (mpeg_info->gop->hours << 6) | (mpeg_info->gop->minutes));
-				cl450_write_dram(CL_DRAM_TIME_CODE_1, (mpeg_info->gop->seconds << 6) | (mpeg_info->gop->pictures));
+				cl450_decode_timecode[0] = (mpeg_info->gop->hours << 6) | (mpeg_info->gop->minutes);
+				cl450_decode_timecode[1] = (mpeg_info->gop->seconds << 6) | (mpeg_info->gop->pictures);
+				cl450_decode_gop = true;
 				break;
 			case STATE_SLICE:
 			case STATE_END:
 				if (mpeg_info->display_fbuf) {
-					memcpy(videoram[cl450_videoram_write].data, mpeg_info->display_fbuf->buf[0], cl450_frame_width * cl450_frame_height * cl450_frame_pixbytes);
-					videoram[cl450_videoram_write].width = cl450_frame_width;
-					videoram[cl450_videoram_write].height = cl450_frame_height;
-					videoram[cl450_videoram_write].depth = cl450_frame_pixbytes;
-					cl450_videoram_write++;
-					cl450_videoram_write &= CL450_VIDEO_BUFFERS - 1;
-					cl450_videoram_cnt++;
-					//write_log(_T("%d\n"), cl450_videoram_cnt);
+					/* the emulation thread does not touch this buffer until the job is done */
+					struct cl450_videoram *vr = &videoram[cl450_decode_slot];
+					memcpy(vr->data, mpeg_info->display_fbuf->buf[0], cl450_decode_width * cl450_decode_height * cl450_decode_pixbytes);
+					vr->width = cl450_decode_width;
+					vr->height = cl450_decode_height;
+					vr->depth = cl450_decode_pixbytes;
+					cl450_decode_frame = true;
 				}
 				return;
 			default:
 				break;
 		}
 	}
+}
+
+static void *cl450_decode_thread(void *data)
+{
+	for (;;) {
+		uae_sem_wait(&cl450_decode_start_sem);
+		if (cl450_decode_quit)
+			break;
+		cl450_decode_job();
+		uae_sem_post(&cl450_decode_done_sem);
+	}
+	return NULL;
+}
+
+static void cl450_decode_start_thread(void)
+{
+	if (cl450_decode_tid)
+		return;
+	cl450_decode_quit = false;
+	cl450_decode_busy = false;
+	cl450_decode_needdata = false;
+	uae_sem_init(&cl450_decode_start_sem, 0, 0);
+	uae_sem_init(&cl450_decode_done_sem, 0, 0);
+	uae_start_thread(_T("cd32fmv_mpeg"), cl450_decode_thread, NULL, &cl450_decode_tid);
+}
+
+static void cl450_decode_stop_thread(void)
+{
+	if (!cl450_decode_tid)
+		return;
+	if (cl450_decode_busy)
+		uae_sem_wait(&cl450_decode_done_sem);
+	cl450_decode_busy = false;
+	cl450_decode_quit = true;
+	uae_sem_post(&cl450_decode_start_sem);
+	uae_wait_thread(cl450_decode_tid);
+	uae_end_thread(&cl450_decode_tid);
+	uae_sem_destroy(&cl450_decode_start_sem);
+	uae_sem_destroy(&cl450_decode_done_sem);
+}
+
+/* Wait for a running job and drop its results */
+static void cl450_decode_wait(void)
+{
+	if (!cl450_decode_busy)
+		return;
+	uae_sem_wait(&cl450_decode_done_sem);
+	cl450_decode_busy = false;
+	cl450_decode_frame = false;
+}
+
+/* Apply the results of a finished job */
+static void cl450_decode_poll(void)
+{
+	if (!cl450_decode_busy || uae_sem_trywait(&cl450_decode_done_sem))
+		return;
+	cl450_decode_busy = false;
+	if (cl450_decode_sequence) {
+		cl450_frame_pixbytes = cl450_decode_pixbytes;
+		cl450_set_status(CL_INT_SEQ_V);
+		cl450_frame_rate = cl450_decode_rate;
+		cl450_frame_width = cl450_decode_width;
+		cl450_frame_height = cl450_decode_height;
+		cl450_write_dram(CL_DRAM_PICTURE_RATE, cl450_frame_rate);
+		cl450_write_dram(CL_DRAM_H_SIZE, cl450_frame_width);
+		cl450_write_dram(CL_DRAM_V_SIZE, cl450_frame_height);
+	}
+	if (cl450_decode_gop) {
+		cl450_write_dram(CL_DRAM_TIME_CODE_0, cl450_decode_timecode[0]);
+		cl450_write_dram(CL_DRAM_TIME_CODE_1, cl450_decode_timecode[1]);
+	}
+	if (cl450_decode_frame) {
+		cl450_decode_frame = false;
+		cl450_videoram_write++;
+		cl450_videoram_write &= CL450_VIDEO_BUFFERS - 1;
+		cl450_videoram_cnt++;
+		//write_log(_T("%d\n"), cl450_videoram_cnt);
+	}
+}
+
+/* Pass the stream data to libmpeg2, false if there was nothing to pass */
+static bool cl450_decode_buffer(void)
+{
+	int bufsize = cl450_buffer_offset;
+	if (bufsize == 0)
+		return false;
+	while (bufsize > 0 && cl450_newpacket_mode) {
+		struct cl450_newpacket *np = &cl450_newpacket_buffer[cl450_newpacket_offset_read];
+		if (cl450_newpacket_offset_read == cl450_newpacket_offset_write)
+			return false;
+		int size = np->length > bufsize ? bufsize : np->length;
+
+		if (np->length == 0) {
+			write_log(_T("CL450 no matching newpacket!?\n"));
+			return false;
+		}
+
+		np->length -= size;
+		bufsize -= size;
+		if (np->length > 0)
+			break;
+		//write_log(_T("CL450: NewPacket %d done\n"), cl450_newpacket_offset_read);
+		cl450_newpacket_offset_read++;
+		cl450_newpacket_offset_read &= CL450_NEWPACKET_BUFFER_SIZE - 1;
+	}
+#if DUMP_VIDEO
+	if (!videodump)
+		videodump = zfile_fopen(_T("c:\\temp\\1.mpg"), _T("wb"));
+	zfile_fwrite(&ram[CL450_MPEG_BUFFER], 1, cl450_buffer_offset, videodump);
+#endif
+	memcpy(&fmv_ram_bank.baseaddr[CL450_MPEG_DECODE_BUFFER] + libmpeg_offset, &fmv_ram_bank.baseaddr[CL450_MPEG_BUFFER], cl450_buffer_offset);
+	mpeg2_buffer(mpeg_decoder, &fmv_ram_bank.baseaddr[CL450_MPEG_DECODE_BUFFER] + libmpeg_offset, &fmv_ram_bank.baseaddr[CL450_MPEG_DECODE_BUFFER] + libmpeg_offset + cl450_buffer_offset);
+	libmpeg_offset += cl450_buffer_offset;
+	if (libmpeg_offset >= CL450_MPEG_DECODE_BUFFER_SIZE - CL450_MPEG_BUFFER_SIZE)
+		libmpeg_offset = 0;
+	cl450_buffer_offset = 0;
+	return true;
+}
+#endif
+
+static void cl450_parse_frame(void)
+{
+#ifdef WITH_LIBMPEG2
+	if (cl450_decode_busy || !cl450_decode_tid)
+		return;
+	if (cl450_decode_needdata) {
+		if (!cl450_decode_buffer())
+			return;
+		cl450_decode_needdata = false;
+	}
+	/* caller checked that videoram[cl450_videoram_write] is free */
+	cl450_decode_slot = cl450_videoram_write;
+	cl450_decode_colormode = currprefs.color_mode;
+	cl450_decode_busy = true;
+	uae_sem_post(&cl450_decode_start_sem);
 #endif
 }
 
 static void cl450_reset(void)
 {
+#ifdef WITH_LIBMPEG2
+	cl450_decode_wait();
+#endif
 	cl450_play = 0;
 	cl450_pending_interrupts = 0;
 	cl450_interruptmask = 0;
@@ -916,6 +1045,7 @@ static void cl450_reset(void)
 	cl450_videoram_cnt = 0;
 	memset(cl450_regs, 0, sizeof cl450_regs);
 #ifdef WITH_LIBMPEG2
+	cl450_decode_needdata = false;
 	if (mpeg_decoder)
 		mpeg2_reset(mpeg_decoder, 1);
 #endif
@@ -1529,6 +1659,10 @@ void cd32_fmv_hsync_handler(void)
 	if (vpos & 7)
 		return;
 
+#ifdef WITH_LIBMPEG2
+	cl450_decode_poll();
+#endif
+
 	if (cl450_play > 0) {
 		if (cl450_newpacket_mode && cl450_buffer_offset < cl450_threshold) {
 			int newpacket_len = 0;
@@ -1547,6 +1681,9 @@ void cd32_fmv_hsync_handler(void)
 
 void cd32_fmv_reset(void)
 {
+#ifdef WITH_LIBMPEG2
+	cl450_decode_wait();
+#endif
 	if (fmv_ram_bank.baseaddr)
 		memset(fmv_ram_bank.baseaddr, 0, fmv_ram_bank.allocated_size);
 	cd32_fmv_state(0);
@@ -1554,6 +1691,10 @@ void cd32_fmv_reset(void)
 
 void cd32_fmv_free(void)
 {
+#ifdef WITH_LIBMPEG2
+	/* the decode thread reads the stream from fmv_ram_bank */
+	cl450_decode_stop_thread();
+#endif
 	mapped_free(&fmv_rom_bank);
 	mapped_free(&fmv_ram_bank);
 	xfree(audioram);
@@ -1621,6 +1762,7 @@ addrbank *cd32_fmv_init (struct autoconfig_info *aci)
 		mpeg_decoder = mpeg2_init();
 		mpeg_info = mpeg2_info(mpeg_decoder);
 	}
+	cl450_decode_start_thread();
 #endif
 	memset(&cas, 0, sizeof(cas));
 	fmv_bank.mask = fmv_board_size - 1;
@@ -2664,6 +2664,7 @@ void cfgfile_save_options (struct zfile *f, struct uae_prefs *p, int type)
 	cfgfile_dwrite_bool (f, _T("state_replay_autoplay"), p->inprec_autoplay);
 	cfgfile_dwrite_bool (f, _T("warp"), p->turbo_emulation);
 	cfgfile_dwrite (f, _T("warp_limit"), _T("%d"), p->turbo_emulation_limit);
+	cfgfile_dwrite (f, _T("warp_frameskip"), _T("%d"), p->turbo_emulation_frameskip);
 
 #ifdef FILESYS
 	write_filesys_config (p, f);
@@ -2832,6 +2833,20 @@ static int cfgfile_intval (const TCHAR *option, const TCHAR *value, const TCHAR
 	return r;
 }
 
+/* Like cfgfile_intval, but values outside min..max are clamped. */
+static int cfgfile_intval_range (const TCHAR *option, const TCHAR *value, const TCHAR *name, int *location, int min, int max)
+{
+	int v;
+	if (!cfgfile_intval (option, value, name, NULL, &v, 1))
+		return 0;
+	if (v < min || v > max) {
+		cfgfile_warning(_T("Option '%s' must be between %d and %d (was '%s').\n"), option, min, max, value);
+		v = v < min ? min : max;
+	}
+	*location = v;
+	return 1;
+}
+
 static int cfgfile_strval (const TCHAR *option, const TCHAR *value, const TCHAR *name, const TCHAR *nameext, int *location, const TCHAR *table[], int more)
 {
 	int val;
@@ -3276,6 +3291,7 @@ static int cfgfile_parse_host (struct uae_prefs *p, TCHAR *option, TCHAR *value)
 		|| cfgfile_intval (option, value, _T("sampler_frequency"), &p->sampler_freq, 1)
 		|| cfgfile_intval (option, value, _T("sampler_buffer"), &p->sampler_buffer, 1)
 		|| cfgfile_intval(option, value, _T("warp_limit"), &p->turbo_emulation_limit, 1)
+		|| cfgfile_intval_range(option, value, _T("warp_frameskip"), &p->turbo_emulation_frameskip, 1, 100)
 		|| cfgfile_intval(option, value, _T("power_led_dim"), &p->power_led_dim, 1)
 
 		|| cfgfile_intval(option, value, _T("gfx_frame_slices"), &p->gfx_display_sections, 1)
@@ -7822,6 +7838,7 @@ void default_prefs (struct uae_prefs *p, bool reset, int type)
 	p->cpu_idle = 0;
 	p->turbo_emulation = 0;
 	p->turbo_emulation_limit = 0;
+	p->turbo_emulation_frameskip = 10;
 	p->headless = 0;
 	p->catweasel = 0;
 	p->tod_hack = 0;
@@ -8099,6 +8116,7 @@ static void buildin_default_prefs (struct uae_prefs *p)
 	p->cpu_idle = 0;
 	p->turbo_emulation = 0;
 	p->turbo_emulation_limit = 0;
+	p->turbo_emulation_frameskip = 10;
 	p->catweasel = 0;
 	p->tod_hack = 0;
 	p->maprom = 0;
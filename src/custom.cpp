@@ -12002,6 +12002,12 @@ void check_prefs_changed_custom (void)
 			warpmode (changed_prefs.turbo_emulation);
 		}
 	}
+	if (currprefs.turbo_emulation_frameskip != changed_prefs.turbo_emulation_frameskip) {
+		currprefs.turbo_emulation_frameskip = changed_prefs.turbo_emulation_frameskip;
+		if (currprefs.turbo_emulation && currprefs.turbo_emulation_frameskip > 0 && !currprefs.cpu_memory_cycle_exact && !currprefs.blitter_cycle_exact) {
+			changed_prefs.gfx_framerate = currprefs.gfx_framerate = currprefs.turbo_emulation_frameskip;
+		}
+	}
 	if (currprefs.turbo_emulation != changed_prefs.turbo_emulation)
 		warpmode (changed_prefs.turbo_emulation);
 	if (inputdevice_config_change_test ()) 
@@ -60,6 +60,7 @@
 #include "ethernet.h"
 #include "drawing.h"
 #include "videograb.h"
+#include "specialmonitors.h"
 #include "arcadia.h"
 #include "rommgr.h"
 #include "newcpu.h"
@@ -409,6 +410,7 @@ void do_leave_program (void)
 	uaesndboard_free();
 #endif
 	gfxboard_free();
+	specialmonitor_free();
 #ifdef SAVESTATE
 	savestate_free ();
 #endif
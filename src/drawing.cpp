@@ -155,6 +155,7 @@ struct spritepixelsbuf {
 	uae_u8 stdata;
 	uae_u16 stfmdata;
 	uae_u16 data;
+	uae_u16 unused; /* 8 bytes, see draw_sprites_1 */
 };
 static struct spritepixelsbuf spritepixels_buffer[MAX_PIXELS_PER_LINE];
 static struct spritepixelsbuf *spritepixels;
@@ -2116,6 +2117,112 @@ static void dummy_worker (int start, int stop, int blank)
 static int ham_decode_pixel;
 static unsigned int ham_lastcolor;
 
+/* HAM decoding as a scan.
+ *
+ * Each HAM pixel either loads a palette color or replaces one color
+ * component, in other words it does color = (color & keep) | val. The
+ * steps are computed without branches (HAM data is too random for the
+ * branch predictor) and only the color is carried from pixel to pixel.
+ * The decoder only uses its arguments, so lines can be decoded
+ * independently.
+ */
+
+#define HAM_DECODE_HAM6_ECS 0
+#define HAM_DECODE_HAM6_AGA 1
+#define HAM_DECODE_HAM8 2
+
+struct ham_decoder
+{
+	int mode;
+	int bplxor;
+	const uae_u16 *color_regs_ecs;
+#ifdef AGA
+	const uae_u32 *color_regs_aga;
+#endif
+};
+
+static const uae_u32 ham_decode_keep[3][4] = {
+	{ 0x000, 0xff0, 0x0ff, 0xf0f },
+	{ 0x000000, 0xffff00, 0x00ffff, 0xff00ff },
+	{ 0x000000, 0xffff03, 0x03ffff, 0xff03ff }
+};
+static const uae_u32 ham_decode_load[4] = { 0xffffffff, 0, 0, 0 };
+static const uae_u8 ham_decode_shift[3][4] = {
+	{ 0, 0, 8, 4 },
+	{ 0, 0, 16, 8 },
+	{ 0, 0, 16, 8 }
+};
+
+STATIC_INLINE void ham_decode_step(const struct ham_decoder *hd, int mode, int pw, uae_u32 *keep, uae_u32 *val)
+{
+	int ctl;
+	uae_u32 pal, comp;
+
+#ifdef AGA
+	if (mode == HAM_DECODE_HAM8) {
+		int pv = pw ^ hd->bplxor;
+		ctl = pv & 3;
+		pal = hd->color_regs_aga[pv >> 2] & 0xffffff;
+		comp = pw & 0xfc;
+	} else if (mode == HAM_DECODE_HAM6_AGA) {
+		int pv = pw ^ hd->bplxor;
+		ctl = (pv >> 4) & 3;
+		pal = hd->color_regs_aga[pv & 0x0f] & 0xffffff;
+		comp = ((pw & 0xf) << 0) | ((pw & 0xf) << 4);
+	} else
+#endif
+	{
+		ctl = (pw >> 4) & 3;
+		/* pw < 0x10 when it is a palette index */
+		pal = hd->color_regs_ecs[pw & 0x0f] & 0xfff;
+		comp = pw & 0xf;
+	}
+	*keep = ham_decode_keep[mode][ctl];
+	*val = (pal & ham_decode_load[ctl]) | ((comp << ham_decode_shift[mode][ctl]) & ~ham_decode_load[ctl]);
+}
+
+/* Decode len pixels starting with color, store the colors in dst (if not
+ * NULL) and return the last color. */
+STATIC_INLINE uae_u32 ham_decode_pixels(const struct ham_decoder *hd, int mode, const uae_u8 *src, uae_u32 *dst, int len, uae_u32 color)
+{
+	for (int i = 0; i < len; i++) {
+		uae_u32 keep, val;
+		ham_decode_step(hd, mode, src[i], &keep, &val);
+		color = (color & keep) | val;
+		if (dst)
+			dst[i] = color;
+	}
+	return color;
+}
+
+static uae_u32 ham_decode_line(const struct ham_decoder *hd, const uae_u8 *src, uae_u32 *dst, int len, uae_u32 color)
+{
+	switch (hd->mode)
+	{
+#ifdef AGA
+	case HAM_DECODE_HAM8:
+		return ham_decode_pixels(hd, HAM_DECODE_HAM8, src, dst, len, color);
+	case HAM_DECODE_HAM6_AGA:
+		return ham_decode_pixels(hd, HAM_DECODE_HAM6_AGA, src, dst, len, color);
+#endif
+	default:
+		return ham_decode_pixels(hd, HAM_DECODE_HAM6_ECS, src, dst, len, color);
+	}
+}
+
+/* HAM decoder for the current drawing state */
+static void init_ham_decoder(struct ham_decoder *hd)
+{
+	hd->mode = HAM_DECODE_HAM6_ECS;
+	hd->bplxor = bplxor;
+	hd->color_regs_ecs = colors_for_drawing.color_regs_ecs;
+#ifdef AGA
+	hd->color_regs_aga = colors_for_drawing.color_regs_aga;
+	if (currprefs.chipset_mask & CSMASK_AGA)
+		hd->mode = bplplanecnt >= 7 ? HAM_DECODE_HAM8 : HAM_DECODE_HAM6_AGA;
+#endif
+}
+
 /* Decode HAM in the invisible portion of the display (left of VISIBLE_LEFT_BORDER),
  * but don't draw anything in.  This is done to prepare HAM_LASTCOLOR for later,
  * when decode_ham runs.
@@ -2138,48 +2245,11 @@ static void init_ham_decoding (void)
 #endif
 				ham_lastcolor = colors_for_drawing.color_regs_ecs[pv] & 0xfff;
 		}
-#ifdef AGA
-	} else if (currprefs.chipset_mask & CSMASK_AGA) {
-		if (bplplanecnt >= 7) { /* AGA mode HAM8 */
-			while (unpainted_amiga-- > 0) {
-				int pw = pixdata.apixels[ham_decode_pixel++];
-				int pv = pw ^ bplxor;
-				int pc = pv >> 2;
-				switch (pv & 0x3)
-				{
-				case 0x0: ham_lastcolor = colors_for_drawing.color_regs_aga[pc] & 0xffffff; break;
-				case 0x1: ham_lastcolor &= 0xFFFF03; ham_lastcolor |= (pw & 0xFC); break;
-				case 0x2: ham_lastcolor &= 0x03FFFF; ham_lastcolor |= (pw & 0xFC) << 16; break;
-				case 0x3: ham_lastcolor &= 0xFF03FF; ham_lastcolor |= (pw & 0xFC) << 8; break;
-				}
-			}
-		} else { /* AGA mode HAM6 */
-			while (unpainted_amiga-- > 0) {
-				int pw = pixdata.apixels[ham_decode_pixel++];
-				int pv = pw ^ bplxor;
-				uae_u32 pc = ((pw & 0xf) << 0) | ((pw & 0xf) << 4);
-				switch (pv & 0x30)
-				{
-				case 0x00: ham_lastcolor = colors_for_drawing.color_regs_aga[pv & 0x0f] & 0xffffff; break;
-				case 0x10: ham_lastcolor &= 0xFFFF00; ham_lastcolor |= pc << 0; break;
-				case 0x20: ham_lastcolor &= 0x00FFFF; ham_lastcolor |= pc << 16; break;
-				case 0x30: ham_lastcolor &= 0xFF00FF; ham_lastcolor |= pc << 8; break;
-				}
-			}
-		}
-#endif
-	} else {
-		/* OCS/ECS mode HAM6 */
-		while (unpainted_amiga-- > 0) {
-			int pv = pixdata.apixels[ham_decode_pixel++];
-			switch (pv & 0x30)
-			{
-			case 0x00: ham_lastcolor = colors_for_drawing.color_regs_ecs[pv] & 0xfff; break;
-			case 0x10: ham_lastcolor &= 0xFF0; ham_lastcolor |= (pv & 0xF); break;
-			case 0x20: ham_lastcolor &= 0x0FF; ham_lastcolor |= (pv & 0xF) << 8; break;
-			case 0x30: ham_lastcolor &= 0xF0F; ham_lastcolor |= (pv & 0xF) << 4; break;
-			}
-		}
+	} else if (unpainted_amiga > 0) {
+		struct ham_decoder hd;
+		init_ham_decoder(&hd);
+		ham_lastcolor = ham_decode_line(&hd, pixdata.apixels + ham_decode_pixel, NULL, unpainted_amiga, ham_lastcolor);
+		ham_decode_pixel += unpainted_amiga;
 	}
 }
 
@@ -2199,51 +2269,11 @@ static void decode_ham (int pix, int stoppos, int blank)
 
 			ham_linebuf[ham_decode_pixel++] = ham_lastcolor;
 		}
-#ifdef AGA
-	} else if (currprefs.chipset_mask & CSMASK_AGA) {
-		if (bplplanecnt >= 7) { /* AGA mode HAM8 */
-			while (todraw_amiga-- > 0) {
-				int pw = pixdata.apixels[ham_decode_pixel];
-				int pv = pw ^ bplxor;
-				int pc = pv >> 2;
-				switch (pv & 0x3)
-				{
-				case 0x0: ham_lastcolor = colors_for_drawing.color_regs_aga[pc] & 0xffffff; break;
-				case 0x1: ham_lastcolor &= 0xFFFF03; ham_lastcolor |= (pw & 0xFC); break;
-				case 0x2: ham_lastcolor &= 0x03FFFF; ham_lastcolor |= (pw & 0xFC) << 16; break;
-				case 0x3: ham_lastcolor &= 0xFF03FF; ham_lastcolor |= (pw & 0xFC) << 8; break;
-				}
-				ham_linebuf[ham_decode_pixel++] = ham_lastcolor;
-			}
-		} else { /* AGA mode HAM6 */
-			while (todraw_amiga-- > 0) {
-				int pw = pixdata.apixels[ham_decode_pixel];
-				int pv = pw ^ bplxor;
-				uae_u32 pc = ((pw & 0xf) << 0) | ((pw & 0xf) << 4);
-				switch (pv & 0x30)
-				{
-				case 0x00: ham_lastcolor = colors_for_drawing.color_regs_aga[pv & 0x0f] & 0xffffff; break;
-				case 0x10: ham_lastcolor &= 0xFFFF00; ham_lastcolor |= pc << 0; break;
-				case 0x20: ham_lastcolor &= 0x00FFFF; ham_lastcolor |= pc << 16; break;
-				case 0x30: ham_lastcolor &= 0xFF00FF; ham_lastcolor |= pc << 8; break;
-				}
-				ham_linebuf[ham_decode_pixel++] = ham_lastcolor;
-			}
-		}
-#endif
-	} else {
-		/* OCS/ECS mode HAM6 */
-		while (todraw_amiga-- > 0) {
-			int pv = pixdata.apixels[ham_decode_pixel];
-			switch (pv & 0x30)
-			{
-			case 0x00: ham_lastcolor = colors_for_drawing.color_regs_ecs[pv] & 0xfff; break;
-			case 0x10: ham_lastcolor &= 0xFF0; ham_lastcolor |= (pv & 0xF); break;
-			case 0x20: ham_lastcolor &= 0x0FF; ham_lastcolor |= (pv & 0xF) << 8; break;
-			case 0x30: ham_lastcolor &= 0xF0F; ham_lastcolor |= (pv & 0xF) << 4; break;
-			}
-			ham_linebuf[ham_decode_pixel++] = ham_lastcolor;
-		}
+	} else if (todraw_amiga > 0) {
+		struct ham_decoder hd;
+		init_ham_decoder(&hd);
+		ham_lastcolor = ham_decode_line(&hd, pixdata.apixels + ham_decode_pixel, ham_linebuf + ham_decode_pixel, todraw_amiga, ham_lastcolor);
+		ham_decode_pixel += todraw_amiga;
 	}
 }
 
@@ -2302,6 +2332,40 @@ static void gen_pfield_tables (void)
 
 }
 
+#if defined(__GNUC__) && !defined(WORDS_BIGENDIAN) && (defined(__clang__) || __GNUC__ >= 12)
+#define SPRITE_VECTOR 1
+typedef uae_u16 spr_vec16 __attribute__((vector_size(16)));
+typedef uae_u32 spr_vec32 __attribute__((vector_size(16)));
+typedef uae_u8 spr_vec8 __attribute__((vector_size(8)));
+
+/* Store 8 pixels, each spritepixelsbuf is the 16-bit words
+ * attach | stdata << 8, stfmdata, data and unused. */
+STATIC_INLINE void draw_sprites_8 (struct spritepixelsbuf *spb, const uae_u16 *buf, const uae_u8 *stbuf, const uae_u16 *stfmbuf, int has_attach)
+{
+	const spr_vec16 zero = { 0 };
+	spr_vec8 st;
+	spr_vec16 data, stfm, at;
+	spr_vec32 lo, hi, out;
+
+	memcpy (&data, buf, sizeof data);
+	memcpy (&stfm, stfmbuf, sizeof stfm);
+	memcpy (&st, stbuf, sizeof st);
+	at = (__builtin_convertvector (st, spr_vec16) << 8) | (uae_u16)has_attach;
+	lo = (spr_vec32)__builtin_shufflevector (at, stfm, 0, 8, 1, 9, 2, 10, 3, 11);
+	hi = (spr_vec32)__builtin_shufflevector (data, zero, 0, 8, 1, 9, 2, 10, 3, 11);
+	out = __builtin_shufflevector (lo, hi, 0, 4, 1, 5);
+	memcpy (spb + 0, &out, sizeof out);
+	out = __builtin_shufflevector (lo, hi, 2, 6, 3, 7);
+	memcpy (spb + 2, &out, sizeof out);
+	lo = (spr_vec32)__builtin_shufflevector (at, stfm, 4, 12, 5, 13, 6, 14, 7, 15);
+	hi = (spr_vec32)__builtin_shufflevector (data, zero, 4, 12, 5, 13, 6, 14, 7, 15);
+	out = __builtin_shufflevector (lo, hi, 0, 4, 1, 5);
+	memcpy (spb + 4, &out, sizeof out);
+	out = __builtin_shufflevector (lo, hi, 2, 6, 3, 7);
+	memcpy (spb + 6, &out, sizeof out);
+}
+#endif
+
 /* When looking at this function and the ones that inline it, bear in mind
 what an optimizing compiler will do with this code.  All callers of this
 function only pass in constant arguments (except for E).  This means
@@ -2311,7 +2375,7 @@ STATIC_INLINE void draw_sprites_1 (struct sprite_entry *e, int dualpf, int has_a
 	uae_u16 *buf = spixels + e->first_pixel;
 	uae_u8 *stbuf = spixstate.stb + e->first_pixel;
 	uae_u16 *stfmbuf = spixstate.stbfm + e->first_pixel;
-	int spr_pos, pos;
+	int spr_pos, pos, first, last;
 	int epos = e->pos;
 	int emax = e->max;
 
@@ -2324,15 +2388,26 @@ STATIC_INLINE void draw_sprites_1 (struct sprite_entry *e, int dualpf, int has_a
 	if (spr_pos < sprite_first_x)
 		sprite_first_x = spr_pos;
 
-	for (pos = epos; pos < emax; pos++, spr_pos++) {
-		if (spr_pos >= 0 && spr_pos < MAX_PIXELS_PER_LINE) {
-			spritepixels[spr_pos].data = buf[pos];
-			spritepixels[spr_pos].stdata = stbuf[pos];
-			spritepixels[spr_pos].stfmdata = stfmbuf[pos];
-			spritepixels[spr_pos].attach = has_attach;
-		}
+	/* clip to spritepixels once instead of checking every pixel */
+	first = spr_pos < 0 ? epos - spr_pos : epos;
+	last = emax;
+	if (last - epos + spr_pos > MAX_PIXELS_PER_LINE)
+		last = MAX_PIXELS_PER_LINE - spr_pos + epos;
+	spr_pos -= epos;
+
+	pos = first;
+#ifdef SPRITE_VECTOR
+	for (; pos + 8 <= last; pos += 8)
+		draw_sprites_8 (&spritepixels[spr_pos + pos], buf + pos, stbuf + pos, stfmbuf + pos, has_attach);
+#endif
+	for (; pos < last; pos++) {
+		spritepixels[spr_pos + pos].data = buf[pos];
+		spritepixels[spr_pos + pos].stdata = stbuf[pos];
+		spritepixels[spr_pos + pos].stfmdata = stfmbuf[pos];
+		spritepixels[spr_pos + pos].attach = has_attach;
 	}
 
+	spr_pos += emax > epos ? emax : epos;
 	if (spr_pos > sprite_last_x)
 		sprite_last_x = spr_pos;
 }
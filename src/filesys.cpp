@@ -165,6 +165,11 @@ static uae_u32 segtrack_mode = 0;
 #define FS_STARTUP 0
 #define FS_GO_DOWN 1
 
+#ifdef FSUAE
+/* packet threads per unit, see filesys_iteration */
+#define FILESYS_WORKERS 4
+#endif
+
 #define DEVNAMES_PER_HDF 32
 
 #define UNIT_FILESYSTEM 0
@@ -198,6 +203,12 @@ typedef struct {
 	/* Threading stuff */
 	smp_comm_pipe *volatile unit_pipe, *volatile back_pipe;
 	uae_thread_id tid;
+#ifdef FSUAE
+	uae_thread_id worker_tid[FILESYS_WORKERS - 1];
+	int workers;
+	/* taken to read a packet from unit_pipe */
+	uae_sem_t dequeue_sem;
+#endif
 	struct _unit *self;
 	/* Reset handling */
 	uae_sem_t reset_sync_sem;
@@ -1355,6 +1366,12 @@ typedef struct key {
 	int createmode;
 	int notifyactive;
 	struct lockrecord *record;
+#ifdef FSUAE
+	/* host I/O in progress without packet_sem, see key_io_begin */
+	int io_busy;
+	/* packets waiting for this key, in order */
+	uae_u32 io_next, io_serving;
+#endif
 } Key;
 
 typedef struct notify {
@@ -1377,7 +1394,6 @@ typedef struct exallkey {
 
 #define EXKEYS 128
 #define EXALLKEYS 100
-#define MAX_AINO_HASH 128
 #define NOTIFY_HASH_SIZE 127
 
 /* handler state info */
@@ -1419,7 +1435,10 @@ typedef struct _unit {
 
 	a_inode rootnode;
 	unsigned int aino_cache_size;
-	a_inode *aino_hash[MAX_AINO_HASH];
+	/* a_inodes by uniq, chained through uniq_next */
+	a_inode **aino_hash;
+	unsigned int aino_hash_size;
+	unsigned int aino_hash_count;
 	unsigned int nr_cache_hits;
 	unsigned int nr_cache_lookups;
 
@@ -1448,6 +1467,17 @@ typedef struct _unit {
 	bool newreadonly;
 	int newflags;
 
+#ifdef FSUAE
+	/* held while a packet (or filesys_vsync) uses the unit */
+	uae_sem_t packet_sem;
+	/* packets sleeping in unit_wait */
+	struct unit_waiter *io_waiters;
+	/* host change notification, see filesys_watch_process */
+	struct fsdb_watch *watch;
+	TCHAR *watch_root;
+	bool watch_processing;
+#endif
+
 } Unit;
 
 static uae_u32 a_uniq, key_uniq;
@@ -1751,6 +1781,17 @@ static uae_s32 fs_lseek (struct fs_filehandle *fsf, uae_s32 offset, int whence)
 		return -1;
 	return (uae_s32)v;
 }
+/* Reads at offset without using the file offset, where the host can.  */
+static unsigned int fs_pread (struct fs_filehandle *fsf, void *b, unsigned int size, uae_s64 offset)
+{
+#ifdef FSUAE
+	if (fsf->fstype == FS_DIRECTORY)
+		return my_pread (fsf->of, b, size, offset);
+#endif
+	if (fs_lseek64 (fsf, offset, SEEK_SET) < 0)
+		return 0;
+	return fs_read (fsf, b, size);
+}
 static uae_s64 fs_fsize64 (struct fs_filehandle *fsf)
 {
 	if (fsf->fstype == FS_ARCHIVE)
@@ -2361,6 +2402,190 @@ static void prepare_for_open (TCHAR *name)
 {
 }
 
+/* a_inode lookup by uniq. uniqs are handed out sequentially, so the low
+* bits alone make a good hash. The table doubles when it has more entries
+* than buckets.  */
+#define AINO_HASH_MIN 256
+
+static void aino_hash_resize (Unit *unit, unsigned int size)
+{
+	a_inode **hash = xcalloc (a_inode*, size);
+	for (unsigned int i = 0; i < unit->aino_hash_size; i++) {
+		a_inode *a = unit->aino_hash[i];
+		while (a) {
+			a_inode *next = a->uniq_next;
+			a_inode **hp = &hash[a->uniq & (size - 1)];
+			a->uniq_next = *hp;
+			*hp = a;
+			a = next;
+		}
+	}
+	xfree (unit->aino_hash);
+	unit->aino_hash = hash;
+	unit->aino_hash_size = size;
+}
+
+static void aino_hash_add (Unit *unit, a_inode *aino)
+{
+	a_inode **hp;
+	if (unit->aino_hash_count >= unit->aino_hash_size)
+		aino_hash_resize (unit, unit->aino_hash_size ? unit->aino_hash_size * 2 : AINO_HASH_MIN);
+	hp = &unit->aino_hash[aino->uniq & (unit->aino_hash_size - 1)];
+	aino->uniq_next = *hp;
+	*hp = aino;
+	unit->aino_hash_count++;
+}
+
+static void aino_hash_remove (Unit *unit, a_inode *aino)
+{
+	a_inode **hp;
+	if (unit->aino_hash_size == 0)
+		return;
+	for (hp = &unit->aino_hash[aino->uniq & (unit->aino_hash_size - 1)]; *hp; hp = &(*hp)->uniq_next) {
+		if (*hp == aino) {
+			*hp = aino->uniq_next;
+			aino->uniq_next = 0;
+			unit->aino_hash_count--;
+			return;
+		}
+	}
+}
+
+static void aino_hash_free (Unit *unit)
+{
+	xfree (unit->aino_hash);
+	unit->aino_hash = 0;
+	unit->aino_hash_size = 0;
+	unit->aino_hash_count = 0;
+}
+
+static void set_aino_uniq (Unit *unit, a_inode *aino, uae_u32 uniq)
+{
+	aino_hash_remove (unit, aino);
+	aino->uniq = uniq;
+	aino_hash_add (unit, aino);
+}
+
+/* Per-directory name index, so that looking up a name in a directory with
+* thousands of children does not walk the whole child list. It is only
+* built for directories with at least AINO_NAME_INDEX_MIN children and
+* keyed on the last path component of the aname (case-insensitively) and
+* of the nname. Lookups still do the full comparison, so the hash only
+* needs to be at least as case-insensitive as same_aname.  */
+#define AINO_NAME_INDEX_MIN 16
+
+static const TCHAR *aino_name_part (const TCHAR *name, TCHAR sep)
+{
+	const TCHAR *p = _tcsrchr (name, sep);
+	return p ? p + 1 : name;
+}
+
+static uae_u32 aino_aname_hash (const TCHAR *s)
+{
+	uae_u32 hash = 0;
+	for (; *s; s++) {
+		uae_u32 c = *s;
+		if (sizeof (TCHAR) == 1)
+			c &= 0xff;
+		/* ASCII and ISO-8859-1 upper case, as in utility.library */
+		if ((c >= 'A' && c <= 'Z') || (c >= 0xc0 && c <= 0xde && c != 0xd7))
+			c += 0x20;
+		hash = hash * 31 + c;
+	}
+	return hash;
+}
+
+static uae_u32 aino_nname_hash (const TCHAR *s)
+{
+	uae_u32 hash = 0;
+	for (; *s; s++)
+		hash = hash * 31 + (sizeof (TCHAR) == 1 ? (uae_u8)*s : *s);
+	return hash;
+}
+
+static a_inode **aino_aname_bucket (a_inode *dir, const TCHAR *aname)
+{
+	return &dir->name_hash[aino_aname_hash (aino_name_part (aname, '/')) & (dir->name_hash_size - 1)];
+}
+
+static a_inode **aino_nname_bucket (a_inode *dir, const TCHAR *nname)
+{
+	return &dir->name_hash[dir->name_hash_size +
+		(aino_nname_hash (aino_name_part (nname, FSDB_DIR_SEPARATOR)) & (dir->name_hash_size - 1))];
+}
+
+static void aino_name_index_add (a_inode *dir, a_inode *aino)
+{
+	a_inode **hp = aino_aname_bucket (dir, aino->aname);
+	aino->aname_next = *hp;
+	*hp = aino;
+	hp = aino_nname_bucket (dir, aino->nname);
+	aino->nname_next = *hp;
+	*hp = aino;
+}
+
+static void aino_name_index_build (a_inode *dir)
+{
+	unsigned int size = AINO_NAME_INDEX_MIN;
+	while (size < dir->child_count)
+		size *= 2;
+	xfree (dir->name_hash);
+	dir->name_hash = xcalloc (a_inode*, size * 2);
+	dir->name_hash_size = size;
+	for (a_inode *c = dir->child; c; c = c->sibling)
+		aino_name_index_add (dir, c);
+}
+
+static void aino_name_index_free (a_inode *dir)
+{
+	xfree (dir->name_hash);
+	dir->name_hash = 0;
+	dir->name_hash_size = 0;
+}
+
+/* Returns nonzero if dir has a name index, building it if it is big
+* enough to need one.  */
+static int aino_name_index (a_inode *dir)
+{
+	if (dir->name_hash)
+		return 1;
+	if (dir->child_count < AINO_NAME_INDEX_MIN)
+		return 0;
+	aino_name_index_build (dir);
+	return 1;
+}
+
+static void aino_name_index_insert (a_inode *dir, a_inode *aino)
+{
+	dir->child_count++;
+	if (!dir->name_hash)
+		return;
+	if (dir->child_count > dir->name_hash_size * 2)
+		aino_name_index_build (dir);
+	else
+		aino_name_index_add (dir, aino);
+}
+
+static void aino_name_index_remove (a_inode *dir, a_inode *aino)
+{
+	a_inode **hp;
+	dir->child_count--;
+	if (!dir->name_hash)
+		return;
+	for (hp = aino_aname_bucket (dir, aino->aname); *hp; hp = &(*hp)->aname_next) {
+		if (*hp == aino) {
+			*hp = aino->aname_next;
+			break;
+		}
+	}
+	for (hp = aino_nname_bucket (dir, aino->nname); *hp; hp = &(*hp)->nname_next) {
+		if (*hp == aino) {
+			*hp = aino->nname_next;
+			break;
+		}
+	}
+}
+
 static void de_recycle_aino (Unit *unit, a_inode *aino)
 {
 	aino_test (aino);
@@ -2374,9 +2599,10 @@ static void de_recycle_aino (Unit *unit, a_inode *aino)
 
 static void dispose_aino (Unit *unit, a_inode **aip, a_inode *aino)
 {
-	int hash = aino->uniq % MAX_AINO_HASH;
-	if (unit->aino_hash[hash] == aino)
-		unit->aino_hash[hash] = 0;
+	aino_hash_remove (unit, aino);
+	if (aino->parent)
+		aino_name_index_remove (aino->parent, aino);
+	aino_name_index_free (aino);
 
 	if (aino->dirty && aino->parent)
 		fsdb_dir_writeback (aino->parent);
@@ -2402,6 +2628,7 @@ static void free_all_ainos (Unit *u, a_inode *parent)
 		free_all_ainos (u, a);
 		dispose_aino (u, &parent->child, a);
 	}
+	aino_name_index_free (parent);
 }
 
 static int flush_cache (Unit *unit, int num)
@@ -2533,6 +2760,13 @@ static void move_aino_children (Unit *unit, a_inode *from, a_inode *to)
 	aino_test (to);
 	to->child = from->child;
 	from->child = 0;
+	aino_name_index_free (to);
+	to->child_count = from->child_count;
+	to->name_hash = from->name_hash;
+	to->name_hash_size = from->name_hash_size;
+	from->child_count = 0;
+	from->name_hash = 0;
+	from->name_hash_size = 0;
 	update_child_names (unit, to->child, to);
 }
 
@@ -2575,54 +2809,22 @@ static void delete_aino (Unit *unit, a_inode *aino)
 	dispose_aino (unit, aip, aino);
 }
 
-static a_inode *lookup_sub (a_inode *dir, uae_u32 uniq)
-{
-	a_inode **cp = &dir->child;
-	a_inode *c, *retval;
-
-	for (;;) {
-		c = *cp;
-		if (c == 0)
-			return 0;
-
-		if (c->uniq == uniq) {
-			retval = c;
-			break;
-		}
-		if (c->dir) {
-			a_inode *a = lookup_sub (c, uniq);
-			if (a != 0) {
-				retval = a;
-				break;
-			}
-		}
-		cp = &c->sibling;
-	}
-	if (! dir->locked_children) {
-		/* Move to the front to speed up repeated lookups.  Don't do this if
-		an ExNext is going on in this directory, or we'll terminally
-		confuse it.  */
-		*cp = c->sibling;
-		c->sibling = dir->child;
-		dir->child = c;
-	}
-	return retval;
-}
-
 static a_inode *lookup_aino (Unit *unit, uae_u32 uniq)
 {
 	a_inode *a;
-	int hash = uniq % MAX_AINO_HASH;
 
 	if (uniq == 0)
 		return &unit->rootnode;
-	a = unit->aino_hash[hash];
-	if (a == 0 || a->uniq != uniq)
-		a = lookup_sub (&unit->rootnode, uniq);
-	else
+	a = 0;
+	if (unit->aino_hash_size) {
+		for (a = unit->aino_hash[uniq & (unit->aino_hash_size - 1)]; a; a = a->uniq_next) {
+			if (a->uniq == uniq)
+				break;
+		}
+	}
+	if (a != 0)
 		unit->nr_cache_hits++;
 	unit->nr_cache_lookups++;
-	unit->aino_hash[hash] = a;
 	aino_test (a);
 	return a;
 }
@@ -2803,6 +3005,8 @@ static void init_child_aino_tree (Unit *unit, a_inode *base, a_inode *aino)
 	base->child = aino;
 	aino->next = aino->prev = 0;
 	aino->volflags = unit->volflags;
+	aino_name_index_insert (base, aino);
+	aino_hash_add (unit, aino);
 }
 
 static void init_child_aino (Unit *unit, a_inode *base, a_inode *aino)
@@ -2899,6 +3103,21 @@ static a_inode *create_child_aino (Unit *unit, a_inode *base, TCHAR *rel, int is
 	return aino;
 }
 
+static int child_aino_has_aname (Unit *unit, a_inode *c, const TCHAR *rel, int l0)
+{
+	int l1 = _tcslen (c->aname);
+	return l0 <= l1 && same_aname (rel, c->aname + l1 - l0)
+		&& (l0 == l1 || c->aname[l1-l0-1] == '/') && c->mountcount == unit->mountcount;
+}
+
+static int child_aino_has_nname (Unit *unit, a_inode *c, const TCHAR *rel, int l0)
+{
+	int l1 = _tcslen (c->nname);
+	/* Note: using _tcscmp here.  */
+	return l0 <= l1 && _tcscmp (rel, c->nname + l1 - l0) == 0
+		&& (l0 == l1 || c->nname[l1-l0-1] == FSDB_DIR_SEPARATOR) && c->mountcount == unit->mountcount;
+}
+
 static a_inode *lookup_child_aino (Unit *unit, a_inode *base, TCHAR *rel, int *err)
 {
 	a_inode *c = base->child;
@@ -2912,12 +3131,16 @@ static a_inode *lookup_child_aino (Unit *unit, a_inode *base, TCHAR *rel, int *e
 		return 0;
 	}
 
-	while (c != 0) {
-		int l1 = _tcslen (c->aname);
-		if (l0 <= l1 && same_aname (rel, c->aname + l1 - l0)
-			&& (l0 == l1 || c->aname[l1-l0-1] == '/') && c->mountcount == unit->mountcount)
-			break;
-		c = c->sibling;
+	if (aino_name_index (base)) {
+		for (c = *aino_aname_bucket (base, rel); c != 0; c = c->aname_next) {
+			if (child_aino_has_aname (unit, c, rel, l0))
+				break;
+		}
+	} else {
+		for (; c != 0; c = c->sibling) {
+			if (child_aino_has_aname (unit, c, rel, l0))
+				break;
+		}
 	}
 	if (c != 0)
 		return c;
@@ -2927,25 +3150,37 @@ static a_inode *lookup_child_aino (Unit *unit, a_inode *base, TCHAR *rel, int *e
 	return c;
 }
 
+/* Returns an existing child of base with host name REL.  */
+static a_inode *find_child_aino_nname (Unit *unit, a_inode *base, const TCHAR *rel)
+{
+	a_inode *c;
+	int l0 = _tcslen (rel);
+
+	if (aino_name_index (base)) {
+		for (c = *aino_nname_bucket (base, rel); c != 0; c = c->nname_next) {
+			if (child_aino_has_nname (unit, c, rel, l0))
+				break;
+		}
+	} else {
+		for (c = base->child; c != 0; c = c->sibling) {
+			if (child_aino_has_nname (unit, c, rel, l0))
+				break;
+		}
+	}
+	return c;
+}
+
 /* Different version because for this one, REL is an nname.  */
 static a_inode *lookup_child_aino_for_exnext (Unit *unit, a_inode *base, TCHAR *rel, uae_u32 *err, uae_u64 uniq_external, struct virtualfilesysobject *vfso)
 {
 	a_inode *c = base->child;
-	int l0 = _tcslen (rel);
 	int isvirtual = unit->volflags & (MYVOLUMEINFO_ARCHIVE | MYVOLUMEINFO_CDFS);
 
 	aino_test (base);
 	aino_test (c);
 
 	*err = 0;
-	while (c != 0) {
-		int l1 = _tcslen (c->nname);
-		/* Note: using _tcscmp here.  */
-		if (l0 <= l1 && _tcscmp (rel, c->nname + l1 - l0) == 0
-			&& (l0 == l1 || c->nname[l1-l0-1] == FSDB_DIR_SEPARATOR) && c->mountcount == unit->mountcount)
-			break;
-		c = c->sibling;
-	}
+	c = find_child_aino_nname (unit, base, rel);
 	if (c != 0)
 		return c;
 	if (!isvirtual && !vfso)
@@ -3137,6 +3372,10 @@ static Unit *startup_create_unit(TrapContext *ctx, UnitInfo *uinfo, int num)
 	clear_exkeys (unit);
 	unit->total_locked_ainos = 0;
 	unit->keys = 0;
+#ifdef FSUAE
+	uae_sem_init (&unit->packet_sem, 0, 1);
+	unit->io_waiters = NULL;
+#endif
 	for (i = 0; i < NOTIFY_HASH_SIZE; i++) {
 		Notify *n = unit->notifyhash[i];
 		while (n) {
@@ -3165,8 +3404,6 @@ static Unit *startup_create_unit(TrapContext *ctx, UnitInfo *uinfo, int num)
 	unit->rootnode.volflags = uinfo->volflags;
 	aino_test_init (&unit->rootnode);
 	unit->aino_cache_size = 0;
-	for (i = 0; i < MAX_AINO_HASH; i++)
-		unit->aino_hash[i] = 0;
 	return unit;
 }
 
@@ -3225,10 +3462,20 @@ static void filesys_start_thread (UnitInfo *ui, int nr)
 		init_comm_pipe (ui->unit_pipe, 400, 3);
 		init_comm_pipe (ui->back_pipe, 100, 1);
 #ifdef FSUAE
+		uae_sem_init (&ui->dequeue_sem, 0, 1);
+		ui->workers = 0;
 		if (!uae_deterministic_mode()) {
 #endif
 		uae_start_thread (_T("filesys"), filesys_thread, (void *)ui, &ui->tid);
 #ifdef FSUAE
+		ui->workers = 1;
+		/* more threads, so that slow host I/O does not hold up the
+		* unit's other packets */
+		for (int i = 0; i < FILESYS_WORKERS - 1; i++) {
+			if (!uae_start_thread (_T("filesys"), filesys_thread, (void *)ui, &ui->worker_tid[i]))
+				break;
+			ui->workers++;
+		}
 		}
 #endif
 	}
@@ -3507,7 +3754,7 @@ static void free_key (Unit *unit, Key *k)
 	xfree(k);
 }
 
-static Key *lookup_key (Unit *unit, uae_u32 uniq)
+static Key *find_key (Unit *unit, uae_u32 uniq)
 {
 	Key *k;
 	unsigned int total = 0;
@@ -3522,6 +3769,89 @@ static Key *lookup_key (Unit *unit, uae_u32 uniq)
 	return 0;
 }
 
+#ifdef FSUAE
+struct unit_waiter {
+	uae_sem_t sem;
+	struct unit_waiter *next;
+};
+
+/* Releases packet_sem and wakes all packets sleeping in unit_wait, so
+* they can check again whatever they are waiting for.  */
+static void unit_unlock (Unit *unit)
+{
+	while (unit->io_waiters) {
+		struct unit_waiter *w = unit->io_waiters;
+		unit->io_waiters = w->next;
+		uae_sem_post (&w->sem);
+	}
+	uae_sem_post (&unit->packet_sem);
+}
+
+/* Called with packet_sem held, sleeps until another packet thread has
+* released it with unit_unlock and then takes it again. Each waiter has
+* its own semaphore, a shared one would let a waiter that goes back to
+* sleep take the wakeup of another.  */
+static void unit_wait (Unit *unit)
+{
+	struct unit_waiter w;
+	uae_sem_init (&w.sem, 0, 0);
+	w.next = unit->io_waiters;
+	unit->io_waiters = &w;
+	uae_sem_post (&unit->packet_sem);
+	uae_sem_wait (&w.sem);
+	uae_sem_destroy (&w.sem);
+	uae_sem_wait (&unit->packet_sem);
+}
+#endif
+
+/* Finds the key of a packet's file handle, called with packet_sem held.  */
+static Key *lookup_key (Unit *unit, uae_u32 uniq)
+{
+	Key *k = find_key (unit, uniq);
+#ifdef FSUAE
+	/* Another packet thread is doing host I/O on k, wait for it. Packets
+	* for the same key are let through in the order they arrived.  */
+	if (k && (k->io_busy || k->io_serving != k->io_next)) {
+		uae_u32 ticket = k->io_next++;
+		for (;;) {
+			unit_wait (unit);
+			/* an earlier packet may have closed it */
+			k = find_key (unit, uniq);
+			if (!k)
+				return 0;
+			if (!k->io_busy && k->io_serving == ticket)
+				break;
+		}
+		k->io_serving++;
+	}
+#endif
+	return k;
+}
+
+/* Lets the unit's other packets run during slow host I/O on k. Nothing
+* but k->fd may be used until key_io_end.  */
+static bool key_io_begin (Unit *unit, Key *k)
+{
+#ifdef FSUAE
+	if (k->fd && k->fd->fstype == FS_DIRECTORY) {
+		k->io_busy = 1;
+		unit_unlock (unit);
+		return true;
+	}
+#endif
+	return false;
+}
+
+static void key_io_end (Unit *unit, Key *k, bool io)
+{
+#ifdef FSUAE
+	if (io) {
+		uae_sem_wait (&unit->packet_sem);
+		k->io_busy = 0;
+	}
+#endif
+}
+
 static Key *new_key (Unit *unit)
 {
 	Key *k = xcalloc (Key, 1);
@@ -3664,10 +3994,42 @@ static void notify_send(TrapContext *ctx, Unit *unit, Notify *n)
 	}
 }
 
+#ifdef FSUAE
+/* Tells the watcher about a change made by a packet, so that its host
+* events are not notified a second time by filesys_watch_process.  */
+static void filesys_watch_own_change (Unit *unit, a_inode *a)
+{
+	if (!unit->watch || unit->watch_processing)
+		return;
+	fsdb_watch_ignore (unit->watch, a->nname);
+	/* directory times (updatedirtime) and _UAEFSDB.___ files */
+	if (a->parent)
+		fsdb_watch_ignore (unit->watch, a->parent->nname);
+}
+#endif
+
+static void notify_check_dir(TrapContext *ctx, Unit *unit, a_inode *dir)
+{
+	Notify *n;
+	int hash = notifyhash (dir->aname);
+	for (n = unit->notifyhash[hash]; n; n = n->next) {
+		uaecptr nr = n->notifyrequest;
+		if (same_aname (n->partname, dir->aname)) {
+			int err;
+			a_inode *a2 = find_aino(ctx, unit, 0, n->fullname, &err);
+			if (err == 0 && dir == a2)
+				notify_send(ctx, unit, n);
+		}
+	}
+}
+
 static void notify_check(TrapContext *ctx, Unit *unit, a_inode *a)
 {
 	Notify *n;
 	int hash = notifyhash (a->aname);
+#ifdef FSUAE
+	filesys_watch_own_change (unit, a);
+#endif
 	for (n = unit->notifyhash[hash]; n; n = n->next) {
 		uaecptr nr = n->notifyrequest;
 		if (same_aname (n->partname, a->aname)) {
@@ -3677,18 +4039,8 @@ static void notify_check(TrapContext *ctx, Unit *unit, a_inode *a)
 				notify_send(ctx, unit, n);
 		}
 	}
-	if (a->parent) {
-		hash = notifyhash (a->parent->aname);
-		for (n = unit->notifyhash[hash]; n; n = n->next) {
-			uaecptr nr = n->notifyrequest;
-			if (same_aname (n->partname, a->parent->aname)) {
-				int err;
-				a_inode *a2 = find_aino(ctx, unit, 0, n->fullname, &err);
-				if (err == 0 && a->parent == a2)
-					notify_send(ctx, unit, n);
-			}
-		}
-	}
+	if (a->parent)
+		notify_check_dir(ctx, unit, a->parent);
 }
 
 static void action_add_notify(TrapContext *ctx, Unit *unit, dpacket *packet)
@@ -3766,6 +4118,158 @@ static void	action_remove_notify(TrapContext *ctx, Unit *unit, dpacket *packet)
 	PUT_PCK_RES1 (packet, DOS_TRUE);
 }
 
+#ifdef FSUAE
+
+/* Changes made on the host below mounted directories. The watcher thread
+* (fsdb_watch.cpp) only collects the changed host paths, they are applied
+* here with packet_sem held, either before a packet is handled or from
+* filesys_vsync when the handler is idle, so the a_inode tree is never
+* used by two threads at once.  */
+
+static bool filesys_watch_wanted (Unit *unit)
+{
+	return !(unit->volflags & (MYVOLUMEINFO_ARCHIVE | MYVOLUMEINFO_CDFS))
+		&& unit->ui.rootdir && unit->ui.rootdir[0]
+		&& !uae_deterministic_mode ();
+}
+
+static void filesys_watch_stop (Unit *unit)
+{
+	fsdb_watch_stop (unit->watch);
+	unit->watch = NULL;
+	xfree (unit->watch_root);
+	unit->watch_root = NULL;
+}
+
+/* (Re)starts the watcher when a directory is mounted or replaced.  */
+static void filesys_watch_update (Unit *unit)
+{
+	if (unit->watch_root && filesys_watch_wanted (unit) && !_tcscmp (unit->watch_root, unit->ui.rootdir))
+		return;
+	filesys_watch_stop (unit);
+	if (!filesys_watch_wanted (unit))
+		return;
+	unit->watch_root = my_strdup (unit->ui.rootdir);
+	unit->watch = fsdb_watch_start (unit->watch_root);
+}
+
+/* Finds the a_inode for a host path, if there is one. Otherwise *dir is
+* set to the parent directory's a_inode if that exists.  */
+static a_inode *filesys_watch_lookup (Unit *unit, const TCHAR *nname, a_inode **dir)
+{
+	a_inode *a = &unit->rootnode;
+	int len = _tcslen (unit->rootnode.nname);
+	const TCHAR *p;
+
+	*dir = NULL;
+	if (_tcsncmp (nname, unit->rootnode.nname, len) != 0)
+		return NULL;
+	p = nname + len;
+	while (*p == FSDB_DIR_SEPARATOR)
+		p++;
+	while (*p) {
+		TCHAR part[MAX_DPATH];
+		const TCHAR *end = _tcschr (p, FSDB_DIR_SEPARATOR);
+		int l0 = end ? end - p : _tcslen (p);
+		a_inode *c;
+		if (l0 >= MAX_DPATH)
+			return NULL;
+		memcpy (part, p, l0 * sizeof (TCHAR));
+		part[l0] = 0;
+		c = find_child_aino_nname (unit, a, part);
+		if (c == 0) {
+			if (!end)
+				*dir = a;
+			return NULL;
+		}
+		a = c;
+		p += l0;
+		while (*p == FSDB_DIR_SEPARATOR)
+			p++;
+	}
+	*dir = a->parent;
+	return a;
+}
+
+/* Notifies requests for a file without an a_inode (created or deleted on
+* the host) and for its directory.  */
+static void filesys_watch_notify_name (TrapContext *ctx, Unit *unit, a_inode *dir, const TCHAR *name)
+{
+	Notify *n;
+	int hash = notifyhash (name);
+	for (n = unit->notifyhash[hash]; n; n = n->next) {
+		if (same_aname (n->partname, name)) {
+			int err;
+			a_inode *a2 = find_aino(ctx, unit, 0, n->fullname, &err);
+			if ((err == 0 && a2->parent == dir) || (err == ERROR_OBJECT_NOT_AROUND && a2 == dir))
+				notify_send(ctx, unit, n);
+		}
+	}
+	notify_check_dir (ctx, unit, dir);
+}
+
+/* Re-reads the attributes of an a_inode, or forgets it if the file is gone
+* and nothing uses it.  */
+static void filesys_watch_refresh (Unit *unit, a_inode *a)
+{
+	TCHAR *comment = a->comment;
+	int dir = a->dir;
+
+	if (a == &unit->rootnode || a->dirty || a->deleted || a->vfso)
+		return;
+	a->comment = 0;
+	if (fill_file_attrs (unit, a->parent, a)) {
+		xfree (comment);
+		/* a file replaced by a directory (or the other way around) is
+		* noticed when the a_inode is created again */
+		a->dir = dir;
+		return;
+	}
+	a->comment = comment;
+	if (a->shlock == 0 && !a->elock && a->child == 0)
+		delete_aino (unit, a);
+}
+
+static void filesys_watch_process (TrapContext *ctx, Unit *unit)
+{
+	TCHAR **paths;
+	int overflow;
+
+	if (!unit->watch || !fsdb_watch_pending (unit->watch))
+		return;
+	paths = fsdb_watch_take (unit->watch, &overflow);
+	unit->watch_processing = true;
+	if (overflow) {
+		/* Changes were lost: forget everything not in use and tell
+		* everybody.  */
+		flush_cache (unit, 0);
+		for (int i = 0; i < NOTIFY_HASH_SIZE; i++) {
+			for (Notify *n = unit->notifyhash[i]; n; n = n->next)
+				notify_send (ctx, unit, n);
+		}
+	}
+	for (int i = 0; paths && paths[i]; i++) {
+		a_inode *dir;
+		a_inode *a = filesys_watch_lookup (unit, paths[i], &dir);
+		TRACE((_T("host change %s (%s)\n"), paths[i], a ? a->aname : _T("-")));
+		if (overflow)
+			continue;
+		if (a) {
+			if (a == &unit->rootnode)
+				notify_check_dir (ctx, unit, a);
+			else
+				notify_check (ctx, unit, a);
+			filesys_watch_refresh (unit, a);
+		} else if (dir) {
+			filesys_watch_notify_name (ctx, unit, dir, my_getfilepart (paths[i]));
+		}
+	}
+	unit->watch_processing = false;
+	fsdb_watch_free_paths (paths);
+}
+
+#endif
+
 static void free_lock(TrapContext *ctx, Unit *unit, uaecptr lock)
 {
 	if (! lock)
@@ -4311,7 +4815,7 @@ static void record_timeout(TrapContext *ctx, Unit *unit)
 		for (struct lockrecord *lr = unit->waitingrecords; lr; lr = lr->next) {
 			lr->timeout--;
 			if (lr->timeout == 0) {
-				Key *k = lookup_key (unit, GET_PCK_ARG1 (lr->packet));
+				Key *k = find_key (unit, GET_PCK_ARG1 (lr->packet));
 				PUT_PCK_RES1 (lr->packet, DOS_FALSE);
 				PUT_PCK_RES2 (lr->packet, ERROR_LOCK_TIMEOUT);
 				// mark packet as complete
@@ -4338,7 +4842,7 @@ static void record_check_waiting(TrapContext *ctx, Unit *unit)
 		retry = false;
 		struct lockrecord *prev = NULL;
 		for (struct lockrecord *lr = unit->waitingrecords; lr; lr = lr->next) {
-			Key *k = lookup_key (unit, GET_PCK_ARG1 (lr->packet));
+			Key *k = find_key (unit, GET_PCK_ARG1 (lr->packet));
 			if (!k || !record_hit (unit, k, lr->pos, lr->len, lr->mode)) {
 				if (prev)
 					prev->next = lr->next;
@@ -4470,11 +4974,12 @@ static ExAllKey *getexall (Unit *unit, uaecptr control, int id)
 	return NULL;
 }
 
-static int exalldo(TrapContext *ctx, uaecptr exalldata, uae_u32 exalldatasize, uae_u32 type, uaecptr control, Unit *unit, a_inode *aino)
+/* Builds one ExAll entry on the host and copies it to *expp in one go,
+* the trap interface may be a round trip per access.  */
+static int exalldo(TrapContext *ctx, uaecptr *expp, uaecptr exalldata, uae_u32 exalldatasize, uae_u32 type, Unit *unit, a_inode *aino)
 {
-	uaecptr exp = exalldata;
-	int i;
-	int size, size2;
+	uaecptr exp = *expp;
+	int size, size2, entrysize;
 	int entrytype;
 	const TCHAR *xs = NULL, *commentx = NULL;
 	uae_u32 flags = 15;
@@ -4483,6 +4988,7 @@ static int exalldo(TrapContext *ctx, uaecptr exalldata, uae_u32 exalldatasize, u
 	int fsdb_can = fsdb_cando (unit);
 	uae_u16 uid = 0, gid = 0;
 	char *x = NULL, *comment = NULL;
+	uae_u8 *buf = NULL;
 	int ret = 0;
 
 	memset (&statbuf, 0, sizeof statbuf);
@@ -4544,59 +5050,50 @@ static int exalldo(TrapContext *ctx, uaecptr exalldata, uae_u32 exalldatasize, u
 		size2 += 8;
 	}
 
-	i = trap_get_long(ctx, control + 0);
-	while (i > 0) {
-		exp = trap_get_long(ctx, exp); /* ed_Next */
-		i--;
-	}
-
-	if (exalldata + exalldatasize - exp < size + size2)
+	entrysize = size + size2;
+	if (exalldata + exalldatasize - exp < entrysize)
 		goto end; /* not enough space */
 
 #if EXALL_DEBUG > 0
-	write_log (_T("ID=%d, %d, %08x: '%s'%s\n"),
-		trap_get_long(ctx, control + 4), trap_get_long(ctx, control + 0), exp, xs, aino->dir ? _T(" [DIR]") : _T(""));
+	write_log (_T("%08x: '%s'%s\n"), exp, xs, aino->dir ? _T(" [DIR]") : _T(""));
 #endif
 
-	trap_put_long(ctx, exp, exp + size + size2); /* ed_Next */
+	buf = xcalloc (uae_u8, entrysize);
+	put_long_host(buf, exp + entrysize); /* ed_Next */
 	if (type >= 1) {
-		trap_put_long(ctx, exp + 4, exp + size2);
-		for (i = 0; i <= strlen (x); i++) {
-			trap_put_byte(ctx, exp + size2, x[i]);
-			size2++;
-		}
+		put_long_host(buf + 4, exp + size2);
+		strcpy ((char*)buf + size2, x);
+		size2 += strlen (x) + 1;
 	}
 	if (type >= 2)
-		trap_put_long(ctx, exp + 8, entrytype);
+		put_long_host(buf + 8, entrytype);
 	if (type >= 3)
-		trap_put_long(ctx, exp + 12, statbuf.size > MAXFILESIZE32 ? MAXFILESIZE32 : statbuf.size);
+		put_long_host(buf + 12, statbuf.size > MAXFILESIZE32 ? MAXFILESIZE32 : statbuf.size);
 	if (type >= 4)
-		trap_put_long(ctx, exp + 16, flags);
+		put_long_host(buf + 16, flags);
 	if (type >= 5) {
-		trap_put_long(ctx, exp + 20, days);
-		trap_put_long(ctx, exp + 24, mins);
-		trap_put_long(ctx, exp + 28, ticks);
+		put_long_host(buf + 20, days);
+		put_long_host(buf + 24, mins);
+		put_long_host(buf + 28, ticks);
 	}
 	if (type >= 6) {
-		trap_put_long(ctx, exp + 32, exp + size2);
-		trap_put_byte(ctx, exp + size2, strlen (comment));
-		for (i = 0; i <= strlen (comment); i++) {
-			trap_put_byte(ctx, exp + size2, comment[i]);
-			size2++;
-		}
+		put_long_host(buf + 32, exp + size2);
+		strcpy ((char*)buf + size2, comment);
 	}
 	if (type >= 7) {
-		trap_put_word(ctx, exp + 36, uid);
-		trap_put_word(ctx, exp + 38, gid);
+		put_word_host(buf + 36, uid);
+		put_word_host(buf + 38, gid);
 	}
 	if (type >= 8) {
-		trap_put_long(ctx, exp + 40, statbuf.size >> 32);
-		trap_put_long(ctx, exp + 44, (uae_u32)statbuf.size);
+		put_long_host(buf + 40, statbuf.size >> 32);
+		put_long_host(buf + 44, (uae_u32)statbuf.size);
 	}
+	trap_put_bytes(ctx, buf, exp, entrysize);
 
-	trap_put_long(ctx, control + 0, trap_get_long(ctx, control + 0) + 1);
+	*expp = exp + entrysize;
 	ret = 1;
 end:
+	xfree (buf);
 	xfree (x);
 	xfree (comment);
 	return ret;
@@ -4619,18 +5116,43 @@ static int filesys_readdir(struct fs_dirhandle *d, TCHAR *fn, uae_u64 *uniq)
 	return ok;
 }
 
+#ifdef FSUAE
+/* Stats the entries of base's host directory into the stat snapshot with
+* packet_sem released, so that other packets of the unit are not held up
+* while a large directory is listed.  */
+static void prefetch_directory (Unit *unit, a_inode *base)
+{
+	TCHAR *nname = my_strdup (base->nname);
+	fsdb_stat_snapshot_begin (nname);
+	unit_unlock (unit);
+	fsdb_stat_snapshot_fill ();
+	uae_sem_wait (&unit->packet_sem);
+	xfree (nname);
+}
+#endif
+
 static int action_examine_all_do(TrapContext *ctx, Unit *unit, uaecptr lock, ExAllKey *eak, uaecptr exalldata, uae_u32 exalldatasize, uae_u32 type, uaecptr control)
 {
 	a_inode *aino, *base = NULL;
-	int ok;
+	int ok = 1;
 	uae_u32 err;
 	struct fs_dirhandle *d;
 	TCHAR fn[MAX_DPATH];
+	uaecptr exp = exalldata;
+	uae_u32 entries, i;
 
 	if (lock != 0)
 		base = aino_from_lock(ctx, unit, lock);
 	if (base == 0)
 		base = &unit->rootnode;
+	entries = trap_get_long(ctx, control + 0);
+	for (i = 0; i < entries; i++)
+		exp = trap_get_long(ctx, exp); /* ed_Next */
+#ifdef FSUAE
+	/* uses the snapshot of prefetch_directory on the first call */
+	if (eak->dirhandle->fstype == FS_DIRECTORY)
+		fsdb_stat_snapshot_begin (base->nname);
+#endif
 	for (;;) {
 		uae_u64 uniq = 0;
 		d = eak->dirhandle;
@@ -4639,23 +5161,32 @@ static int action_examine_all_do(TrapContext *ctx, Unit *unit, uaecptr lock, ExA
 				ok = filesys_readdir(d, fn, &uniq);
 			} while (ok && d->fstype == FS_DIRECTORY && (filesys_name_invalid (fn) || fsdb_name_invalid_dir (NULL, fn)));
 			if (!ok)
-				return 0;
+				break;
 		} else {
 			_tcscpy (fn, eak->fn);
 			xfree (eak->fn);
 			eak->fn = NULL;
 		}
 		aino = lookup_child_aino_for_exnext (unit, base, fn, &err, uniq, NULL);
-		if (!aino)
-			return 0;
+		if (!aino) {
+			ok = 0;
+			break;
+		}
 		eak->id = unit->exallid++;
-		trap_put_long(ctx, control + 4, eak->id);
-		if (!exalldo(ctx, exalldata, exalldatasize, type, control, unit, aino)) {
+		if (!exalldo(ctx, &exp, exalldata, exalldatasize, type, unit, aino)) {
 			eak->fn = my_strdup (fn); /* no space in exallstruct, save current entry */
 			break;
 		}
+		entries++;
 	}
-	return 1;
+#ifdef FSUAE
+	/* not kept for the next call, the files may have changed by then */
+	fsdb_stat_snapshot_end ();
+#endif
+	/* the control structure is only updated once per call */
+	trap_put_long(ctx, control + 0, entries); /* eac_Entries */
+	trap_put_long(ctx, control + 4, eak->id); /* eac_LastKey */
+	return ok;
 }
 
 static int action_examine_all_end(TrapContext *ctx, Unit *unit, dpacket *packet)
@@ -4749,6 +5280,18 @@ static int action_examine_all(TrapContext *ctx, Unit *unit, dpacket *packet)
 
 	} else {
 
+#ifdef FSUAE
+		if (!(unit->volflags & (MYVOLUMEINFO_ARCHIVE | MYVOLUMEINFO_CDFS))) {
+			if (lock != 0)
+				base = aino_from_lock(ctx, unit, lock);
+			if (base == 0)
+				base = &unit->rootnode;
+			/* the snapshot stays installed for action_examine_all_do */
+			prefetch_directory (unit, base);
+			/* the lock may have been freed meanwhile */
+			base = NULL;
+		}
+#endif
 		eak = getexall (unit, control, -1);
 		if (!eak)
 			goto fail;
@@ -4776,6 +5319,10 @@ static int action_examine_all(TrapContext *ctx, Unit *unit, dpacket *packet)
 	ok = 1;
 
 fail:
+#ifdef FSUAE
+	/* if action_examine_all_do was not reached */
+	fsdb_stat_snapshot_end ();
+#endif
 	/* Clear last ed_Next. This "list" is quite non-Amiga like.. */
 	exp = exalldata;
 	i = trap_get_long(ctx, control + 0);
@@ -4916,9 +5463,16 @@ static void inject_icons_to_directory(Unit *unit, a_inode *base)
 		TCHAR tmp[256];
 		_stprintf(tmp, _T("%s.info"), aino->aname);
 		bool match = false;
-		for (a_inode *aino2 = base->child; aino2; aino2 = aino2->sibling) {
-			if (!_tcsicmp(aino2->aname, tmp))
-				match = true;
+		if (aino_name_index(base)) {
+			for (a_inode *aino2 = *aino_aname_bucket(base, tmp); aino2; aino2 = aino2->aname_next) {
+				if (!_tcsicmp(aino2->aname, tmp))
+					match = true;
+			}
+		} else {
+			for (a_inode *aino2 = base->child; aino2; aino2 = aino2->sibling) {
+				if (!_tcsicmp(aino2->aname, tmp))
+					match = true;
+			}
 		}
 		if (match)
 			continue;
@@ -4957,6 +5511,10 @@ static void populate_directory (Unit *unit, a_inode *base)
 	}
 	TRACE3((_T("Populating directory, child %s, locked_children %d\n"),
 		base->child ? base->child->nname : _T("<NULL>"), base->locked_children));
+#ifdef FSUAE
+	if (d->fstype == FS_DIRECTORY)
+		fsdb_stat_snapshot_begin (base->nname);
+#endif
 	for (;;) {
 		uae_u64 uniq = 0;
 		TCHAR fn[MAX_DPATH];
@@ -4974,6 +5532,10 @@ static void populate_directory (Unit *unit, a_inode *base)
 		being ExNext()ed, and it will increment the locked counts.  */
 		aino = lookup_child_aino_for_exnext (unit, base, fn, &err, uniq, NULL);
 	}
+#ifdef FSUAE
+	if (d->fstype == FS_DIRECTORY)
+		fsdb_stat_snapshot_end ();
+#endif
 	fs_closedir (d);
 	if (currprefs.filesys_inject_icons || unit->ui.inject_icons)
 		inject_icons_to_directory(unit, base);
@@ -5018,6 +5580,20 @@ static void action_examine_next(TrapContext *ctx, Unit *unit, dpacket *packet, b
 	if (aino == 0)
 		aino = &unit->rootnode;
 	uniq = trap_get_long(ctx, info);
+#ifdef FSUAE
+	if (uniq == aino->uniq && aino->dir && aino->exnext_count == 0 && !(unit->volflags & (MYVOLUMEINFO_ARCHIVE | MYVOLUMEINFO_CDFS))) {
+		prefetch_directory (unit, aino);
+		/* the lock may have been freed meanwhile */
+		aino = 0;
+		if (lock != 0)
+			aino = aino_from_lock(ctx, unit, lock);
+		if (aino == 0)
+			aino = &unit->rootnode;
+		/* the snapshot is only used by populate_directory below */
+		if (uniq != aino->uniq || !aino->dir || aino->exnext_count != 0)
+			fsdb_stat_snapshot_end ();
+	}
+#endif
 	for (;;) {
 		if (uniq == aino->uniq) {
 			// first exnext
@@ -5027,6 +5603,9 @@ static void action_examine_next(TrapContext *ctx, Unit *unit, dpacket *packet, b
 			}
 			if (aino->exnext_count++ == 0)
 				populate_directory (unit, aino);
+#ifdef FSUAE
+			fsdb_stat_snapshot_end ();
+#endif
 			if (!aino->child)
 				goto no_more_entries;
 			daino = aino->child;
@@ -5221,6 +5800,11 @@ static void do_find(TrapContext *ctx, Unit *unit, dpacket *packet, int mode, int
 	k->dosmode = mode;
 	k->createmode = create;
 	k->notifyactive = create ? 1 : 0;
+#ifdef FSUAE
+	/* notified when the file is closed, not when it is created */
+	if (create || (mode & A_FIBF_WRITE))
+		filesys_watch_own_change (unit, aino);
+#endif
 
 	if (create && isvirtual)
 		fsdb_set_file_attrs (aino);
@@ -5360,6 +5944,12 @@ static void	action_end(TrapContext *ctx, Unit *unit, dpacket *packet)
 			notify_check(ctx, unit, k->aino);
 			updatedirtime (k->aino, 1);
 		}
+#ifdef FSUAE
+		else if (k->dosmode & A_FIBF_WRITE) {
+			/* closing it still gives a host event */
+			filesys_watch_own_change (unit, k->aino);
+		}
+#endif
 		if (k->aino->elock)
 			k->aino->elock = 0;
 		else
@@ -5401,6 +5991,17 @@ static void	action_read(TrapContext *ctx, Unit *unit, dpacket *packet)
 		}
 		PUT_PCK_RES1 (packet, actual);
 		size = 0;
+	} else if (!trap_is_indirect() && real_address_allowed() && trap_valid_address(ctx, addr, size)) {
+		/* Plain Amiga memory: read straight into it. A short read means
+		* end of file, so the file size is not needed.  */
+		uae_u8 *realpt = get_real_address (addr);
+		bool io = key_io_begin (unit, k);
+		actual = fs_pread (k->fd, realpt, size, k->file_pos);
+		key_io_end (unit, k, io);
+		PUT_PCK_RES1 (packet, actual);
+		PUT_PCK_RES2 (packet, 0);
+		k->file_pos += actual;
+		size = 0;
 	} else {
 		/* check if filesize < size */
 		uae_s64 filesize, cur;
@@ -5455,6 +6056,7 @@ static void	action_read(TrapContext *ctx, Unit *unit, dpacket *packet)
 			return;
 		}
 
+		bool io = key_io_begin (unit, k);
 		if (trap_is_indirect() || !real_address_allowed()) {
 
 			uae_u8 buf[RTAREA_TRAP_DATA_EXTRA_SIZE];
@@ -5483,6 +6085,7 @@ static void	action_read(TrapContext *ctx, Unit *unit, dpacket *packet)
 			actual = fs_read (k->fd, realpt, size);
 
 		}
+		key_io_end (unit, k, io);
 
 		if (actual == 0) {
 			PUT_PCK_RES1 (packet, 0);
@@ -5539,6 +6142,7 @@ static void action_write(TrapContext *ctx, Unit *unit, dpacket *packet)
 			return;
 		}
 
+		bool io = key_io_begin (unit, k);
 		if (trap_is_indirect() || !real_address_allowed()) {
 
 			uae_u8 buf[RTAREA_TRAP_DATA_EXTRA_SIZE];
@@ -5566,6 +6170,7 @@ static void action_write(TrapContext *ctx, Unit *unit, dpacket *packet)
 			uae_u8 *realpt = get_real_address (addr);
 			actual = fs_write (k->fd, realpt, size);
 		}
+		key_io_end (unit, k, io);
 
 	} else {
 		/* ugh this is inefficient but easy */
@@ -5637,7 +6242,9 @@ static void	action_seek(TrapContext *ctx, Unit *unit, dpacket *packet)
 		return;
 	}
 
-	res = key_seek(k, pos, whence);
+	/* relative to file_pos, action_read does not move the host file
+	* offset */
+	res = key_seek(k, temppos, SEEK_SET);
 	if (-1 == res || cur > MAXFILESIZE32) {
 		PUT_PCK_RES1 (packet, -1);
 		PUT_PCK_RES2 (packet, ERROR_SEEK_ERROR);
@@ -6003,6 +6610,11 @@ static void	action_set_file_size(TrapContext *ctx, Unit *unit, dpacket *packet)
 		}
 	}
 
+	if (whence == SEEK_CUR) {
+		/* the host file offset is not kept at file_pos */
+		offset += k->file_pos;
+		whence = SEEK_SET;
+	}
 	/* Write one then truncate: that should give the right size in all cases.  */
 	fs_lseek (k->fd, offset, whence);
 	offset = fs_lseek (k->fd, 0, SEEK_CUR);
@@ -6030,6 +6642,17 @@ static int relock_do(Unit *unit, a_inode *a1)
 	Key *k1, *knext;
 	int wehavekeys = 0;
 
+#ifdef FSUAE
+	/* the handles are closed below, no host I/O may be using them */
+	for (k1 = unit->keys; k1; ) {
+		if (k1->aino == a1 && k1->io_busy) {
+			unit_wait (unit);
+			k1 = unit->keys;
+		} else {
+			k1 = k1->next;
+		}
+	}
+#endif
 	for (k1 = unit->keys; k1; k1 = knext) {
 		knext = k1->next;
 		if (k1->aino == a1 && k1->fd) {
@@ -6268,7 +6891,7 @@ static void	action_rename_object(TrapContext *ctx, Unit *unit, dpacket *packet)
 	a2->comment = a1->comment;
 	a1->comment = 0;
 	a2->amigaos_mode = a1->amigaos_mode;
-	a2->uniq = a1->uniq;
+	set_aino_uniq (unit, a2, a1->uniq);
 	a2->elock = a1->elock;
 	a2->shlock = a1->shlock;
 	a2->has_dbentry = a1->has_dbentry;
@@ -6487,6 +7110,8 @@ static void action_change_file_position64(TrapContext *ctx, Unit *unit, dpacket
 			PUT_PCK64_RES2 (packet, ERROR_SEEK_ERROR);
 			return;
 		}
+		pos = temppos;
+		whence = SEEK_SET;
 	}
 	res = key_seek(k, pos, whence);
 
@@ -6551,6 +7176,11 @@ static void action_change_file_size64(TrapContext *ctx, Unit *unit, dpacket *pac
 		}
 	}
 
+	if (whence == SEEK_CUR) {
+		/* the host file offset is not kept at file_pos */
+		offset += k->file_pos;
+		whence = SEEK_SET;
+	}
 	/* Write one then truncate: that should give the right size in all cases.  */
 	fs_lseek (k->fd, offset, whence);
 	offset = key_seek(k, offset, whence);
@@ -6647,6 +7277,11 @@ static void action_set_file_size64(TrapContext *ctx, Unit *unit, dpacket *packet
 		}
 	}
 
+	if (whence == SEEK_CUR) {
+		/* the host file offset is not kept at file_pos */
+		offset += k->file_pos;
+		whence = SEEK_SET;
+	}
 	/* Write one then truncate: that should give the right size in all cases.  */
 	fs_lseek (k->fd, offset, whence);
 	offset = key_seek(k, offset, whence);
@@ -6704,6 +7339,8 @@ static void action_seek64(TrapContext *ctx, Unit *unit, dpacket *packet)
 			PUT_PCK_RES2 (packet, ERROR_SEEK_ERROR);
 			return;
 		}
+		pos = temppos;
+		whence = SEEK_SET;
 	}
 	res = key_seek(k, pos, whence);
 
@@ -6994,7 +7631,20 @@ end:
 	return 0;
 }
 
+static int handle_packet_2(TrapContext *ctx, Unit *unit, dpacket *pck, uae_u32 msg, int isvolume);
+
 static int handle_packet(TrapContext *ctx, Unit *unit, dpacket *pck, uae_u32 msg, int isvolume)
+{
+#ifdef FSUAE
+	/* packet_sem is held by the caller */
+	filesys_watch_update (unit);
+	if (isvolume && !unit->inhibited)
+		filesys_watch_process (ctx, unit);
+#endif
+	return handle_packet_2 (ctx, unit, pck, msg, isvolume);
+}
+
+static int handle_packet_2(TrapContext *ctx, Unit *unit, dpacket *pck, uae_u32 msg, int isvolume)
 {
 	bool noidle = false;
 	int ret = 1;
@@ -7117,12 +7767,21 @@ static int filesys_iteration(UnitInfo *ui)
 	uae_u32 morelocks;
 	TrapContext *ctx;
 
+#ifdef FSUAE
+	/* Several threads take packets from the pipe. The unit is locked
+	* before the next packet can be taken, so packets start in the order
+	* they were sent.  */
+	uae_sem_wait (&ui->dequeue_sem);
+#endif
 	ctx = (TrapContext*)read_comm_pipe_pvoid_blocking(ui->unit_pipe);
 	pck = read_comm_pipe_u32_blocking(ui->unit_pipe);
 	msg = read_comm_pipe_u32_blocking(ui->unit_pipe);
 	morelocks = (uae_u32)read_comm_pipe_int_blocking(ui->unit_pipe);
 
 	if (ui->reset_state == FS_GO_DOWN) {
+#ifdef FSUAE
+		uae_sem_post (&ui->dequeue_sem);
+#endif
 		trap_background_set_complete(ctx);
 		if (pck != 0)
 		   return 1;
@@ -7132,6 +7791,10 @@ static int filesys_iteration(UnitInfo *ui)
 		return 0;
 	}
 
+#ifdef FSUAE
+	uae_sem_wait (&ui->self->packet_sem);
+	uae_sem_post (&ui->dequeue_sem);
+#endif
 	dpacket packet;
 	readdpacket(ctx, &packet, pck);
 
@@ -7187,6 +7850,9 @@ static int filesys_iteration(UnitInfo *ui)
 	trap_multi(ctx, mdp, mdcnt);
 	if (md2[1].params[0] != 0)
 		write_comm_pipe_int(ui->back_pipe, (int)md2[1].params[0], 0);
+#ifdef FSUAE
+	unit_unlock (ui->self);
+#endif
 
 	/* The message is sent by our interrupt handler, so make sure an interrupt happens. */
 	do_uae_int_requested();
@@ -7220,6 +7886,9 @@ static void *filesys_thread (void *unit_v)
 static uae_u32 REGPARAM2 filesys_handler(TrapContext *ctx)
 {
 	bool packet_valid = false;
+#ifdef FSUAE
+	int handled;
+#endif
 	Unit *unit = find_unit(trap_get_areg(ctx, 5));
 	uaecptr packet_addr = trap_get_dreg(ctx, 3);
 	uaecptr message_addr = trap_get_areg(ctx, 4);
@@ -7286,7 +7955,14 @@ static uae_u32 REGPARAM2 filesys_handler(TrapContext *ctx)
 	readdpacket(ctx, &packet, packet_addr);
 	packet_valid = true;
 
+#ifdef FSUAE
+	uae_sem_wait (&unit->packet_sem);
+	handled = handle_packet(ctx, unit, &packet, 0, filesys_isvolume(unit));
+	unit_unlock (unit);
+	if (!handled) {
+#else
 	if (! handle_packet(ctx, unit, &packet, 0, filesys_isvolume(unit))) {
+#endif
 error:
 		if (!packet_valid)
 			readdpacket(ctx, &packet, packet_addr);
@@ -7335,7 +8011,13 @@ void filesys_free_handles (void)
 			xfree (lr);
 		}
 		u->waitingrecords = NULL;
+#ifdef FSUAE
+		uae_sem_wait (&u->packet_sem);
+		filesys_watch_stop (u);
+		uae_sem_post (&u->packet_sem);
+#endif
 		free_all_ainos (u, &u->rootnode);
+		aino_hash_free (u);
 		u->rootnode.next = u->rootnode.prev = &u->rootnode;
 		u->aino_cache_size = 0;
 		xfree (u->newrootdir);
@@ -7353,6 +8035,9 @@ static void filesys_reset2 (void)
 	filesys_free_handles ();
 	for (u = units; u; u = u1) {
 		u1 = u->next;
+#ifdef FSUAE
+		uae_sem_destroy (&u->packet_sem);
+#endif
 		xfree (u);
 	}
 	units = 0;
@@ -7385,10 +8070,17 @@ static void filesys_prepare_reset2 (void)
 			uae_sem_init (&uip[i].reset_sync_sem, 0, 0);
 			uip[i].reset_state = FS_GO_DOWN;
 			/* send death message */
+#ifdef FSUAE
+			/* one for each packet thread */
+			for (int j = 0; j < (uip[i].workers > 1 ? uip[i].workers : 1); j++) {
+#endif
 			write_comm_pipe_pvoid(uip[i].unit_pipe, NULL, 0);
 			write_comm_pipe_int(uip[i].unit_pipe, 0, 0);
 			write_comm_pipe_int(uip[i].unit_pipe, 0, 0);
 			write_comm_pipe_int(uip[i].unit_pipe, 0, 1);
+#ifdef FSUAE
+			}
+#endif
 #ifdef FSUAE
 			if (uae_deterministic_mode()) {
 				while (comm_pipe_has_data(uip[i].unit_pipe)) {
@@ -7401,6 +8093,10 @@ static void filesys_prepare_reset2 (void)
 			uae_sem_wait (&uip[i].reset_sync_sem);
 			uae_end_thread (&uip[i].tid);
 #ifdef FSUAE
+			for (int j = 0; j < uip[i].workers - 1; j++) {
+				uae_sem_wait (&uip[i].reset_sync_sem);
+				uae_end_thread (&uip[i].worker_tid[j]);
+			}
 			}
 #endif
 		}
@@ -9226,7 +9922,20 @@ void filesys_vsync (void)
 				u->newrootdir = NULL;
 			}
 		}
+#ifdef FSUAE
+		/* skipped while a packet thread uses the unit, the record
+		* timeouts are then counted down one frame later */
+		if (uae_sem_trywait (&u->packet_sem) == 0) {
+			record_timeout(ctx, u);
+			/* apply host changes while the handler is idle, so that
+			* notifications are not held back until the next packet */
+			if (u->watch && fsdb_watch_pending (u->watch) && !u->inhibited && filesys_isvolume (u))
+				filesys_watch_process (ctx, u);
+			unit_unlock (u);
+		}
+#else
 		record_timeout(ctx, u);
+#endif
 	}
 
 	for (int i = 0; i < currprefs.mountitems; i++) {
@@ -87,6 +87,11 @@ static FILE *get_fsdb (a_inode *dir, const TCHAR *mode)
 
 	if (!dir->nname)
 		return NULL;
+#ifdef FSUAE
+	/* avoid a failed open for every lookup in directories without one */
+	if (mode[0] == 'r' && !fsdb_dir_cache_has_file (dir->nname, FSDB_FILE))
+		return NULL;
+#endif
 	n = build_nname (dir->nname, FSDB_FILE);
 	f = uae_tfopen (n, mode);
 	xfree (n);
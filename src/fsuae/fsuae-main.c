@@ -1241,6 +1241,18 @@ int main(int argc, char *argv[])
         } else if (strcmp(*arg, "--version") == 0) {
             printf("%s\n", PACKAGE_VERSION);
             exit(0);
+        } else if (strcmp(*arg, "--commit-hard-drive-overlay") == 0) {
+            if (!arg[1] || !arg[2]) {
+                printf("usage: --commit-hard-drive-overlay IMAGE OVERLAY\n");
+                exit(1);
+            }
+            exit(amiga_commit_hard_drive_overlay(arg[1], arg[2]) ? 0 : 1);
+        } else if (strcmp(*arg, "--discard-hard-drive-overlay") == 0) {
+            if (!arg[1]) {
+                printf("usage: --discard-hard-drive-overlay OVERLAY\n");
+                exit(1);
+            }
+            exit(amiga_discard_hard_drive_overlay(arg[1]) ? 0 : 1);
         } else if (strcmp(*arg, "--help") == 0) {
             printf(COPYRIGHT_NOTICE, PACKAGE_VERSION, OS_NAME_2, ARCH_NAME_2);
             printf(EXTRA_HELP_TEXT);
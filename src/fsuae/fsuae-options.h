@@ -6,6 +6,7 @@
 #define OPTION_ACCELERATOR_MEMORY "accelerator_memory"
 #define OPTION_ACCURACY "accuracy"
 #define OPTION_AMIGA_MODEL "amiga_model"
+#define OPTION_AV_RECORD "av_record"
 #define OPTION_BLIZZARD_SCSI_KIT "blizzard_scsi_kit"
 #define OPTION_BSDSOCKET_LIBRARY "bsdsocket_library"
 #define OPTION_CDFS "cdfs"
@@ -44,6 +45,8 @@
 #define OPTION_RELATIVE_PATHS "relative_paths"
 #define OPTION_SAVE_STATES "save_states"
 #define OPTION_SERIAL_PORT "serial_port"
+#define OPTION_SHM_EXPORT "shm_export"
+#define OPTION_SHM_EXPORT_REPLACE "shm_export_replace"
 #define OPTION_SLOW_MEMORY "slow_memory"
 #define OPTION_SOUND_CARD "sound_card"
 #define OPTION_STEREO_SEPARATION "stereo_separation"
@@ -839,6 +839,23 @@ void fs_uae_init_video(void)
         g_fs_log_autoscale = true;
     }
 
+    const char *shm_export = fs_config_get_const_string(OPTION_SHM_EXPORT);
+    if (shm_export && shm_export[0]) {
+        if (!amiga_shm_export_init(shm_export, 0,
+                fs_config_get_boolean(OPTION_SHM_EXPORT_REPLACE) == 1)) {
+            fs_emu_warning("Could not set up shared memory export");
+        }
+    }
+
+    char *av_record = fs_config_get_string(OPTION_AV_RECORD);
+    if (av_record && av_record[0]) {
+        av_record = fs_uae_expand_path_and_free(av_record);
+        if (!amiga_avrecord_start(av_record)) {
+            fs_emu_warning("Could not start audio/video recording");
+        }
+    }
+    free(av_record);
+
     const char* cvalue = fs_config_get_const_string(OPTION_THEME_ZOOM);
     if (cvalue) {
         zoom_mode *z = g_zoom_modes + CUSTOM_ZOOM_MODE;
@@ -48,6 +48,11 @@ static bool memlogw = true;
 
 #define MONITOR_SWITCH_DELAY 25
 
+// VRAM dirty tracking granularity, and how often (in vsyncs) the whole
+// screen is redrawn anyway when only the dirty pages are trusted.
+#define VRAM_DIRTY_PAGE_SHIFT 12
+#define VRAM_DIRTY_FULL_REFRESH 50
+
 #define GFXBOARD_AUTOCONFIG_SIZE 131072
 
 #define BOARD_REGISTERS_SIZE 0x00010000
@@ -233,6 +238,10 @@ struct rtggfxboard
 	int monswitch_delay;
 	int fullrefresh;
 	bool modechanged;
+	uae_u8 *vram_dirty;
+	int vram_dirty_pages;
+	bool vram_dirty_only;
+	int vram_dirty_counter;
 	uae_u8 *gfxboard_surface, *fakesurface_surface;
 	bool gfxboard_vblank;
 	bool gfxboard_intena;
@@ -434,6 +443,10 @@ static void init_board (struct rtggfxboard *gb)
 	}
 	gb->vram = gb->gfxmem_bank->baseaddr;
 	gb->vramend = gb->gfxmem_bank->baseaddr + vramsize;
+	xfree(gb->vram_dirty);
+	gb->vram_dirty_pages = (vramsize >> VRAM_DIRTY_PAGE_SHIFT) + 1;
+	gb->vram_dirty = xcalloc(uae_u8, gb->vram_dirty_pages);
+	gb->vram_dirty_only = false;
 	gb->vramrealstart = gb->vram;
 	gb->vram += gb->vram_start_offset;
 	gb->vramend += gb->vram_start_offset;
@@ -800,8 +813,51 @@ void qemu_console_resize(QemuConsole *con, int width, int height)
 	gb->vga_height = height;
 }
 
+static void gfxboard_vram_set_dirty(struct rtggfxboard *gb, hwaddr addr, hwaddr size)
+{
+	if (!gb->vram_dirty || !size)
+		return;
+	hwaddr first = addr >> VRAM_DIRTY_PAGE_SHIFT;
+	hwaddr last = (addr + size - 1) >> VRAM_DIRTY_PAGE_SHIFT;
+	if (last >= gb->vram_dirty_pages)
+		last = gb->vram_dirty_pages - 1;
+	if (first > last)
+		return;
+	memset(gb->vram_dirty + first, 1, last - first + 1);
+}
+
+// Called for every CPU write to VRAM, size is at most 4 bytes
+STATIC_INLINE void gfxboard_vram_put_dirty(struct rtggfxboard *gb, uaecptr addr, int size)
+{
+	uaecptr first = addr >> VRAM_DIRTY_PAGE_SHIFT;
+	uaecptr last = (addr + size - 1) >> VRAM_DIRTY_PAGE_SHIFT;
+	if (last < gb->vram_dirty_pages) {
+		gb->vram_dirty[first] = 1;
+		gb->vram_dirty[last] = 1;
+	}
+}
+
+static bool gfxboard_vram_get_dirty(struct rtggfxboard *gb, hwaddr addr, hwaddr size)
+{
+	if (!gb->vram_dirty)
+		return true;
+	if (!size)
+		return false;
+	hwaddr first = addr >> VRAM_DIRTY_PAGE_SHIFT;
+	hwaddr last = (addr + size - 1) >> VRAM_DIRTY_PAGE_SHIFT;
+	if (last >= gb->vram_dirty_pages)
+		return true;
+	for (hwaddr i = first; i <= last; i++) {
+		if (gb->vram_dirty[i])
+			return true;
+	}
+	return false;
+}
+
 void linear_memory_region_set_dirty(MemoryRegion *mr, hwaddr addr, hwaddr size)
 {
+	struct rtggfxboard *gb = (struct rtggfxboard*)mr->data;
+	gfxboard_vram_set_dirty(gb, addr, size);
 }
 
 void vga_memory_region_set_dirty(MemoryRegion *mr, hwaddr addr, hwaddr size)
@@ -809,8 +865,7 @@ void vga_memory_region_set_dirty(MemoryRegion *mr, hwaddr addr, hwaddr size)
 	struct rtggfxboard *gb = (struct rtggfxboard*)mr->data;
 	if (gb->vga.vga.graphic_mode != 1)
 		return;
-	if (!gb->fullrefresh)
-		gb->fullrefresh = 1;
+	gfxboard_vram_set_dirty(gb, addr, size);
 }
 
 #if 0
@@ -1040,6 +1095,15 @@ void gfxboard_vsync_handler(bool full_redraw_required, bool redraw_required)
 
 		if (!gb->monswitch_delay && gb->monswitch_current && ad->picasso_on && ad->picasso_requested_on && !gb->vga_changed) {
 			picasso_getwritewatch(i, gb->vram_start_offset);
+			// Without write watch, the dirty pages are complete unless the
+			// JIT writes to VRAM directly. Host side writes (DMA) are not
+			// tracked at all, so still redraw everything now and then.
+			gb->vram_dirty_only = !picasso_has_write_watch(i) && !currprefs.cachesize;
+			if (gb->vram_dirty_only && ++gb->vram_dirty_counter >= VRAM_DIRTY_FULL_REFRESH) {
+				gb->vram_dirty_counter = 0;
+				if (!gb->fullrefresh)
+					gb->fullrefresh = 1;
+			}
 			if (gb->fullrefresh)
 				gb->vga.vga.graphic_mode = -1;
 			gb->vga_refresh_active = true;
@@ -1171,7 +1235,16 @@ void memory_region_set_enabled(MemoryRegion *mr, bool enabled)
 void memory_region_reset_dirty(MemoryRegion *mr, hwaddr addr,
                                hwaddr size, unsigned client)
 {
+	struct rtggfxboard *gb = (struct rtggfxboard*)mr->data;
 	//write_log (_T("memory_region_reset_dirty %08x %08x\n"), addr, size);
+	if (mr->opaque != &gb->vgavramregionptr || !gb->vram_dirty || !size)
+		return;
+	hwaddr first = addr >> VRAM_DIRTY_PAGE_SHIFT;
+	hwaddr last = (addr + size - 1) >> VRAM_DIRTY_PAGE_SHIFT;
+	if (last >= gb->vram_dirty_pages)
+		last = gb->vram_dirty_pages - 1;
+	if (first <= last)
+		memset(gb->vram_dirty + first, 0, last - first + 1);
 }
 bool memory_region_get_dirty(MemoryRegion *mr, hwaddr addr,
                              hwaddr size, unsigned client)
@@ -1182,6 +1255,12 @@ bool memory_region_get_dirty(MemoryRegion *mr, hwaddr addr,
 	//write_log (_T("memory_region_get_dirty %08x %08x\n"), addr, size);
 	if (gb->fullrefresh)
 		return true;
+	if (gfxboard_vram_get_dirty(gb, addr, size))
+		return true;
+	// Writes that bypass the VRAM handlers (JIT direct access, DMA into
+	// host memory) are only seen by the write watch.
+	if (gb->vram_dirty_only)
+		return false;
 	return picasso_is_vram_dirty (gb->rtg_index, addr + gb->gfxmem_bank->start, size);
 }
 
@@ -1592,6 +1671,7 @@ static void gfxboard_lput_vram (struct rtggfxboard *gb, uaecptr addr, uae_u32 l,
 		}
 	} else {
 		uae_u8 *m = gb->vram + addr;
+		gfxboard_vram_put_dirty(gb, addr, 4);
 		if (bs < 0) {
 			*((uae_u16*)(m + 0)) = l >> 16;
 			*((uae_u16*)(m + 2)) = l >>  0;
@@ -1626,6 +1706,7 @@ static void gfxboard_wput_vram (struct rtggfxboard *gb, uaecptr addr, uae_u16 w,
 		}
 	} else {
 		uae_u8 *m = gb->vram + addr;
+		gfxboard_vram_put_dirty(gb, addr, 2);
 		if (bs)
 			*((uae_u16*)m) = w;
 		else
@@ -1655,6 +1736,7 @@ static void gfxboard_bput_vram (struct rtggfxboard *gb, uaecptr addr, uae_u8 b,
 		else
 			bank->write (&gb->vga, addr, b, 1);
 	} else {
+		gfxboard_vram_put_dirty(gb, addr, 1);
 		if (bs)
 			gb->vram[addr ^ 1] = b;
 		else
@@ -2344,6 +2426,9 @@ static void gfxboard_free_board(struct rtggfxboard *gb)
 	}
 	gb->vram = NULL;
 	gb->vramrealstart = NULL;
+	xfree(gb->vram_dirty);
+	gb->vram_dirty = NULL;
+	gb->vram_dirty_pages = 0;
 	xfree(gb->fakesurface_surface);
 	gb->fakesurface_surface = NULL;
 	gb->configured_mem = 0;
@@ -224,6 +224,16 @@ extern void blkdev_cd_change (int unitnum, const TCHAR *name);
 extern void blkdev_entergui (void);
 extern void blkdev_exitgui (void);
 
+/* sector cache with readahead, for backends that read sectors from image files */
+#define BLKDEV_CACHE_SECTOR_SIZE 2352
+struct blkdev_cache;
+/* read one whole sector of the given (backend defined) type, may be called from the readahead thread */
+typedef bool (*blkdev_cache_fill_func)(void *userdata, int sector, int type, uae_u8 *data);
+extern struct blkdev_cache *blkdev_cache_alloc (blkdev_cache_fill_func fill, void *userdata);
+extern void blkdev_cache_free (struct blkdev_cache *bc);
+extern bool blkdev_cache_read (struct blkdev_cache *bc, int sector, int type, uae_u8 *data, int offset, int size);
+extern void blkdev_cache_stop (struct blkdev_cache *bc);
+
 bool filesys_do_disk_change (int, bool);
 
 extern struct device_functions devicefunc_scsi_ioctl;
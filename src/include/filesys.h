@@ -159,6 +159,12 @@ extern void hdf_close_target (struct hardfiledata *hfd);
 extern int hdf_read_target (struct hardfiledata *hfd, void *buffer, uae_u64 offset, int len);
 extern int hdf_write_target (struct hardfiledata *hfd, void *buffer, uae_u64 offset, int len);
 extern int hdf_resize_target (struct hardfiledata *hfd, uae_u64 newsize);
+#ifdef FSUAE
+/* copy-on-write overlays for hardfiles, see od-fs/hardfile_host.cpp */
+extern int hdf_overlay_set (const TCHAR *path, const TCHAR *overlay_path);
+extern int hdf_overlay_commit (const TCHAR *path, const TCHAR *overlay_path);
+extern int hdf_overlay_discard (const TCHAR *overlay_path);
+#endif
 extern void getchsgeometry (uae_u64 size, int *pcyl, int *phead, int *psectorspertrack);
 extern void getchsgeometry_hdf (struct hardfiledata *hfd, uae_u64 size, int *pcyl, int *phead, int *psectorspertrack);
 extern void getchspgeometry (uae_u64 total, int *pcyl, int *phead, int *psectorspertrack, bool idegeometry);
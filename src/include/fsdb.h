@@ -81,6 +81,15 @@ typedef struct a_inode_struct {
     /* This a_inode's relatives in the directory structure.  */
     struct a_inode_struct *parent;
     struct a_inode_struct *child, *sibling;
+    /* Chains of the unit's uniq hash table and of the parent's name
+     * index.  */
+    struct a_inode_struct *uniq_next;
+    struct a_inode_struct *aname_next, *nname_next;
+    /* For a directory: number of children, and the name index (aname
+     * buckets followed by nname buckets), built once there are many.  */
+    unsigned int child_count;
+    unsigned int name_hash_size;
+    struct a_inode_struct **name_hash;
     /* AmigaOS name, and host OS name.  The host OS name is a full path, the
      * AmigaOS name is relative to the parent.  */
     TCHAR *aname;
@@ -204,6 +213,19 @@ char *fsdb_native_path(const char *root_dir, const char *amiga_path);
 void fsdb_get_file_time(a_inode *node, int *days, int *mins, int *ticks);
 int fsdb_set_file_time(a_inode *node, int days, int mins, int ticks);
 int host_errno_to_dos_errno(int err);
+unsigned int my_pread(struct my_openfile_s *mos, void *b, unsigned int size, uae_s64 offset);
+int fsdb_dir_cache_has_file(const TCHAR *dir_path, const TCHAR *name);
+void fsdb_stat_snapshot_begin(const TCHAR *dir_path);
+void fsdb_stat_snapshot_end(void);
+void fsdb_stat_snapshot_fill(void);
+/* host change notification for directory volumes, see fsdb_watch.cpp */
+struct fsdb_watch;
+struct fsdb_watch *fsdb_watch_start(const TCHAR *rootdir);
+void fsdb_watch_stop(struct fsdb_watch *watch);
+int fsdb_watch_pending(struct fsdb_watch *watch);
+void fsdb_watch_ignore(struct fsdb_watch *watch, const TCHAR *path);
+TCHAR **fsdb_watch_take(struct fsdb_watch *watch, int *overflow);
+void fsdb_watch_free_paths(TCHAR **paths);
 #endif
 
 #endif /* UAE_FSDB_H */
@@ -621,6 +621,7 @@ struct uae_prefs {
 	bool rom_readwrite;
 	int turbo_emulation;
 	int turbo_emulation_limit;
+	int turbo_emulation_frameskip;
 	bool headless;
 	int filesys_limit;
 	int filesys_max_name;
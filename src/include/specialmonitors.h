@@ -10,6 +10,7 @@ bool emulate_specialmonitors(struct vidbuffer *src, struct vidbuffer *dst);
 bool emulate_specialmonitors_line(struct vidbuffer *src, struct vidbuffer *dst, int line);
 void specialmonitor_store_fmode(int vpos, int hpos, uae_u16 fmode);
 void specialmonitor_reset(void);
+void specialmonitor_free(void);
 bool specialmonitor_need_genlock(void);
 bool specialmonitor_uses_control_lines(void);
 bool specialmonitor_autoconfig_init(struct autoconfig_info*);
@@ -56,5 +56,18 @@ extern int g_uae_min_first_line_pal;
 extern int g_uae_min_first_line_ntsc;
 
 void od_fs_update_leds(void);
+void uae_fsvideo_rtg_lines_updated(int monid, int y, int h);
+
+void uae_shm_export_video(const uint8_t *pixels, int width, int height,
+        int stride, int bpp, int crop_x, int crop_y, int crop_w, int crop_h,
+        int flags);
+void uae_shm_export_audio(const int16_t *data, int bytes, int frequency,
+        int channels);
+
+void uae_avrecord_video(const uint8_t *pixels, int width, int height,
+        int stride, int bpp);
+void uae_avrecord_audio(const int16_t *data, int bytes, int frequency,
+        int channels);
+void uae_avrecord_stop(void);
 
 #endif  // UAE_FS_H_
@@ -44,6 +44,21 @@ bool uae_vm_decommit(void *address, uae_u32 size);
 
 int uae_vm_page_size(void);
 
+/* Track writes to committed memory (see vm.cpp). uae_vm_write_watch_get
+ * stores up to *count addresses of written pages in the range and returns
+ * false if the range is not watched. Committing, decommitting or freeing
+ * memory removes overlapping watches. */
+bool uae_vm_write_watch_enable(void *address, uae_u32 size);
+void uae_vm_write_watch_disable(void *address);
+bool uae_vm_write_watch_get(void *address, int size, void **addresses,
+		uintptr_t *count, bool reset);
+void uae_vm_write_watch_reset(void *address, int size);
+/* Makes the pages writable for a system call writing to them, they stay
+ * writable until the matching uae_vm_write_watch_untouch. Any new host
+ * call that writes into Amiga memory must be wrapped in these. */
+bool uae_vm_write_watch_touch(void *address, int size);
+void uae_vm_write_watch_untouch(void *address, int size);
+
 // void *uae_vm_alloc_with_flags(uae_u32 size, int protect, int flags);
 
 #endif /* UAE_VM_H */
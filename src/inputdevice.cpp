@@ -9118,7 +9118,7 @@ void warpmode (int mode)
 	}
 	if (currprefs.turbo_emulation) {
 		if (!currprefs.cpu_memory_cycle_exact && !currprefs.blitter_cycle_exact)
-			changed_prefs.gfx_framerate = currprefs.gfx_framerate = 10;
+			changed_prefs.gfx_framerate = currprefs.gfx_framerate = currprefs.turbo_emulation_frameskip > 0 ? currprefs.turbo_emulation_frameskip : 10;
 		pause_sound ();
 	} else {
 		resume_sound ();
@@ -0,0 +1,430 @@
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#include "options.h"
+#include "custom.h"
+#include "threaddep/thread.h"
+#include "commpipe.h"
+#include "uae/fs.h"
+#include "uae/glib.h"
+
+/*
+ * Records the emulated video frames and Paula output to a Y4M (4:2:0) and
+ * a WAV file. The emulation thread only copies the data and queues it, the
+ * color conversion and file writing happens on a separate thread.
+ *
+ * The number of video frames written follows the emulated vsync counter,
+ * so frames which were not rendered (frame skip) or could not be queued
+ * (slow disk) are written as repeats of the previous frame. This keeps the
+ * video in sync with the audio. Only the pixel data of a frame is ever
+ * dropped: repeats and audio are always queued, and if the writer falls
+ * that far behind, the emulation thread waits for it to make room.
+ */
+
+#define AVRECORD_VIDEO 1
+#define AVRECORD_REPEAT 2
+#define AVRECORD_AUDIO 3
+#define AVRECORD_STOP 4
+
+// Maximum number of video frames waiting to be converted and written,
+// before new frames are recorded as repeats instead.
+#define AVRECORD_MAX_QUEUED_FRAMES 30
+#define AVRECORD_PIPE_SIZE 4096
+
+// Gaps larger than this (e.g. after warp mode) are not filled in
+#define AVRECORD_MAX_REPEAT 100
+
+struct avrecord_job {
+    int type;
+    int width;
+    int height;
+    int bpp;
+    int format;
+    int size;
+    uae_u8 data[1];
+};
+
+static struct {
+    bool active;
+    smp_comm_pipe pipe;
+    uae_thread_id thread;
+    uae_sem_t done;
+    volatile int queued;
+    volatile int queued_frames;
+    bool warned;
+    bool warned_wait;
+
+    // Emulation thread state
+    bool started;
+    bool paused;
+    unsigned long base_timeframes;
+    uae_u64 frames;
+
+    // Writer thread state
+    FILE *video_file;
+    FILE *audio_file;
+    char *video_path;
+    char *audio_path;
+    int out_width;
+    int out_height;
+    uae_u8 *yuv;
+    bool have_yuv;
+    int early_repeats;
+    float frame_rate;
+    int audio_frequency;
+    int audio_channels;
+    uae_u32 audio_bytes;
+} g_avrecord;
+
+static void write_le16(uae_u8 *p, int v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+}
+
+static void write_le32(uae_u8 *p, uae_u32 v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = (v >> 24) & 0xff;
+}
+
+static void write_wav_header(void)
+{
+    uae_u8 h[44];
+    int channels = g_avrecord.audio_channels ? g_avrecord.audio_channels : 2;
+    int frequency = g_avrecord.audio_frequency ?
+            g_avrecord.audio_frequency : 44100;
+    memcpy(h, "RIFF", 4);
+    write_le32(h + 4, 36 + g_avrecord.audio_bytes);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    write_le32(h + 16, 16);
+    write_le16(h + 20, 1);
+    write_le16(h + 22, channels);
+    write_le32(h + 24, frequency);
+    write_le32(h + 28, frequency * channels * 2);
+    write_le16(h + 32, channels * 2);
+    write_le16(h + 34, 16);
+    memcpy(h + 36, "data", 4);
+    write_le32(h + 40, g_avrecord.audio_bytes);
+    fseek(g_avrecord.audio_file, 0, SEEK_SET);
+    fwrite(h, sizeof(h), 1, g_avrecord.audio_file);
+    fseek(g_avrecord.audio_file, 0, SEEK_END);
+}
+
+static inline void get_rgb(const uae_u8 *p, int format, int *r, int *g,
+                           int *b)
+{
+    uae_u16 c;
+    switch (format) {
+    case AMIGA_VIDEO_FORMAT_BGRA:
+        *r = p[2];
+        *g = p[1];
+        *b = p[0];
+        break;
+    case AMIGA_VIDEO_FORMAT_R5G6B5:
+        c = *(const uae_u16 *) p;
+        *r = ((c >> 11) & 0x1f) << 3;
+        *g = ((c >> 5) & 0x3f) << 2;
+        *b = (c & 0x1f) << 3;
+        break;
+    case AMIGA_VIDEO_FORMAT_R5G5B5A1:
+        c = *(const uae_u16 *) p;
+        *r = ((c >> 11) & 0x1f) << 3;
+        *g = ((c >> 6) & 0x1f) << 3;
+        *b = ((c >> 1) & 0x1f) << 3;
+        break;
+    default:
+        *r = p[0];
+        *g = p[1];
+        *b = p[2];
+        break;
+    }
+}
+
+// Convert to BT.601 limited range Y'CbCr 4:2:0. Parts of the output frame
+// not covered by the source frame are black.
+static void convert_frame(struct avrecord_job *job)
+{
+    int ow = g_avrecord.out_width;
+    int oh = g_avrecord.out_height;
+    uae_u8 *yp = g_avrecord.yuv;
+    uae_u8 *up = yp + ow * oh;
+    uae_u8 *vp = up + (ow / 2) * (oh / 2);
+    int stride = job->width * job->bpp;
+
+    memset(yp, 16, ow * oh);
+    memset(up, 128, (ow / 2) * (oh / 2) * 2);
+
+    int w = MIN(job->width, ow) & ~1;
+    int h = MIN(job->height, oh) & ~1;
+    for (int y = 0; y < h; y += 2) {
+        const uae_u8 *s0 = job->data + y * stride;
+        const uae_u8 *s1 = s0 + stride;
+        uae_u8 *y0 = yp + y * ow;
+        uae_u8 *y1 = y0 + ow;
+        uae_u8 *u = up + (y / 2) * (ow / 2);
+        uae_u8 *v = vp + (y / 2) * (ow / 2);
+        for (int x = 0; x < w; x += 2) {
+            int r[4], g[4], b[4];
+            get_rgb(s0, job->format, r + 0, g + 0, b + 0);
+            get_rgb(s0 + job->bpp, job->format, r + 1, g + 1, b + 1);
+            get_rgb(s1, job->format, r + 2, g + 2, b + 2);
+            get_rgb(s1 + job->bpp, job->format, r + 3, g + 3, b + 3);
+            s0 += 2 * job->bpp;
+            s1 += 2 * job->bpp;
+            for (int i = 0; i < 4; i++) {
+                int luma = ((66 * r[i] + 129 * g[i] + 25 * b[i] + 128) >> 8)
+                        + 16;
+                if (i < 2) {
+                    y0[x + i] = luma;
+                } else {
+                    y1[x + i - 2] = luma;
+                }
+            }
+            int ra = (r[0] + r[1] + r[2] + r[3] + 2) >> 2;
+            int ga = (g[0] + g[1] + g[2] + g[3] + 2) >> 2;
+            int ba = (b[0] + b[1] + b[2] + b[3] + 2) >> 2;
+            *u++ = ((-38 * ra - 74 * ga + 112 * ba + 128) >> 8) + 128;
+            *v++ = ((112 * ra - 94 * ga - 18 * ba + 128) >> 8) + 128;
+        }
+    }
+    g_avrecord.have_yuv = true;
+}
+
+static void write_video_frame(struct avrecord_job *job)
+{
+    if (g_avrecord.yuv == NULL) {
+        if (job->type == AVRECORD_REPEAT) {
+            // Nothing to repeat yet, the first frame is written in its
+            // place so that the frame count stays in sync with the audio
+            g_avrecord.early_repeats++;
+            return;
+        }
+        g_avrecord.out_width = (job->width + 1) & ~1;
+        g_avrecord.out_height = (job->height + 1) & ~1;
+        g_avrecord.yuv = (uae_u8 *) malloc(
+                g_avrecord.out_width * g_avrecord.out_height * 3 / 2);
+        int rate = (int) (g_avrecord.frame_rate * 1000.0 + 0.5);
+        fprintf(g_avrecord.video_file,
+                "YUV4MPEG2 W%d H%d F%d:1000 Ip A1:1 C420jpeg\n",
+                g_avrecord.out_width, g_avrecord.out_height, rate);
+    }
+    if (job->type == AVRECORD_VIDEO) {
+        convert_frame(job);
+    }
+    for (; g_avrecord.early_repeats >= 0; g_avrecord.early_repeats--) {
+        fwrite("FRAME\n", 6, 1, g_avrecord.video_file);
+        fwrite(g_avrecord.yuv,
+               g_avrecord.out_width * g_avrecord.out_height * 3 / 2, 1,
+               g_avrecord.video_file);
+    }
+    g_avrecord.early_repeats = 0;
+}
+
+static void write_audio(struct avrecord_job *job)
+{
+    g_avrecord.audio_frequency = job->width;
+    g_avrecord.audio_channels = job->height;
+#ifdef WORDS_BIGENDIAN
+    for (int i = 0; i < job->size; i += 2) {
+        uae_u8 t = job->data[i];
+        job->data[i] = job->data[i + 1];
+        job->data[i + 1] = t;
+    }
+#endif
+    fwrite(job->data, job->size, 1, g_avrecord.audio_file);
+    g_avrecord.audio_bytes += job->size;
+}
+
+static void *avrecord_thread(void *data)
+{
+    while (true) {
+        struct avrecord_job *job = (struct avrecord_job *)
+                read_comm_pipe_pvoid_blocking(&g_avrecord.pipe);
+        int type = job->type;
+        if (type == AVRECORD_VIDEO || type == AVRECORD_REPEAT) {
+            write_video_frame(job);
+            atomic_dec(&g_avrecord.queued_frames);
+        } else if (type == AVRECORD_AUDIO) {
+            write_audio(job);
+        }
+        atomic_dec(&g_avrecord.queued);
+        free(job);
+        if (type == AVRECORD_STOP) {
+            break;
+        }
+    }
+    write_wav_header();
+    fclose(g_avrecord.audio_file);
+    fclose(g_avrecord.video_file);
+    write_log("AVRECORD: wrote %s and %s\n", g_avrecord.video_path,
+              g_avrecord.audio_path);
+    uae_sem_post(&g_avrecord.done);
+    return NULL;
+}
+
+static struct avrecord_job *new_job(int type, int size)
+{
+    struct avrecord_job *job = (struct avrecord_job *) malloc(
+            sizeof(struct avrecord_job) + size);
+    memset(job, 0, sizeof(struct avrecord_job));
+    job->type = type;
+    job->size = size;
+    return job;
+}
+
+static void queue_job(struct avrecord_job *job)
+{
+    // Every queued job is written, so that the number of video frames
+    // matches the audio. When the pipe is full, a video frame is replaced
+    // by a repeat (which carries no data) and the emulation thread waits
+    // in write_comm_pipe_pvoid until the writer has made room.
+    if (g_avrecord.queued >= AVRECORD_PIPE_SIZE - 2) {
+        if (job->type == AVRECORD_VIDEO) {
+            if (!g_avrecord.warned) {
+                write_log("AVRECORD: writer is falling behind, recording "
+                          "video frames as repeats\n");
+                g_avrecord.warned = true;
+            }
+            free(job);
+            job = new_job(AVRECORD_REPEAT, 0);
+        }
+        if (!g_avrecord.warned_wait) {
+            write_log("AVRECORD: writer is falling behind, waiting "
+                      "for it\n");
+            g_avrecord.warned_wait = true;
+        }
+    }
+    atomic_inc(&g_avrecord.queued);
+    write_comm_pipe_pvoid(&g_avrecord.pipe, job, 1);
+}
+
+static void queue_repeat(void)
+{
+    atomic_inc(&g_avrecord.queued_frames);
+    queue_job(new_job(AVRECORD_REPEAT, 0));
+}
+
+int amiga_avrecord_start(const char *path)
+{
+    if (g_avrecord.active) {
+        return 0;
+    }
+    g_avrecord.video_path = g_strdup_printf("%s.y4m", path);
+    g_avrecord.audio_path = g_strdup_printf("%s.wav", path);
+    g_avrecord.video_file = g_fopen(g_avrecord.video_path, "wb");
+    g_avrecord.audio_file = g_fopen(g_avrecord.audio_path, "wb");
+    if (g_avrecord.video_file == NULL || g_avrecord.audio_file == NULL) {
+        write_log("AVRECORD: could not open %s / %s for writing\n",
+                  g_avrecord.video_path, g_avrecord.audio_path);
+        if (g_avrecord.video_file) {
+            fclose(g_avrecord.video_file);
+        }
+        if (g_avrecord.audio_file) {
+            fclose(g_avrecord.audio_file);
+        }
+        g_free(g_avrecord.video_path);
+        g_free(g_avrecord.audio_path);
+        return 0;
+    }
+    // Placeholder, the real header is written when the recording stops
+    write_wav_header();
+
+    init_comm_pipe(&g_avrecord.pipe, AVRECORD_PIPE_SIZE, 1);
+    uae_sem_init(&g_avrecord.done, 0, 0);
+    g_avrecord.started = false;
+    g_avrecord.warned = false;
+    g_avrecord.warned_wait = false;
+    g_avrecord.active = true;
+    uae_start_thread("avrecord", avrecord_thread, NULL, &g_avrecord.thread);
+    write_log("AVRECORD: recording to %s and %s\n", g_avrecord.video_path,
+              g_avrecord.audio_path);
+    return 1;
+}
+
+void uae_avrecord_stop(void)
+{
+    if (!g_avrecord.active) {
+        return;
+    }
+    g_avrecord.active = false;
+    // The stop job must not be dropped, so it bypasses queue_job
+    atomic_inc(&g_avrecord.queued);
+    write_comm_pipe_pvoid(&g_avrecord.pipe, new_job(AVRECORD_STOP, 0), 1);
+    uae_sem_wait(&g_avrecord.done);
+    uae_wait_thread(g_avrecord.thread);
+    uae_sem_destroy(&g_avrecord.done);
+    destroy_comm_pipe(&g_avrecord.pipe);
+    free(g_avrecord.yuv);
+    g_avrecord.yuv = NULL;
+    g_avrecord.have_yuv = false;
+    g_avrecord.early_repeats = 0;
+    g_free(g_avrecord.video_path);
+    g_free(g_avrecord.audio_path);
+}
+
+void uae_avrecord_video(const uint8_t *pixels, int width, int height,
+                        int stride, int bpp)
+{
+    if (!g_avrecord.active || pixels == NULL || width <= 0 || height <= 0) {
+        return;
+    }
+    if (currprefs.turbo_emulation) {
+        // No audio is produced in warp mode, so stop counting frames
+        g_avrecord.paused = true;
+        return;
+    }
+    if (!g_avrecord.started) {
+        g_avrecord.frame_rate = vblank_hz;
+        g_avrecord.base_timeframes = timeframes;
+        g_avrecord.frames = 0;
+        g_avrecord.started = true;
+    } else if (g_avrecord.paused) {
+        g_avrecord.base_timeframes = timeframes - g_avrecord.frames;
+    }
+    g_avrecord.paused = false;
+
+    // Fill in frames which were not rendered since the last one
+    uae_u64 frame = timeframes - g_avrecord.base_timeframes;
+    if (frame > g_avrecord.frames + AVRECORD_MAX_REPEAT) {
+        g_avrecord.base_timeframes = timeframes - g_avrecord.frames;
+        frame = g_avrecord.frames;
+    }
+    while (g_avrecord.frames < frame) {
+        queue_repeat();
+        g_avrecord.frames++;
+    }
+    g_avrecord.frames++;
+
+    if (g_avrecord.queued_frames >= AVRECORD_MAX_QUEUED_FRAMES) {
+        queue_repeat();
+        return;
+    }
+    int line_bytes = width * bpp;
+    struct avrecord_job *job = new_job(AVRECORD_VIDEO, line_bytes * height);
+    job->width = width;
+    job->height = height;
+    job->bpp = bpp;
+    job->format = g_amiga_video_format;
+    for (int y = 0; y < height; y++) {
+        memcpy(job->data + y * line_bytes, pixels + y * stride, line_bytes);
+    }
+    atomic_inc(&g_avrecord.queued_frames);
+    queue_job(job);
+}
+
+void uae_avrecord_audio(const int16_t *data, int bytes, int frequency,
+                        int channels)
+{
+    if (!g_avrecord.active || !g_avrecord.started || bytes <= 0) {
+        return;
+    }
+    struct avrecord_job *job = new_job(AVRECORD_AUDIO, bytes);
+    // width / height carry the audio format for audio jobs
+    job->width = frequency;
+    job->height = channels;
+    memcpy(job->data, data, bytes);
+    queue_job(job);
+}
@@ -35,6 +35,7 @@
 
 #include "options.h"
 #include "uae/memory.h"
+#include "uae/vm.h"
 #include "custom.h"
 #include "newcpu.h"
 #include "autoconf.h"
@@ -652,6 +653,9 @@ uae_u32 bsdthr_Accept_2 (SB)
 uae_u32 bsdthr_Recv_2 (SB)
 {
 	int foo;
+	/* sb->buf usually points into Amiga memory, which may be write-watched
+	 * (RTG) and then read-only for the kernel */
+	uae_vm_write_watch_touch (sb->buf, sb->len);
 	if (sb->from == 0) {
 		foo = recv (sb->s, sb->buf, sb->len, sb->flags /*| MSG_NOSIGNAL*/);
 		DEBUG_LOG ("recv2, recv returns %d, errno is %d\n", foo, errno);
@@ -667,6 +671,7 @@ uae_u32 bsdthr_Recv_2 (SB)
 			put_long (sb->fromlen, l);
 		}
 	}
+	uae_vm_write_watch_untouch (sb->buf, sb->len);
 	return foo;
 }
 
@@ -5,6 +5,11 @@
 #include "FLAC/stream_decoder.h"
 #include "cda_play.h"
 
+#ifndef WITH_FLAC
+
+/* Without libFLAC (configure --with-flac), FLAC CD audio tracks cannot be
+ * played. */
+
 FLAC_API FLAC__StreamDecoder *FLAC__stream_decoder_new(void) {
     return NULL;
 }
@@ -36,9 +41,29 @@ FLAC_API FLAC__bool FLAC__stream_decoder_process_until_end_of_stream(FLAC__Strea
     return 0;
 }
 
+FLAC_API FLAC__bool FLAC__stream_decoder_process_single(FLAC__StreamDecoder *decoder) {
+    return 0;
+}
+
+FLAC_API FLAC__bool FLAC__stream_decoder_seek_absolute(
+        FLAC__StreamDecoder *decoder, FLAC__uint64 sample) {
+    return 0;
+}
+
+FLAC_API FLAC__bool FLAC__stream_decoder_flush(FLAC__StreamDecoder *decoder) {
+    return 0;
+}
+
+FLAC_API FLAC__StreamDecoderState FLAC__stream_decoder_get_state(
+        const FLAC__StreamDecoder *decoder) {
+    return FLAC__STREAM_DECODER_UNINITIALIZED;
+}
+
 FLAC_API void FLAC__stream_decoder_delete(FLAC__StreamDecoder *decoder) {
 }
 
+#endif
+
 mp3decoder::~mp3decoder() {
 }
 
@@ -9,6 +9,7 @@
 #include "fsdb.h"
 #include "uae/fs.h"
 #include "uae/glib.h"
+#include "uae/vm.h"
 #include "options.h"
 #include "filesys.h"
 #include "zfile.h"
@@ -34,7 +35,8 @@ struct my_openfile_s {
     char *path;
 };
 
-int my_errno = 0;
+/* per thread, a unit can have several packet threads */
+__thread int my_errno = 0;
 
 bool my_chmod (const TCHAR *name, uae_u32 mode) {
     STUB("");
@@ -45,7 +47,7 @@ bool my_chmod (const TCHAR *name, uae_u32 mode) {
 
 bool my_stat (const TCHAR *name, struct mystat *ms) {
     struct fs_stat sonuc;
-    if (fs_stat(name, &sonuc) == -1) {
+    if (fsdb_stat(name, &sonuc) == -1) {
         write_log("my_stat: stat on file %s failed\n", name);
         return false;
     }
@@ -128,7 +130,7 @@ struct my_opendir_s *my_opendir(const TCHAR *name, const TCHAR *mask) {
         }
         g_free(cresult);
 
-        mod->items = g_list_append(mod->items, g_strdup(result));
+        mod->items = g_list_prepend(mod->items, g_strdup(result));
     }
     mod->items = g_list_sort(mod->items, compare_strings);
     mod->current = mod->items;
@@ -263,6 +265,7 @@ struct my_openfile_s *my_open(const TCHAR *name, int flags) {
         return NULL;
     }
     if (!file_existed) {
+        fsdb_dir_cache_invalidate(path);
         fsdb_file_info info;
         fsdb_init_file_info(&info);
         int error = fsdb_set_file_info(path, &info);
@@ -304,7 +307,11 @@ void my_close(struct my_openfile_s* mos) {
 }
 
 unsigned int my_read(struct my_openfile_s *mos, void *b, unsigned int size) {
+    // The kernel cannot write to write-watched (RTG) memory, the read
+    // would fail with EFAULT. The pages stay writable until untouched.
+    uae_vm_write_watch_touch(b, size);
     ssize_t bytes_read = read(mos->fd, b, size);
+    uae_vm_write_watch_untouch(b, size);
     if (bytes_read == -1) {
         my_errno = errno;
         write_log("WARNING: my_read failed (-1)\n");
@@ -320,6 +327,31 @@ unsigned int my_read(struct my_openfile_s *mos, void *b, unsigned int size) {
     return (unsigned int) bytes_read;
 }
 
+unsigned int my_pread(struct my_openfile_s *mos, void *b, unsigned int size,
+        uae_s64 offset) {
+#ifdef WINDOWS
+    if (my_lseek(mos, offset, SEEK_SET) < 0) {
+        return 0;
+    }
+    return my_read(mos, b, size);
+#else
+    uae_vm_write_watch_touch(b, size);
+    ssize_t bytes_read = pread(mos->fd, b, size, offset);
+    uae_vm_write_watch_untouch(b, size);
+    if (bytes_read == -1) {
+        my_errno = errno;
+        write_log("WARNING: my_pread failed (-1)\n");
+        return 0;
+    }
+    my_errno = 0;
+    if (g_fsdb_debug) {
+        write_log("my_pread size=%d offset=%lld => %zd\n", size,
+                (long long) offset, bytes_read);
+    }
+    return (unsigned int) bytes_read;
+#endif
+}
+
 unsigned int my_write(struct my_openfile_s *mos, void *b, unsigned int size) {
     ssize_t bytes_written = write(mos->fd, b, size);
     if (bytes_written == -1) {
@@ -349,6 +381,7 @@ int my_mkdir(const TCHAR *path) {
         my_errno = errno;
         return -1;
     }
+    fsdb_dir_cache_invalidate(path);
     int file_existed = 0;
     if (!file_existed) {
         fsdb_file_info info;
@@ -405,6 +438,7 @@ int my_rmdir(const TCHAR *path) {
     char *meta_name = g_strconcat(path, ".uaem", NULL);
     g_unlink(meta_name);
     g_free(meta_name);
+    fsdb_dir_cache_invalidate(path);
 
     return result;
 }
@@ -420,6 +454,7 @@ int my_unlink(const TCHAR *path) {
     char *meta_name = g_strconcat(path, ".uaem", NULL);
     g_unlink(meta_name);
     g_free(meta_name);
+    fsdb_dir_cache_invalidate(path);
 
     return result;
 }
@@ -447,6 +482,8 @@ int my_rename(const TCHAR *oldname, const TCHAR *newname) {
     }
     errno = 0;
     int result = rename_file(oldname, newname);
+    fsdb_dir_cache_invalidate(oldname);
+    fsdb_dir_cache_invalidate(newname);
     if (result != 0) {
         // could not rename file
         return result;
@@ -185,6 +185,461 @@ static FILE *fsdb_open_meta_file(const char *meta_file, const char *mode)
     return f;
 }
 
+extern unsigned char g_latin1_lower_table[256];
+
+static void lower_latin1(char *s)
+{
+    unsigned char *u = (unsigned char*) s;
+    while (*u) {
+        *u = g_latin1_lower_table[*u];
+        u++;
+    }
+}
+
+/* Per-directory cache of host file names and .uaem metadata files, so
+ * looking up all files in a directory does not cost a directory scan and
+ * a failed open() per file. A directory is scanned in one pass the first
+ * time a file in it is looked up, and scanned again when its mtime changes
+ * (creating, deleting or renaming files or metadata files does that).
+ * Metadata file contents are read on first use and replaced when we write
+ * them. Changes made through the emulated file system also invalidate the
+ * cache explicitly, in case the host does not update directory mtimes.
+ * For directories watched for host changes, the watcher invalidates the
+ * cache and mtimes are not checked. */
+
+#define FSDB_DIR_CACHE_MAX 256
+
+typedef struct fsdb_dir_cache {
+    time_t mtime;
+    int mtime_nsec;
+    /* lower case ISO-8859-1 name -> host name, see find_nname_case */
+    GHashTable *names;
+    /* name of file with a .uaem file -> GBytes with the file contents,
+     * or NULL if not read yet */
+    GHashTable *meta;
+} fsdb_dir_cache;
+
+static GMutex g_fsdb_dir_cache_mutex;
+static GHashTable *g_fsdb_dir_cache = NULL;
+/* Directories with an inotify watch (see fsdb_watch.cpp) -> number of
+ * watches. Only these are trusted until invalidated, subdirectories which
+ * could not be watched (or are not, like symbolic links) are not. */
+static GHashTable *g_fsdb_watched_dirs = NULL;
+
+static void fsdb_dir_cache_free(gpointer data)
+{
+    fsdb_dir_cache *cache = (fsdb_dir_cache *) data;
+    g_hash_table_destroy(cache->names);
+    g_hash_table_destroy(cache->meta);
+    g_free(cache);
+}
+
+static void fsdb_meta_free(gpointer data)
+{
+    if (data) {
+        g_bytes_unref((GBytes *) data);
+    }
+}
+
+static fsdb_dir_cache *fsdb_dir_cache_scan(const char *dir_path,
+        struct fs_stat *st)
+{
+    GDir *dir = g_dir_open(dir_path, 0, NULL);
+    if (dir == NULL) {
+        return NULL;
+    }
+    GIConv cd = g_iconv_open("ISO-8859-1", "UTF-8");
+    if (cd == (GIConv) -1) {
+        g_dir_close(dir);
+        return NULL;
+    }
+    if (g_fsdb_debug) {
+        write_log("scanning dir %s\n", dir_path);
+    }
+    fsdb_dir_cache *cache = g_new(fsdb_dir_cache, 1);
+    cache->mtime = st->mtime;
+    cache->mtime_nsec = st->mtime_nsec;
+    cache->names = g_hash_table_new_full(
+            g_str_hash, g_str_equal, g_free, g_free);
+    cache->meta = g_hash_table_new_full(
+            g_str_hash, g_str_equal, g_free, fsdb_meta_free);
+
+    const char *result;
+    while ((result = g_dir_read_name(dir)) != NULL) {
+        int len = strlen(result);
+        if (len > 5 && strcmp(result + len - 5, ".uaem") == 0) {
+            g_hash_table_insert(cache->meta, g_strndup(result, len - 5),
+                    NULL);
+        }
+        char *cmp_result = g_convert_with_iconv(result, -1, cd, NULL, NULL,
+                NULL);
+        if (cmp_result == NULL) {
+            // not representable as ISO-8859-1, ignored by find_nname_case
+            continue;
+        }
+        lower_latin1(cmp_result);
+        // the first match wins, like a directory scan would do
+        if (g_hash_table_lookup(cache->names, cmp_result) == NULL) {
+            g_hash_table_insert(cache->names, cmp_result, g_strdup(result));
+        }
+        else {
+            g_free(cmp_result);
+        }
+    }
+    g_iconv_close(cd);
+    g_dir_close(dir);
+    return cache;
+}
+
+static bool fsdb_dir_cache_is_watched(const char *dir_path)
+{
+    return g_fsdb_watched_dirs != NULL &&
+            g_hash_table_lookup(g_fsdb_watched_dirs, dir_path) != NULL;
+}
+
+/* Returns the cache for dir_path, scanning the directory if it is not
+ * cached or has changed. Must be called with g_fsdb_dir_cache_mutex held. */
+static fsdb_dir_cache *fsdb_dir_cache_get(const char *dir_path)
+{
+    int len = strlen(dir_path);
+    if (len > 1 && dir_path[len - 1] == '/') {
+        /* the root directory may be configured with a trailing slash */
+        char *key = g_strndup(dir_path, len - 1);
+        fsdb_dir_cache *cache = fsdb_dir_cache_get(key);
+        g_free(key);
+        return cache;
+    }
+    if (g_fsdb_dir_cache == NULL) {
+        g_fsdb_dir_cache = g_hash_table_new_full(
+                g_str_hash, g_str_equal, g_free, fsdb_dir_cache_free);
+    }
+    fsdb_dir_cache *cache = (fsdb_dir_cache *) g_hash_table_lookup(
+            g_fsdb_dir_cache, dir_path);
+    if (cache && fsdb_dir_cache_is_watched(dir_path)) {
+        return cache;
+    }
+    struct fs_stat st;
+    if (fs_stat(dir_path, &st) != 0) {
+        g_hash_table_remove(g_fsdb_dir_cache, dir_path);
+        return NULL;
+    }
+    if (cache && cache->mtime == st.mtime &&
+            cache->mtime_nsec == st.mtime_nsec) {
+        return cache;
+    }
+    cache = fsdb_dir_cache_scan(dir_path, &st);
+    if (cache == NULL) {
+        g_hash_table_remove(g_fsdb_dir_cache, dir_path);
+        return NULL;
+    }
+    if (g_hash_table_size(g_fsdb_dir_cache) >= FSDB_DIR_CACHE_MAX) {
+        g_hash_table_remove_all(g_fsdb_dir_cache);
+    }
+    g_hash_table_replace(g_fsdb_dir_cache, g_strdup(dir_path), cache);
+    if (st.mtime_nsec == 0 && time(NULL) - st.mtime < 2) {
+        /* With whole-second mtimes, a change later in the same second
+         * would go unnoticed, so scan again until the directory has been
+         * left alone for a while. */
+        cache->mtime_nsec = -1;
+    }
+    return cache;
+}
+
+/* Looks up the contents of the .uaem file for nname. Returns 1 if the
+ * cache could answer, with *bytes set to the contents or NULL if there is
+ * no .uaem file, or 0 if the caller must read the file itself. */
+static int fsdb_dir_cache_get_meta(const char *nname, GBytes **bytes)
+{
+    char *dir_path = g_path_get_dirname(nname);
+    char *name = g_path_get_basename(nname);
+    int result = 0;
+    *bytes = NULL;
+
+    g_mutex_lock(&g_fsdb_dir_cache_mutex);
+    fsdb_dir_cache *cache = fsdb_dir_cache_get(dir_path);
+    gpointer value;
+    if (cache == NULL) {
+        // fall back to reading the file
+    }
+    else if (!g_hash_table_lookup_extended(cache->meta, name, NULL, &value)) {
+        result = 1;
+    }
+    else {
+        if (value == NULL) {
+            char *meta_file = g_strconcat(nname, ".uaem", NULL);
+            char *contents;
+            gsize length;
+            if (g_file_get_contents(meta_file, &contents, &length, NULL)) {
+                value = g_bytes_new_take(contents, length);
+                g_hash_table_insert(cache->meta, g_strdup(name), value);
+            }
+            g_free(meta_file);
+        }
+        if (value) {
+            *bytes = g_bytes_ref((GBytes *) value);
+            result = 1;
+        }
+    }
+    g_mutex_unlock(&g_fsdb_dir_cache_mutex);
+
+    g_free(name);
+    g_free(dir_path);
+    return result;
+}
+
+/* Replaces the cached .uaem contents for nname after we have written the
+ * file, or drops the directory from the cache if it changed otherwise. */
+static void fsdb_dir_cache_set_meta(const char *nname, const char *data,
+        int size)
+{
+    char *dir_path = g_path_get_dirname(nname);
+    g_mutex_lock(&g_fsdb_dir_cache_mutex);
+    fsdb_dir_cache *cache = NULL;
+    if (g_fsdb_dir_cache) {
+        cache = (fsdb_dir_cache *) g_hash_table_lookup(
+                g_fsdb_dir_cache, dir_path);
+    }
+    if (cache) {
+        struct fs_stat st;
+        if (fs_stat(dir_path, &st) == 0 && cache->mtime == st.mtime &&
+                cache->mtime_nsec == st.mtime_nsec) {
+            g_hash_table_replace(cache->meta, g_path_get_basename(nname),
+                    g_bytes_new(data, size));
+        }
+        else {
+            g_hash_table_remove(g_fsdb_dir_cache, dir_path);
+        }
+    }
+    g_mutex_unlock(&g_fsdb_dir_cache_mutex);
+    g_free(dir_path);
+}
+
+/* Returns 0 if the cache knows that dir_path has no file called name
+ * (compared case-insensitively), 1 otherwise. */
+int fsdb_dir_cache_has_file(const char *dir_path, const char *name)
+{
+    char *cmp_name = fs_utf8_to_latin1(name, -1);
+    if (cmp_name == NULL) {
+        return 1;
+    }
+    lower_latin1(cmp_name);
+    int result = 1;
+    g_mutex_lock(&g_fsdb_dir_cache_mutex);
+    fsdb_dir_cache *cache = fsdb_dir_cache_get(dir_path);
+    if (cache && g_hash_table_lookup(cache->names, cmp_name) == NULL) {
+        result = 0;
+    }
+    g_mutex_unlock(&g_fsdb_dir_cache_mutex);
+    g_free(cmp_name);
+    return result;
+}
+
+/* Forgets the cached state of dir_path. */
+void fsdb_dir_cache_invalidate_dir(const char *dir_path)
+{
+    char *key = g_strdup(dir_path);
+    int len = strlen(key);
+    while (len > 1 && key[len - 1] == '/') {
+        key[--len] = '\0';
+    }
+    g_mutex_lock(&g_fsdb_dir_cache_mutex);
+    if (g_fsdb_dir_cache) {
+        g_hash_table_remove(g_fsdb_dir_cache, key);
+    }
+    g_mutex_unlock(&g_fsdb_dir_cache_mutex);
+    g_free(key);
+}
+
+/* Forgets the cached state of the directory containing nname. */
+void fsdb_dir_cache_invalidate(const char *nname)
+{
+    char *dir_path = g_path_get_dirname(nname);
+    fsdb_dir_cache_invalidate_dir(dir_path);
+    g_free(dir_path);
+}
+
+/* Makes the cache read the .uaem file for nname again when it is next
+ * used, after it was changed on the host. */
+void fsdb_dir_cache_reload_meta(const char *nname)
+{
+    char *dir_path = g_path_get_dirname(nname);
+    char *name = g_path_get_basename(nname);
+    g_mutex_lock(&g_fsdb_dir_cache_mutex);
+    fsdb_dir_cache *cache = NULL;
+    if (g_fsdb_dir_cache) {
+        cache = (fsdb_dir_cache *) g_hash_table_lookup(
+                g_fsdb_dir_cache, dir_path);
+    }
+    if (cache == NULL) {
+        // not cached
+    }
+    else if (g_hash_table_lookup_extended(cache->meta, name, NULL, NULL)) {
+        g_hash_table_replace(cache->meta, name, NULL);
+        name = NULL;
+    }
+    else {
+        g_hash_table_remove(g_fsdb_dir_cache, dir_path);
+    }
+    g_mutex_unlock(&g_fsdb_dir_cache_mutex);
+    g_free(name);
+    g_free(dir_path);
+}
+
+/* Forgets all cached directories. */
+void fsdb_dir_cache_clear(void)
+{
+    g_mutex_lock(&g_fsdb_dir_cache_mutex);
+    if (g_fsdb_dir_cache) {
+        g_hash_table_remove_all(g_fsdb_dir_cache);
+    }
+    g_mutex_unlock(&g_fsdb_dir_cache_mutex);
+}
+
+/* Called by the host change watcher when it adds or removes the watch
+ * for dir_path. What was cached for the directory before may be stale. */
+void fsdb_dir_cache_set_watched(const char *dir_path, int watched)
+{
+    char *path = g_strdup(dir_path);
+    int len = strlen(path);
+    while (len > 1 && path[len - 1] == '/') {
+        path[--len] = '\0';
+    }
+    g_mutex_lock(&g_fsdb_dir_cache_mutex);
+    if (g_fsdb_watched_dirs == NULL) {
+        g_fsdb_watched_dirs = g_hash_table_new_full(
+                g_str_hash, g_str_equal, g_free, NULL);
+    }
+    int count = GPOINTER_TO_INT(
+            g_hash_table_lookup(g_fsdb_watched_dirs, path));
+    count += watched ? 1 : -1;
+    if (count > 0) {
+        g_hash_table_replace(g_fsdb_watched_dirs, g_strdup(path),
+                GINT_TO_POINTER(count));
+    } else {
+        g_hash_table_remove(g_fsdb_watched_dirs, path);
+    }
+    if (g_fsdb_dir_cache) {
+        g_hash_table_remove(g_fsdb_dir_cache, path);
+    }
+    g_mutex_unlock(&g_fsdb_dir_cache_mutex);
+    g_free(path);
+}
+
+/* Stat results for the entries of the directory being listed (ExAll), so
+ * every entry is only stat'ed once, although its a_inode is created and
+ * examined separately. Kept per packet thread and only for one packet,
+ * the files may change between packets. */
+typedef struct fsdb_stat_snapshot {
+    char *dir_path;
+    int dir_len;
+    /* name -> struct fs_stat */
+    GHashTable *stats;
+} fsdb_stat_snapshot;
+
+static void fsdb_stat_snapshot_free(gpointer data)
+{
+    fsdb_stat_snapshot *snapshot = (fsdb_stat_snapshot *) data;
+    g_hash_table_destroy(snapshot->stats);
+    g_free(snapshot->dir_path);
+    g_free(snapshot);
+}
+
+static GPrivate g_fsdb_stat_snapshot = G_PRIVATE_INIT(fsdb_stat_snapshot_free);
+
+void fsdb_stat_snapshot_begin(const char *dir_path)
+{
+    fsdb_stat_snapshot *current = (fsdb_stat_snapshot *)
+            g_private_get(&g_fsdb_stat_snapshot);
+    if (current && strcmp(current->dir_path, dir_path) == 0) {
+        /* already filled by fsdb_stat_snapshot_fill */
+        return;
+    }
+    fsdb_stat_snapshot *snapshot = g_new(fsdb_stat_snapshot, 1);
+    snapshot->dir_path = g_strdup(dir_path);
+    snapshot->dir_len = strlen(dir_path);
+    while (snapshot->dir_len > 1 &&
+            G_IS_DIR_SEPARATOR(dir_path[snapshot->dir_len - 1])) {
+        snapshot->dir_len--;
+    }
+    snapshot->stats = g_hash_table_new_full(
+            g_str_hash, g_str_equal, g_free, g_free);
+    g_private_replace(&g_fsdb_stat_snapshot, snapshot);
+}
+
+void fsdb_stat_snapshot_end(void)
+{
+    g_private_replace(&g_fsdb_stat_snapshot, NULL);
+}
+
+/* Stats all entries of the current snapshot's directory and loads its
+ * metadata cache. Only host calls and the snapshot are used, so packet
+ * threads call this without holding the unit. */
+void fsdb_stat_snapshot_fill(void)
+{
+    fsdb_stat_snapshot *snapshot = (fsdb_stat_snapshot *)
+            g_private_get(&g_fsdb_stat_snapshot);
+    if (snapshot == NULL) {
+        return;
+    }
+    GDir *dir = g_dir_open(snapshot->dir_path, 0, NULL);
+    if (dir == NULL) {
+        return;
+    }
+    const char *name;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        if (g_str_has_suffix(name, ".uaem") ||
+                g_hash_table_lookup(snapshot->stats, name)) {
+            continue;
+        }
+        char *path = g_build_filename(snapshot->dir_path, name, NULL);
+        struct fs_stat buf;
+        if (fs_stat(path, &buf) == 0) {
+            struct fs_stat *copy = g_new(struct fs_stat, 1);
+            *copy = buf;
+            g_hash_table_insert(snapshot->stats, g_strdup(name), copy);
+        }
+        g_free(path);
+    }
+    g_dir_close(dir);
+    g_mutex_lock(&g_fsdb_dir_cache_mutex);
+    fsdb_dir_cache_get(snapshot->dir_path);
+    g_mutex_unlock(&g_fsdb_dir_cache_mutex);
+}
+
+/* fs_stat, using the current stat snapshot for entries of its directory. */
+int fsdb_stat(const char *nname, struct fs_stat *buf)
+{
+    fsdb_stat_snapshot *snapshot = (fsdb_stat_snapshot *)
+            g_private_get(&g_fsdb_stat_snapshot);
+    if (snapshot == NULL ||
+            strncmp(nname, snapshot->dir_path, snapshot->dir_len) != 0 ||
+            !G_IS_DIR_SEPARATOR(nname[snapshot->dir_len])) {
+        return fs_stat(nname, buf);
+    }
+    const char *name = nname + snapshot->dir_len;
+    while (G_IS_DIR_SEPARATOR(*name)) {
+        name++;
+    }
+    for (const char *p = name; *p; p++) {
+        if (G_IS_DIR_SEPARATOR(*p)) {
+            return fs_stat(nname, buf);
+        }
+    }
+    struct fs_stat *cached = (struct fs_stat *) g_hash_table_lookup(
+            snapshot->stats, name);
+    if (cached) {
+        *buf = *cached;
+        return 0;
+    }
+    if (fs_stat(nname, buf) != 0) {
+        return -1;
+    }
+    struct fs_stat *copy = g_new(struct fs_stat, 1);
+    *copy = *buf;
+    g_hash_table_insert(snapshot->stats, g_strdup(name), copy);
+    return 0;
+}
+
 /* return supported combination */
 int fsdb_mode_supported(const a_inode *aino)
 {
@@ -397,7 +852,8 @@ static int fsdb_get_file_info(const char *nname, fsdb_file_info *info)
         write_log("fsdb_get_file_info %s\n", nname);
     }
     info->comment = NULL;
-    if (!fs_path_exists(nname)) {
+    struct fs_stat buf;
+    if (fsdb_stat(nname, &buf) != 0) {
         if (g_fsdb_debug) {
             write_log("- file does not exist: %s\n", nname);
         }
@@ -405,7 +861,7 @@ static int fsdb_get_file_info(const char *nname, fsdb_file_info *info)
         return ERROR_OBJECT_NOT_AROUND;
     }
 
-    info->type = fs_path_is_dir(nname) ? 2 : 1;
+    info->type = S_ISDIR(buf.mode) ? 2 : 1;
     info->mode = 0;
 
     int read_perm = 0;
@@ -413,9 +869,18 @@ static int fsdb_get_file_info(const char *nname, fsdb_file_info *info)
 
     char *meta_file = g_strconcat(nname, ".uaem", NULL);
 
-    FILE *f = fsdb_open_meta_file(meta_file, "rb");
+    GBytes *meta = NULL;
+    FILE *f = NULL;
     int file_size = 0;
-    if (f == NULL) {
+    if (fsdb_dir_cache_get_meta(nname, &meta)) {
+        if (meta) {
+            file_size = g_bytes_get_size(meta);
+        }
+        else if (g_fsdb_debug) {
+            write_log("fsdb_get_file_info - no .uaem file (cached)\n");
+        }
+    }
+    else if ((f = fsdb_open_meta_file(meta_file, "rb")) == NULL) {
         if (fs_path_exists(meta_file)) {
             error = host_errno_to_dos_errno(errno);
             write_log("WARNING: fsdb_get_file_info - could not open "
@@ -435,7 +900,11 @@ static int fsdb_get_file_info(const char *nname, fsdb_file_info *info)
     data[file_size] = '\0';
     char *p = data;
     char *end = data + file_size;
-    if (end - data > 0) {
+    if (meta) {
+        memcpy(data, g_bytes_get_data(meta, NULL), file_size);
+        g_bytes_unref(meta);
+    }
+    else if (end - data > 0) {
         /* file must be open, or (end - data) would be zero */
         int count = fread(data, 1, file_size, f);
         if (count != file_size) {
@@ -567,13 +1036,6 @@ static int fsdb_get_file_info(const char *nname, fsdb_file_info *info)
             info->ticks = 0;
         }
         else {
-            struct fs_stat buf;
-            if (fs_stat(nname, &buf) != 0) {
-                if (g_fsdb_debug) {
-                    write_log("- error stating %s (%d)\n", nname, errno);
-                }
-            }
-
             mytimeval mtv;
             mtv.tv_sec = buf.mtime + fs_get_local_time_offset(buf.mtime);
             mtv.tv_usec = buf.mtime_nsec / 1000;
@@ -751,6 +1213,10 @@ int fsdb_set_file_info(const char *nname, fsdb_file_info *info)
     free(meta_file);
 
     if (!error && f != NULL) {
+        /* the metadata is built in memory so it can be written with one
+         * call and kept in the directory cache */
+        GString *meta = g_string_new(NULL);
+
         char astr[] = "--------";
         if (info->mode & A_FIBF_HIDDEN) astr[0] = 'h';
         if (info->mode & A_FIBF_SCRIPT) astr[1] = 's';
@@ -761,13 +1227,8 @@ int fsdb_set_file_info(const char *nname, fsdb_file_info *info)
         if (info->mode & A_FIBF_EXECUTE) astr[6] = 'e';
         if (info->mode & A_FIBF_DELETE) astr[7] = 'd';
         write_log("- writing mode %s\n", astr);
+        g_string_append(meta, astr);
 
-        if (fwrite(astr, 8, 1, f) != 1) {
-            error = host_errno_to_dos_errno(errno);
-        }
-    }
-
-    if (!error && f != NULL) {
         struct mytimeval mtv;
         amiga_to_timeval(&mtv, info->days, info->mins, info->ticks, 50);
 
@@ -775,32 +1236,31 @@ int fsdb_set_file_info(const char *nname, fsdb_file_info *info)
         time_t secs = mtv.tv_sec;
         struct tm *gt = gmtime(&secs);
 
-        if (fprintf(f, " %04d-%02d-%02d %02d:%02d:%02d.%02d ",
+        g_string_append_printf(meta, " %04d-%02d-%02d %02d:%02d:%02d.%02d ",
                 1900 + gt->tm_year, 1 + gt->tm_mon, gt->tm_mday,
                 gt->tm_hour, gt->tm_min, gt->tm_sec,
-                mtv.tv_usec / 10000) < 0) {
+                mtv.tv_usec / 10000);
 
-        //if (fprintf(f, " %05d %04d %04d ", info->days, info->mins,
-        //        info->ticks) < 0) {
-            if (g_fsdb_debug) {
-                write_log("fsdb_set_file_time - fprintf failed\n");
-            }
-            error = host_errno_to_dos_errno(errno);
-        }
-    }
-
-    if (!error && f != NULL) {
         if (info->comment) {
             write_log("- writing comment %s\n", info->comment);
-            int len = strlen(info->comment);
-            if (len && fwrite(info->comment, len, 1, f) != 1) {
-                error = host_errno_to_dos_errno(errno);
-            }
+            g_string_append(meta, info->comment);
         }
-    }
+        g_string_append(meta, "\n");
 
-    if (!error && f != NULL) {
-        fprintf(f, "\n");
+        if (fwrite(meta->str, meta->len, 1, f) != 1) {
+            error = host_errno_to_dos_errno(errno);
+        }
+        if (fclose(f) != 0 && !error) {
+            error = host_errno_to_dos_errno(errno);
+        }
+        f = NULL;
+        if (!error) {
+            fsdb_dir_cache_set_meta(nname, meta->str, meta->len);
+        }
+        else {
+            fsdb_dir_cache_invalidate(nname);
+        }
+        g_string_free(meta, TRUE);
     }
     if (f != NULL) {
         fclose(f);
@@ -875,17 +1335,6 @@ bool my_utime(const char *name, struct mytimeval *tv)
     return my_errno == 0;
 }
 
-extern unsigned char g_latin1_lower_table[256];
-
-static void lower_latin1(char *s)
-{
-    unsigned char *u = (unsigned char*) s;
-    while (*u) {
-        *u = g_latin1_lower_table[*u];
-        u++;
-    }
-}
-
 int fsdb_fill_file_attrs(a_inode *base, a_inode *aino)
 {
     if (g_fsdb_debug) {
@@ -937,58 +1386,36 @@ int fsdb_set_file_attrs(a_inode *aino)
 
 static void find_nname_case(const char *dir_path, char **name)
 {
-    // FIXME: should cache these results...!!
     if (g_fsdb_debug) {
         write_log("find case for %s in dir %s\n", *name, dir_path);
     }
-    GDir *dir = g_dir_open(dir_path, 0, NULL);
-    if (dir == NULL) {
-        write_log("open dir %s failed\n", *name);
-        return;
-    }
-
     //gsize read, written;
     //gchar *cmp_name = g_convert(*name, -1, "ISO-8859-1", "UTF-8", &read,
     //        &written, NULL);
     char *cmp_name = fs_utf8_to_latin1(*name, -1);
     if (cmp_name == NULL) {
         write_log("WARNING: could not convert to latin1: %s", *name);
-        g_dir_close(dir);
         return;
     }
     lower_latin1(cmp_name);
 
-    const char *result;
-    while (1) {
-        result = g_dir_read_name(dir);
-        if (!result) {
-            break;
-        }
-
-        //char *cmp_result = g_convert(result, -1, "ISO-8859-1", "UTF-8", &read,
-        //        &written, NULL);
-        char *cmp_result = fs_utf8_to_latin1(result, -1);
-        //printf("%s %s\n", result, cmp_result);
-        if (cmp_result == NULL) {
-            // file name could not be represented as ISO-8859-1, so it
-            // will be ignored
-            write_log("cannot convert name \"%s\" to ISO-8859-1 - ignoring\n",
-                    result);
-            continue;
-        }
-        lower_latin1(cmp_result);
-
-        if (strcmp(cmp_name, cmp_result) == 0) {
+    g_mutex_lock(&g_fsdb_dir_cache_mutex);
+    fsdb_dir_cache *cache = fsdb_dir_cache_get(dir_path);
+    if (cache == NULL) {
+        write_log("open dir %s failed\n", *name);
+    }
+    else {
+        const char *result = (const char *) g_hash_table_lookup(
+                cache->names, cmp_name);
+        if (result) {
             // FIXME: memory leak, free name first?
             *name = g_strdup(result);
             if (g_fsdb_debug) {
                 write_log("              %s\n", *name);
             }
-            break;
         }
-        g_free(cmp_result);
     }
-    g_dir_close(dir);
+    g_mutex_unlock(&g_fsdb_dir_cache_mutex);
     g_free(cmp_name);
 }
 
@@ -13,8 +13,14 @@ typedef struct fsdb_file_info {
 
 void fsdb_init_file_info(fsdb_file_info *info);
 int fsdb_set_file_info(const char *nname, fsdb_file_info *info);
+void fsdb_dir_cache_invalidate(const char *nname);
+void fsdb_dir_cache_invalidate_dir(const char *dir_path);
+void fsdb_dir_cache_reload_meta(const char *nname);
+void fsdb_dir_cache_clear(void);
+void fsdb_dir_cache_set_watched(const char *dir_path, int watched);
+int fsdb_stat(const char *nname, struct fs_stat *buf);
 
 extern int g_fsdb_debug;
-extern int my_errno;
+extern __thread int my_errno;
 
 #endif // UAE_OD_FS_FSDB_HOST_H
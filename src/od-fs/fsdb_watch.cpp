@@ -0,0 +1,417 @@
+/*
+ * UAE - The Un*x Amiga Emulator
+ *
+ * Host change notification for directory volumes
+ *
+ * A watcher thread per mounted directory listens for inotify events for
+ * the whole directory tree. It keeps the fsdb directory cache coherent
+ * (so the cache does not have to stat directories to find changes) and
+ * queues the changed host paths for the filesystem handler, which updates
+ * the a_inode tree and sends AmigaDOS notifications from its own context.
+ * Changes the handler made itself are reported with fsdb_watch_ignore and
+ * are not queued again, the packet has already notified them.
+ */
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#include "uae/glib.h"
+#include "threaddep/thread.h"
+#include "fsdb.h"
+#include "fsdb_host.h"
+
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#define FSDB_WATCH_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | \
+        IN_MOVED_TO | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | \
+        IN_MOVE_SELF | IN_DONT_FOLLOW | IN_ONLYDIR)
+
+/* Events this close (in microseconds) to a change of the same path made by
+ * the handler are taken to be caused by it. A host change to the same
+ * path within this time is missed. */
+#define FSDB_WATCH_OWN_TIME (1000 * 1000)
+/* Own changes are remembered this long, events may be taken late */
+#define FSDB_WATCH_OWN_KEEP (10 * 1000 * 1000)
+
+struct fsdb_watch {
+    char *root;
+    int fd;
+    int stop_pipe[2];
+    uae_thread_id thread;
+    /* wd -> directory path, only used by the watcher thread */
+    GHashTable *dirs;
+    /* set to false if some directory could not be watched */
+    bool complete;
+
+    GMutex mutex;
+    /* changed path -> time of the last event, protected by mutex */
+    GHashTable *pending;
+    /* path -> time it was last changed by the handler, protected by mutex */
+    GHashTable *own;
+    bool overflow;
+    volatile int has_pending;
+};
+
+static void add_watch(fsdb_watch *watch, const char *path, bool recursive)
+{
+    int wd = inotify_add_watch(watch->fd, path, FSDB_WATCH_MASK);
+    if (wd < 0) {
+        if (watch->complete) {
+            write_log("FSDB: could not watch %s (%s), the directory "
+                    "cache falls back to checking modification times "
+                    "for such directories\n", path, strerror(errno));
+        }
+        watch->complete = false;
+        return;
+    }
+    /* the same directory (inode) gives the same wd */
+    const char *old = (const char *) g_hash_table_lookup(
+            watch->dirs, GINT_TO_POINTER(wd));
+    if (old == NULL || strcmp(old, path) != 0) {
+        if (old) {
+            fsdb_dir_cache_set_watched(old, 0);
+        }
+        /* from now on, the directory cache for path is invalidated by
+         * events and does not need to check its modification time */
+        fsdb_dir_cache_set_watched(path, 1);
+        g_hash_table_replace(watch->dirs, GINT_TO_POINTER(wd),
+                g_strdup(path));
+    }
+    if (!recursive) {
+        return;
+    }
+    GDir *dir = g_dir_open(path, 0, NULL);
+    if (dir == NULL) {
+        return;
+    }
+    const char *name;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        char *child = g_strconcat(path, "/", name, NULL);
+        struct stat st;
+        /* symbolic links to directories are not followed, so they cannot
+         * make the watcher loop */
+        if (lstat(child, &st) == 0 && S_ISDIR(st.st_mode)) {
+            add_watch(watch, child, true);
+        }
+        g_free(child);
+    }
+    g_dir_close(dir);
+}
+
+/* Stops watching path and everything below it (after it was moved away,
+ * the watches would report the old paths). */
+static void remove_watches(fsdb_watch *watch, const char *path)
+{
+    int len = strlen(path);
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, watch->dirs);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        const char *dir = (const char *) value;
+        if (strncmp(dir, path, len) == 0 &&
+                (dir[len] == '\0' || dir[len] == '/')) {
+            inotify_rm_watch(watch->fd, GPOINTER_TO_INT(key));
+            fsdb_dir_cache_set_watched(dir, 0);
+            g_hash_table_iter_remove(&iter);
+        }
+    }
+}
+
+static gint64 *new_time(gint64 t)
+{
+    gint64 *p = g_new(gint64, 1);
+    *p = t;
+    return p;
+}
+
+static void queue_change(fsdb_watch *watch, char *path, bool overflow)
+{
+    g_mutex_lock(&watch->mutex);
+    if (overflow) {
+        watch->overflow = true;
+    } else {
+        g_hash_table_replace(watch->pending, path,
+                new_time(g_get_monotonic_time()));
+    }
+    watch->has_pending = 1;
+    g_mutex_unlock(&watch->mutex);
+}
+
+static void handle_event(fsdb_watch *watch, struct inotify_event *ev)
+{
+    if (ev->mask & IN_Q_OVERFLOW) {
+        write_log("FSDB: event queue overflow for %s\n", watch->root);
+        fsdb_dir_cache_clear();
+        queue_change(watch, NULL, true);
+        return;
+    }
+    const char *dir = (const char *) g_hash_table_lookup(
+            watch->dirs, GINT_TO_POINTER(ev->wd));
+    if (dir == NULL) {
+        return;
+    }
+    if (ev->mask & IN_IGNORED) {
+        fsdb_dir_cache_set_watched(dir, 0);
+        g_hash_table_remove(watch->dirs, GINT_TO_POINTER(ev->wd));
+        return;
+    }
+    char *path;
+    if (ev->len == 0 || ev->name[0] == '\0') {
+        path = g_strdup(dir);
+    } else {
+        path = g_strconcat(dir, "/", ev->name, NULL);
+    }
+    if (g_fsdb_debug) {
+        write_log("FSDB: host change %08x %s\n", ev->mask, path);
+    }
+
+    if (ev->mask & IN_ISDIR) {
+        if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+            remove_watches(watch, path);
+            /* cached subdirectories are keyed by path */
+            fsdb_dir_cache_clear();
+        }
+        if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+            add_watch(watch, path, true);
+            /* files may have been created before the watch was added */
+            fsdb_dir_cache_invalidate_dir(path);
+        }
+    }
+    if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+        fsdb_dir_cache_clear();
+    }
+
+    /* A changed metadata file means the attributes of the file it
+     * belongs to have changed, _UAEFSDB.___ files are about the whole
+     * directory. */
+    int len = strlen(path);
+    bool meta = len > 5 && strcmp(path + len - 5, ".uaem") == 0;
+    if (meta) {
+        path[len - 5] = '\0';
+    }
+    if (ev->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)) {
+        fsdb_dir_cache_invalidate(path);
+    } else if (meta) {
+        fsdb_dir_cache_reload_meta(path);
+    }
+    if (ev->len > 0 && strcmp(ev->name, FSDB_FILE) == 0) {
+        g_free(path);
+        path = g_strdup(dir);
+    }
+    queue_change(watch, path, false);
+}
+
+static void *watch_thread(void *data)
+{
+    fsdb_watch *watch = (fsdb_watch *) data;
+
+    add_watch(watch, watch->root, true);
+    write_log("FSDB: watching %s (%d directories)\n", watch->root,
+            g_hash_table_size(watch->dirs));
+
+    char buffer[16384]
+            __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    struct pollfd fds[2];
+    fds[0].fd = watch->fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = watch->stop_pipe[0];
+    fds[1].events = POLLIN;
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents) {
+            break;
+        }
+        ssize_t len = read(watch->fd, buffer, sizeof(buffer));
+        if (len <= 0) {
+            if (len < 0 && (errno == EINTR || errno == EAGAIN)) {
+                continue;
+            }
+            break;
+        }
+        for (char *p = buffer; p < buffer + len; ) {
+            struct inotify_event *ev = (struct inotify_event *) p;
+            handle_event(watch, ev);
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, watch->dirs);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        fsdb_dir_cache_set_watched((const char *) value, 0);
+    }
+    return NULL;
+}
+
+struct fsdb_watch *fsdb_watch_start(const char *rootdir)
+{
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        write_log("FSDB: inotify_init1 failed (%s)\n", strerror(errno));
+        return NULL;
+    }
+    fsdb_watch *watch = g_new0(fsdb_watch, 1);
+    if (pipe(watch->stop_pipe) != 0) {
+        close(fd);
+        g_free(watch);
+        return NULL;
+    }
+    watch->root = g_strdup(rootdir);
+    /* child paths are built as root/name, like fsdb paths */
+    int len = strlen(watch->root);
+    while (len > 1 && watch->root[len - 1] == '/') {
+        watch->root[--len] = '\0';
+    }
+    watch->fd = fd;
+    watch->complete = true;
+    watch->dirs = g_hash_table_new_full(
+            g_direct_hash, g_direct_equal, NULL, g_free);
+    watch->pending = g_hash_table_new_full(
+            g_str_hash, g_str_equal, g_free, g_free);
+    watch->own = g_hash_table_new_full(
+            g_str_hash, g_str_equal, g_free, g_free);
+    g_mutex_init(&watch->mutex);
+    if (!uae_start_thread("fsdb_watch", watch_thread, watch,
+            &watch->thread)) {
+        fsdb_watch_stop(watch);
+        return NULL;
+    }
+    return watch;
+}
+
+void fsdb_watch_stop(fsdb_watch *watch)
+{
+    if (watch == NULL) {
+        return;
+    }
+    if (watch->thread) {
+        if (write(watch->stop_pipe[1], "", 1) != 1) {
+            write_log("FSDB: could not stop watcher thread\n");
+        }
+        uae_wait_thread(watch->thread);
+        uae_end_thread(&watch->thread);
+    }
+    close(watch->stop_pipe[0]);
+    close(watch->stop_pipe[1]);
+    close(watch->fd);
+    g_hash_table_destroy(watch->dirs);
+    g_hash_table_destroy(watch->pending);
+    g_hash_table_destroy(watch->own);
+    g_mutex_clear(&watch->mutex);
+    g_free(watch->root);
+    g_free(watch);
+}
+
+int fsdb_watch_pending(fsdb_watch *watch)
+{
+    return watch->has_pending;
+}
+
+static void expire_own(fsdb_watch *watch, gint64 now)
+{
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, watch->own);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        if (now - *(gint64 *) value > FSDB_WATCH_OWN_KEEP) {
+            g_hash_table_iter_remove(&iter);
+        }
+    }
+}
+
+void fsdb_watch_ignore(fsdb_watch *watch, const char *path)
+{
+    if (watch == NULL) {
+        return;
+    }
+    gint64 now = g_get_monotonic_time();
+    /* event paths are built without trailing slashes */
+    char *key = g_strdup(path);
+    int len = strlen(key);
+    while (len > 1 && key[len - 1] == '/') {
+        key[--len] = '\0';
+    }
+    g_mutex_lock(&watch->mutex);
+    if (g_hash_table_size(watch->own) >= 1024) {
+        expire_own(watch, now);
+    }
+    g_hash_table_replace(watch->own, key, new_time(now));
+    g_mutex_unlock(&watch->mutex);
+}
+
+char **fsdb_watch_take(fsdb_watch *watch, int *overflow)
+{
+    g_mutex_lock(&watch->mutex);
+    *overflow = watch->overflow;
+    watch->overflow = false;
+    char **paths = g_new(char *, g_hash_table_size(watch->pending) + 1);
+    int count = 0;
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, watch->pending);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        /* the event may arrive before or after the handler reports its
+         * own change */
+        gint64 *own = (gint64 *) g_hash_table_lookup(watch->own, key);
+        if (own && ABS(*(gint64 *) value - *own) < FSDB_WATCH_OWN_TIME) {
+            g_hash_table_iter_remove(&iter);
+            continue;
+        }
+        paths[count++] = (char *) key;
+        g_free(value);
+        g_hash_table_iter_steal(&iter);
+    }
+    paths[count] = NULL;
+    expire_own(watch, g_get_monotonic_time());
+    watch->has_pending = 0;
+    g_mutex_unlock(&watch->mutex);
+    return paths;
+}
+
+void fsdb_watch_free_paths(char **paths)
+{
+    g_strfreev(paths);
+}
+
+#else
+
+struct fsdb_watch *fsdb_watch_start(const char *rootdir)
+{
+    return NULL;
+}
+
+void fsdb_watch_stop(fsdb_watch *watch)
+{
+}
+
+int fsdb_watch_pending(fsdb_watch *watch)
+{
+    return 0;
+}
+
+void fsdb_watch_ignore(fsdb_watch *watch, const char *path)
+{
+}
+
+char **fsdb_watch_take(fsdb_watch *watch, int *overflow)
+{
+    *overflow = 0;
+    return NULL;
+}
+
+void fsdb_watch_free_paths(char **paths)
+{
+}
+
+#endif
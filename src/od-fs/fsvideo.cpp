@@ -10,6 +10,7 @@
 #include "options.h"
 #include "uae.h"
 #include "uae/fs.h"
+#include "uae/shmexport.h"
 #include "win32gfx.h"
 #include "xwin.h"
 
@@ -573,6 +574,26 @@ uint8_t *uae_get_render_buffer()
 	return g_renderdata.pixels;
 }
 
+void uae_fsvideo_rtg_lines_updated(int monid, int y, int h)
+{
+	if (fsemu || monid != 0) {
+		// The fsemu RTG frame buffer is persistent, no line info needed
+		return;
+	}
+	// Lines not marked here are copied from the previous frame when the
+	// frame is rendered (the render buffer is replaced every frame).
+	if (y < 0) {
+		h += y;
+		y = 0;
+	}
+	if (y + h > AMIGA_MAX_LINES) {
+		h = AMIGA_MAX_LINES - y;
+	}
+	if (h > 0) {
+		memset(g_renderdata.line + y, 0, h);
+	}
+}
+
 #define RGBA_MASK_R 0x000000ff
 #define RGBA_MASK_G 0x0000ff00
 #define RGBA_MASK_B 0x00ff0000
@@ -912,6 +933,9 @@ uae_u8 *gfx_lock_picasso(int monid, bool fullupdate, bool doclear)
 				memset (p2, 0, vidinfo->width * vidinfo->pixbytes);
 				p2 += vidinfo->rowbytes;
 			}
+#ifdef FSUAE
+			uae_fsvideo_rtg_lines_updated(monid, 0, vidinfo->height);
+#endif
 		}
 	}
 #ifdef FSUAE
@@ -1735,6 +1759,7 @@ int graphics_setup(void)
 
 void graphics_leave (void)
 {
+	uae_avrecord_stop();
 	for (int i = 0; i < MAX_AMIGAMONITORS; i++) {
 		close_windows(&AMonitors[i]);
 	}
@@ -2173,8 +2198,9 @@ bool uae_fsvideo_renderframe(int monid, int mode, bool immediate)
 		cw = uae_fsvideo.picasso_width;
 		ch = uae_fsvideo.picasso_height;
 
-		// FIXME
-		memset(g_renderdata.line, 0, AMIGA_MAX_LINES);
+		// Lines updated by the RTG code are marked with
+		// uae_fsvideo_rtg_lines_updated, the rest are kept from the
+		// previous frame.
 	}
 	else {
 		if (avidinfo->outbuffer) {
@@ -2305,6 +2331,21 @@ bool uae_fsvideo_renderframe(int monid, int mode, bool immediate)
 		frame->buffer = frame_copy;
 #endif
 
+		if (mode != 2) {
+			uae_shm_export_video((const uint8_t *) frame->buffer,
+					frame->width, frame->height, frame->stride,
+					uae_fsvideo.bytes_per_pixel, frame->limits.x,
+					frame->limits.y, frame->limits.w, frame->limits.h,
+					mon->screen_is_picasso ? UAE_SHM_EXPORT_FLAG_RTG : 0);
+			if (frame->limits.w > 0 && frame->limits.h > 0) {
+				uae_avrecord_video((const uint8_t *) frame->buffer
+						+ frame->limits.y * frame->stride
+						+ frame->limits.x * uae_fsvideo.bytes_per_pixel,
+						frame->limits.w, frame->limits.h, frame->stride,
+						uae_fsvideo.bytes_per_pixel);
+			}
+		}
+
 		// fsemu_video_post_partial_frame(avidinfo->);
 		fsemu_video_post_frame(frame);
 		// notice_screen_contents_lost(monid);
@@ -2312,7 +2353,11 @@ bool uae_fsvideo_renderframe(int monid, int mode, bool immediate)
 	} else {  // !fsemu
 		// FIXME: Need to do this right now to fix rendering, this
 		// causes some slowdown, most likely
-		memset(g_renderdata.line, 0, AMIGA_MAX_LINES);
+		/* In RTG mode, unchanged rows are copied from the previous frame
+		 * by the render callback (the fse driver path does not do that) */
+		if (!mon->screen_is_picasso || fse_drivers()) {
+			memset(g_renderdata.line, 0, AMIGA_MAX_LINES);
+		}
 
 		if (g_libamiga_callbacks.render) {
 #if 0
@@ -2321,6 +2366,21 @@ bool uae_fsvideo_renderframe(int monid, int mode, bool immediate)
 #endif
 			g_libamiga_callbacks.render(&g_renderdata);
 		}
+
+		/* Exported after the render callback, which completes the buffer */
+		uae_shm_export_video(g_renderdata.pixels, g_renderdata.width,
+				g_renderdata.height, g_renderdata.width * g_renderdata.bpp,
+				g_renderdata.bpp, g_renderdata.limit_x, g_renderdata.limit_y,
+				g_renderdata.limit_w, g_renderdata.limit_h,
+				mon->screen_is_picasso ? UAE_SHM_EXPORT_FLAG_RTG : 0);
+		if (g_renderdata.limit_w > 0 && g_renderdata.limit_h > 0) {
+			int stride = g_renderdata.width * g_renderdata.bpp;
+			uae_avrecord_video(g_renderdata.pixels
+					+ g_renderdata.limit_y * stride
+					+ g_renderdata.limit_x * g_renderdata.bpp,
+					g_renderdata.limit_w, g_renderdata.limit_h, stride,
+					g_renderdata.bpp);
+		}
 #if 0
 		g_has_flushed_line = 0;
 		g_has_flushed_block = 0;
@@ -17,9 +17,10 @@
 #include "uae/fs.h"
 #include "uae/io.h"
 #include "uae/log.h"
+#include <fs/filesys.h>
+#include <sys/stat.h>
 
 #ifdef MACOSX
-#include <sys/stat.h>
 #include <sys/disk.h>
 #endif
 
@@ -41,11 +42,14 @@ static int g_debug = 0;
 #define DEBUG_LOG(...) do ; while(0)
 #endif
 
+struct hdf_overlay;
+
 struct hardfilehandle
 {
     int zfile;
     struct zfile *zf;
     FILE *h;
+    struct hdf_overlay *overlay;
 };
 
 struct uae_driveinfo {
@@ -207,6 +211,429 @@ static int isharddrive (const TCHAR *name)
 
 static const char *hdz[] = { "hdz", "zip", "rar", "7z", NULL };
 
+/* Copy-on-write overlays. The base image is opened read-only and written
+ * blocks go to a delta file instead: a header block, a bitmap with one bit
+ * per block of the image (set when the block has been written), and the
+ * written blocks at data_offset + their offset in the image. Blocks that
+ * were never written are holes, so a new delta takes no space and
+ * emptying it resets the drive to the base image. */
+
+#define HDF_OVERLAY_MAGIC "UAEHDOVL"
+#define HDF_OVERLAY_VERSION 2
+#define HDF_OVERLAY_HEADER_SIZE 512
+#define HDF_OVERLAY_ALIGN 4096
+
+struct hdf_overlay {
+    FILE *h;
+    int blocksize;
+    uae_u64 blocks;
+    uae_u64 data_offset;
+    uae_u8 *bitmap;
+};
+
+struct hdf_overlay_header {
+    int version;
+    int blocksize;
+    uae_u64 size;
+    uae_u64 mtime;
+    int mtime_nsec;
+    uae_u64 base_size;
+};
+
+/* What the delta remembers of the base file to notice that it changed:
+ * its size and its modification time with sub-second precision (an image
+ * rewritten within the same second would otherwise pass). */
+struct hdf_overlay_stamp {
+    uae_u64 mtime;
+    int mtime_nsec;
+    uae_u64 size;
+};
+
+static struct {
+    char *path;
+    char *overlay_path;
+} hdf_overlays[MAX_FILESYSTEM_UNITS];
+
+static void overlay_put (uae_u8 *p, uae_u64 v, int bytes)
+{
+    for (int i = bytes - 1; i >= 0; i--) {
+        p[i] = (uae_u8) v;
+        v >>= 8;
+    }
+}
+
+static uae_u64 overlay_get (const uae_u8 *p, int bytes)
+{
+    uae_u64 v = 0;
+    for (int i = 0; i < bytes; i++)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+static uae_u64 overlay_data_offset (uae_u64 blocks)
+{
+    uae_u64 end = HDF_OVERLAY_HEADER_SIZE + (blocks + 7) / 8;
+    return (end + HDF_OVERLAY_ALIGN - 1) & ~((uae_u64) HDF_OVERLAY_ALIGN - 1);
+}
+
+static bool overlay_base_stamp (const char *name,
+        struct hdf_overlay_stamp *stamp)
+{
+    struct fs_stat st;
+    if (fs_stat (name, &st) != 0)
+        return false;
+    stamp->mtime = st.mtime;
+    stamp->mtime_nsec = st.mtime_nsec;
+    stamp->size = st.size;
+    return true;
+}
+
+/* Returns 1 if the header was read, 0 if the delta is empty (new or
+ * discarded) and -1 if it is not a valid delta. */
+static int overlay_read_header (FILE *h, struct hdf_overlay_header *hdr)
+{
+    uae_u8 buf[HDF_OVERLAY_HEADER_SIZE];
+    if (uae_fseeko64 (h, 0, SEEK_SET) != 0)
+        return -1;
+    size_t got = fread (buf, 1, sizeof buf, h);
+    if (got == 0)
+        return 0;
+    if (got != sizeof buf || memcmp (buf, HDF_OVERLAY_MAGIC, 8) != 0)
+        return -1;
+    /* version 1 deltas only stored the mtime in seconds, they are read
+     * so that overlay_matches can reject them as stale */
+    hdr->version = overlay_get (buf + 8, 4);
+    if (hdr->version < 1 || hdr->version > HDF_OVERLAY_VERSION)
+        return -1;
+    hdr->blocksize = overlay_get (buf + 12, 4);
+    hdr->size = overlay_get (buf + 16, 8);
+    hdr->mtime = overlay_get (buf + 24, 8);
+    hdr->mtime_nsec = overlay_get (buf + 32, 4);
+    hdr->base_size = overlay_get (buf + 36, 8);
+    if (hdr->blocksize <= 0 || (hdr->blocksize & (hdr->blocksize - 1)))
+        return -1;
+    return 1;
+}
+
+static bool overlay_matches (const struct hdf_overlay_header *hdr,
+        const char *name, uae_u64 size, int blocksize)
+{
+    struct hdf_overlay_stamp stamp;
+    if (hdr->version != HDF_OVERLAY_VERSION ||
+            !overlay_base_stamp (name, &stamp))
+        return false;
+    return hdr->size == size && hdr->mtime == stamp.mtime &&
+            hdr->mtime_nsec == stamp.mtime_nsec &&
+            hdr->base_size == stamp.size &&
+            (blocksize == 0 || hdr->blocksize == blocksize);
+}
+
+static int overlay_isset (struct hdf_overlay *ov, uae_u64 block)
+{
+    return ov->bitmap[block >> 3] & (1 << (block & 7));
+}
+
+static void overlay_close (struct hdf_overlay *ov)
+{
+    if (!ov)
+        return;
+    if (ov->h)
+        fclose (ov->h);
+    xfree (ov->bitmap);
+    xfree (ov);
+}
+
+static struct hdf_overlay *overlay_open (struct hardfiledata *hfd,
+        const char *name, const char *path)
+{
+    struct hdf_overlay *ov = xcalloc (struct hdf_overlay, 1);
+    struct hdf_overlay_header hdr;
+    uae_u64 bitmapsize;
+    int ret;
+
+    ov->blocksize = hfd->ci.blocksize;
+    ov->blocks = hfd->physsize / ov->blocksize;
+    ov->data_offset = overlay_data_offset (ov->blocks);
+    bitmapsize = (ov->blocks + 7) / 8;
+    ov->bitmap = xcalloc (uae_u8, bitmapsize + 1);
+    ov->h = uae_tfopen (path, "r+b");
+    if (ov->h == INVALID_HANDLE_VALUE)
+        ov->h = uae_tfopen (path, "w+b");
+    if (ov->h == INVALID_HANDLE_VALUE) {
+        write_log ("HDF overlay '%s' could not be opened, error %d\n",
+                path, errno);
+        goto end;
+    }
+    ret = overlay_read_header (ov->h, &hdr);
+    if (ret < 0) {
+        write_log ("HDF overlay '%s' is not an overlay file\n", path);
+        goto end;
+    }
+    if (ret > 0) {
+        if (!overlay_matches (&hdr, name, hfd->physsize, ov->blocksize)) {
+            gui_message (_T("Overlay \"%s\" was not created for the current "
+                    "version of \"%s\". Discard it to start over."),
+                    path, name);
+            goto end;
+        }
+        if (uae_fseeko64 (ov->h, HDF_OVERLAY_HEADER_SIZE, SEEK_SET) != 0 ||
+                fread (ov->bitmap, 1, bitmapsize, ov->h) != bitmapsize) {
+            /* bitmap bytes past the end of the file are all zero */
+            if (ferror (ov->h)) {
+                write_log ("HDF overlay '%s' read error %d\n", path, errno);
+                goto end;
+            }
+        }
+    } else {
+        uae_u8 buf[HDF_OVERLAY_HEADER_SIZE];
+        struct hdf_overlay_stamp stamp;
+        if (!overlay_base_stamp (name, &stamp))
+            goto end;
+        memset (buf, 0, sizeof buf);
+        memcpy (buf, HDF_OVERLAY_MAGIC, 8);
+        overlay_put (buf + 8, HDF_OVERLAY_VERSION, 4);
+        overlay_put (buf + 12, ov->blocksize, 4);
+        overlay_put (buf + 16, hfd->physsize, 8);
+        overlay_put (buf + 24, stamp.mtime, 8);
+        overlay_put (buf + 32, stamp.mtime_nsec, 4);
+        overlay_put (buf + 36, stamp.size, 8);
+        if (uae_fseeko64 (ov->h, 0, SEEK_SET) != 0 ||
+                fwrite (buf, 1, sizeof buf, ov->h) != sizeof buf ||
+                fflush (ov->h) != 0) {
+            write_log ("HDF overlay '%s' write error %d\n", path, errno);
+            goto end;
+        }
+    }
+    write_log ("HDF '%s' uses overlay '%s'%s\n", name, path,
+            ret ? "" : " (new)");
+    return ov;
+end:
+    overlay_close (ov);
+    return NULL;
+}
+
+/* Replaces the blocks of buffer (at offset in the image) which have been
+ * written to the overlay. */
+static bool overlay_patch (struct hardfiledata *hfd, uae_u8 *buffer,
+        uae_u64 offset, int len)
+{
+    struct hdf_overlay *ov = hfd->handle->overlay;
+    uae_u64 block, last;
+
+    if (len <= 0)
+        return true;
+    block = offset / ov->blocksize;
+    last = (offset + len - 1) / ov->blocksize;
+    if (last >= ov->blocks)
+        last = ov->blocks - 1;
+    while (block <= last) {
+        if (!overlay_isset (ov, block)) {
+            block++;
+            continue;
+        }
+        uae_u64 end = block + 1;
+        while (end <= last && overlay_isset (ov, end))
+            end++;
+        uae_u64 start = block * ov->blocksize;
+        uae_u64 stop = end * ov->blocksize;
+        if (start < offset)
+            start = offset;
+        if (stop > offset + len)
+            stop = offset + len;
+        if (uae_fseeko64 (ov->h, ov->data_offset + start, SEEK_SET) != 0 ||
+                fread (buffer + (start - offset), 1, stop - start, ov->h)
+                        != stop - start) {
+            write_log ("hdf overlay: read failed at 0x%llx\n", start);
+            return false;
+        }
+        block = end;
+    }
+    return true;
+}
+
+static int overlay_write (struct hardfiledata *hfd, uae_u8 *buffer,
+        uae_u64 offset, int len)
+{
+    struct hdf_overlay *ov = hfd->handle->overlay;
+    uae_u8 *data = buffer;
+    int size = len;
+
+    if (offset % ov->blocksize ||
+            offset + len > ov->blocks * ov->blocksize) {
+        write_log ("hdf overlay: write out of bounds (0x%llx, %d)\n",
+                offset, len);
+        return 0;
+    }
+    if (len % ov->blocksize) {
+        /* the unwritten part of the last block keeps its current data */
+        uae_u64 tail = offset + len - len % ov->blocksize;
+        size = len - len % ov->blocksize + ov->blocksize;
+        data = xmalloc (uae_u8, size);
+        if (uae_fseeko64 (hfd->handle->h, hfd->offset + tail, SEEK_SET) != 0 ||
+                fread (data + (tail - offset), 1, ov->blocksize,
+                        hfd->handle->h) != (size_t) ov->blocksize ||
+                !overlay_patch (hfd, data + (tail - offset), tail,
+                        ov->blocksize)) {
+            xfree (data);
+            return 0;
+        }
+        memcpy (data, buffer, len);
+    }
+    uae_u64 first = offset / ov->blocksize;
+    uae_u64 last = (offset + size - 1) / ov->blocksize;
+    int outlen = 0;
+    if (uae_fseeko64 (ov->h, ov->data_offset + offset, SEEK_SET) == 0)
+        outlen = fwrite (data, 1, size, ov->h);
+    if (data != buffer)
+        xfree (data);
+    /* the data must reach the file before the bitmap bits that mark it
+     * valid, stdio would otherwise write its buffers in any order */
+    if (outlen == size && fflush (ov->h) != 0)
+        outlen = 0;
+    if (outlen != size) {
+        write_log ("hdf overlay: write failed at 0x%llx, error %d\n",
+                offset, errno);
+        return 0;
+    }
+    /* the bitmap is updated after the data, an interrupted write leaves
+     * the blocks unchanged */
+    for (uae_u64 block = first; block <= last; block++)
+        ov->bitmap[block >> 3] |= 1 << (block & 7);
+    size = (int) (last / 8 - first / 8 + 1);
+    if (uae_fseeko64 (ov->h, HDF_OVERLAY_HEADER_SIZE + first / 8,
+            SEEK_SET) != 0 ||
+            fwrite (ov->bitmap + first / 8, 1, size, ov->h) != (size_t) size ||
+            fflush (ov->h) != 0) {
+        write_log ("hdf overlay: bitmap write failed, error %d\n", errno);
+        return 0;
+    }
+    return len;
+}
+
+static const char *overlay_path (const char *name)
+{
+    for (int i = 0; i < MAX_FILESYSTEM_UNITS; i++) {
+        if (hdf_overlays[i].path && !_tcscmp (hdf_overlays[i].path, name))
+            return hdf_overlays[i].overlay_path;
+    }
+    return NULL;
+}
+
+int hdf_overlay_set (const char *path, const char *overlay_path)
+{
+    int free_slot = -1;
+    for (int i = 0; i < MAX_FILESYSTEM_UNITS; i++) {
+        if (hdf_overlays[i].path == NULL) {
+            if (free_slot < 0)
+                free_slot = i;
+        } else if (!_tcscmp (hdf_overlays[i].path, path)) {
+            free_slot = i;
+            break;
+        }
+    }
+    if (free_slot < 0)
+        return 0;
+    xfree (hdf_overlays[free_slot].path);
+    xfree (hdf_overlays[free_slot].overlay_path);
+    hdf_overlays[free_slot].path = NULL;
+    hdf_overlays[free_slot].overlay_path = NULL;
+    if (overlay_path && overlay_path[0]) {
+        hdf_overlays[free_slot].path = my_strdup (path);
+        hdf_overlays[free_slot].overlay_path = my_strdup (overlay_path);
+    }
+    return 1;
+}
+
+int hdf_overlay_discard (const char *overlay_path)
+{
+    /* truncating is enough, an empty delta is initialized when opened */
+    FILE *h = uae_tfopen (overlay_path, "wb");
+    if (h == INVALID_HANDLE_VALUE) {
+        write_log ("HDF overlay '%s' could not be discarded, error %d\n",
+                overlay_path, errno);
+        return 0;
+    }
+    fclose (h);
+    write_log ("HDF overlay '%s' discarded\n", overlay_path);
+    return 1;
+}
+
+int hdf_overlay_commit (const char *path, const char *overlay_path)
+{
+    struct hdf_overlay_header hdr;
+    FILE *oh, *bh = NULL;
+    uae_u8 *bitmap = NULL, *buf = NULL;
+    uae_u64 blocks, data_offset, bitmapsize, committed = 0;
+    int ret, result = 0;
+
+    oh = uae_tfopen (overlay_path, "rb");
+    if (oh == INVALID_HANDLE_VALUE) {
+        write_log ("HDF overlay '%s' could not be opened, error %d\n",
+                overlay_path, errno);
+        return 0;
+    }
+    ret = overlay_read_header (oh, &hdr);
+    if (ret <= 0) {
+        fclose (oh);
+        if (ret == 0)
+            return 1;
+        write_log ("HDF overlay '%s' is not an overlay file\n", overlay_path);
+        return 0;
+    }
+    bh = uae_tfopen (path, "r+b");
+    if (bh == INVALID_HANDLE_VALUE || uae_fseeko64 (bh, 0, SEEK_END) != 0 ||
+            !overlay_matches (&hdr, path, uae_ftello64 (bh) &
+                    ~((uae_u64) hdr.blocksize - 1), 0)) {
+        write_log ("HDF overlay '%s' does not belong to '%s'\n",
+                overlay_path, path);
+        goto end;
+    }
+    blocks = hdr.size / hdr.blocksize;
+    data_offset = overlay_data_offset (blocks);
+    bitmapsize = (blocks + 7) / 8;
+    bitmap = xcalloc (uae_u8, bitmapsize + 1);
+    buf = xmalloc (uae_u8, CACHE_SIZE);
+    if (uae_fseeko64 (oh, HDF_OVERLAY_HEADER_SIZE, SEEK_SET) != 0 ||
+            (fread (bitmap, 1, bitmapsize, oh) != bitmapsize && ferror (oh)))
+        goto end;
+    for (uae_u64 block = 0; block < blocks; ) {
+        if (!(bitmap[block >> 3] & (1 << (block & 7)))) {
+            block++;
+            continue;
+        }
+        uae_u64 end = block + 1;
+        while (end < blocks && (bitmap[end >> 3] & (1 << (end & 7))) &&
+                (end - block + 1) * hdr.blocksize <= CACHE_SIZE)
+            end++;
+        size_t len = (end - block) * hdr.blocksize;
+        uae_u64 offset = block * hdr.blocksize;
+        if (uae_fseeko64 (oh, data_offset + offset, SEEK_SET) != 0 ||
+                fread (buf, 1, len, oh) != len ||
+                uae_fseeko64 (bh, offset, SEEK_SET) != 0 ||
+                fwrite (buf, 1, len, bh) != len) {
+            write_log ("HDF overlay commit failed at 0x%llx, error %d\n",
+                    offset, errno);
+            goto end;
+        }
+        committed += end - block;
+        block = end;
+    }
+    if (fflush (bh) != 0)
+        goto end;
+    write_log ("HDF overlay '%s': %lld blocks written to '%s'\n",
+            overlay_path, (long long) committed, path);
+    result = 1;
+end:
+    xfree (buf);
+    xfree (bitmap);
+    if (bh && fclose (bh) != 0)
+        result = 0;
+    fclose (oh);
+    if (result)
+        result = hdf_overlay_discard (overlay_path);
+    return result;
+}
+
 int hdf_open_target (struct hardfiledata *hfd, const char *pname)
 {
     FILE *h = INVALID_HANDLE_VALUE;
@@ -279,6 +706,7 @@ int hdf_open_target (struct hardfiledata *hfd, const char *pname)
         }
     } else {
         int zmode = 0;
+        const char *overlay = overlay_path (name);
         char *ext = _tcsrchr (name, '.');
         if (ext != NULL) {
             ext++;
@@ -287,7 +715,12 @@ int hdf_open_target (struct hardfiledata *hfd, const char *pname)
                     zmode = 1;
             }
         }
-        h = uae_tfopen (name, hfd->ci.readonly ? "rb" : "r+b");
+        if (overlay && hfd->ci.readonly) {
+            write_log ("HDF '%s' is read-only, overlay not used\n", name);
+            overlay = NULL;
+        }
+        /* with an overlay, the image itself is never written to */
+        h = uae_tfopen (name, hfd->ci.readonly || overlay ? "rb" : "r+b");
         if (h == INVALID_HANDLE_VALUE)
             goto end;
         hfd->handle->h = h;
@@ -385,6 +818,11 @@ int hdf_open_target (struct hardfiledata *hfd, const char *pname)
                 zfile_fseek (hfd->handle->zf, 0, SEEK_SET);
                 hfd->handle_valid = HDF_HANDLE_ZFILE;
             }
+            if (overlay && hfd->handle_valid == HDF_HANDLE_LINUX) {
+                hfd->handle->overlay = overlay_open (hfd, name, overlay);
+                if (hfd->handle->overlay == NULL)
+                    goto end;
+            }
         } else {
             write_log ("HDF '%s' failed to open. error = %d\n", name, errno);
         }
@@ -421,6 +859,9 @@ void hdf_close_target (struct hardfiledata *hfd) {
         write_log("closing file handle %p\n", hfd->handle->h);
         fclose(hfd->handle->h);
     }
+    if (hfd->handle) {
+        overlay_close (hfd->handle->overlay);
+    }
     //freehandle (hfd->handle);
     xfree (hfd->handle);
     xfree (hfd->emptyname);
@@ -558,6 +999,9 @@ static int hdf_read_2 (struct hardfiledata *hfd, void *buffer, uae_u64 offset, i
     hfd->cache_valid = 0;
     if (outlen != CACHE_SIZE)
         return 0;
+    if (hfd->handle->overlay &&
+            !overlay_patch (hfd, hfd->cache, hfd->cache_offset, CACHE_SIZE))
+        return 0;
     hfd->cache_valid = 1;
     coffset = isincache (hfd, offset, len);
     if (coffset >= 0) {
@@ -593,6 +1037,9 @@ int hdf_read_target (struct hardfiledata *hfd, void *buffer, uae_u64 offset, int
             poscheck (hfd, len);
             if (hfd->handle_valid == HDF_HANDLE_LINUX) {
                 ret = fread (hfd->cache, 1, len, hfd->handle->h);
+                if (hfd->handle->overlay &&
+                        !overlay_patch (hfd, hfd->cache, offset, ret))
+                    ret = 0;
                 memcpy (buffer, hfd->cache, ret);
             } else if (hfd->handle_valid == HDF_HANDLE_ZFILE) {
                 ret = zfile_fread (buffer, 1, len, hfd->handle->zf);
@@ -629,6 +1076,9 @@ static int hdf_write_2 (struct hardfiledata *hfd, void *buffer, uae_u64 offset,
         return 0;
     }
     hfd->cache_valid = 0;
+    if (hfd->handle->overlay) {
+        return overlay_write (hfd, (uae_u8 *) buffer, offset, len);
+    }
     hdf_seek (hfd, offset);
     poscheck (hfd, len);
     memcpy (hfd->cache, buffer, len);
@@ -698,6 +1148,10 @@ int hdf_write_target (struct hardfiledata *hfd, void *buffer, uae_u64 offset, in
 
 int hdf_resize_target(struct hardfiledata *hfd, uae_u64 newsize)
 {
+    if (hfd->handle->overlay) {
+        uae_log("hdf_resize_target: not supported with an overlay\n");
+        return 0;
+    }
     if (newsize < hfd->physsize) {
         uae_log("hdf_resize_target: truncation not implemented\n");
         return 0;
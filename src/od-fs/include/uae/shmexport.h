@@ -0,0 +1,90 @@
+#ifndef UAE_SHMEXPORT_H
+#define UAE_SHMEXPORT_H
+
+/*
+ * Layout of the POSIX shared memory object used to export finished video
+ * frames and the Paula audio stream to external encoders / streamers.
+ *
+ * The object starts with uae_shm_export_header, followed by video_slots
+ * frame slots of video_slot_bytes each (at video_offset), followed by the
+ * audio ring buffer of audio_bytes bytes (at audio_offset). All offsets are
+ * relative to the start of the mapping.
+ *
+ * Video: frames are written round-robin into the slots. Each slot is
+ * protected by a sequence lock: the writer makes seq odd before touching
+ * the slot and even again when the slot is complete. A reader should:
+ *
+ *   1. read video_frame (number of the most recently completed frame,
+ *      0 until the first frame is written), slot = video_frame % video_slots
+ *   2. s1 = slot.seq (retry / skip if odd)
+ *   3. copy the slot description and pixel data
+ *   4. s2 = slot.seq, the copy is valid if s1 == s2
+ *
+ * Audio: signed 16-bit native endian samples (audio_channels interleaved
+ * channels at audio_frequency Hz) are appended to the ring buffer.
+ * audio_write_pos is the total number of bytes ever written (the ring
+ * position is audio_write_pos % audio_bytes). audio_time is the monotonic
+ * time (in microseconds) at which the data ending at audio_write_pos was
+ * written. A reader keeps its own read position and should:
+ *
+ *   1. w1 = audio_write_pos, skip ahead if read_pos < w1 - audio_bytes
+ *   2. copy the bytes from read_pos up to w1 out of the ring
+ *   3. w2 = audio_write_pos, bytes before w2 - audio_bytes may have been
+ *      overwritten during the copy: the copy is valid from
+ *      max(read_pos, w2 - audio_bytes) on, drop what comes before
+ *
+ * The object is created exclusively, it is not reused if it exists.
+ *
+ * The writer never waits for readers, so exporting does not affect
+ * emulation timing.
+ */
+
+#include <stdint.h>
+
+#define UAE_SHM_EXPORT_MAGIC 0x46535545 /* "FSUE" */
+#define UAE_SHM_EXPORT_VERSION 1
+
+#define UAE_SHM_EXPORT_FORMAT_RGBA 0
+#define UAE_SHM_EXPORT_FORMAT_BGRA 1
+#define UAE_SHM_EXPORT_FORMAT_R5G6B5 2
+#define UAE_SHM_EXPORT_FORMAT_R5G5B5A1 3
+
+#define UAE_SHM_EXPORT_FLAG_RTG 1
+
+typedef struct uae_shm_export_slot {
+    volatile uint32_t seq;
+    uint32_t flags;
+    uint64_t frame;
+    int64_t time;
+    int32_t width;
+    int32_t height;
+    int32_t stride;
+    int32_t format;
+    /* Visible part of the frame (autoscale limits) */
+    int32_t crop_x;
+    int32_t crop_y;
+    int32_t crop_w;
+    int32_t crop_h;
+} uae_shm_export_slot;
+
+#define UAE_SHM_EXPORT_MAX_SLOTS 8
+
+typedef struct uae_shm_export_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t video_slots;
+    uint64_t video_offset;
+    uint64_t video_slot_bytes;
+    uint64_t audio_offset;
+    uint64_t audio_bytes;
+    int32_t audio_frequency;
+    int32_t audio_channels;
+    /* Written by the emulator */
+    volatile uint64_t video_frame;
+    volatile uint64_t audio_write_pos;
+    volatile int64_t audio_time;
+    uae_shm_export_slot slots[UAE_SHM_EXPORT_MAX_SLOTS];
+} uae_shm_export_header;
+
+#endif /* UAE_SHMEXPORT_H */
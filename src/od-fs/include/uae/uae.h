@@ -197,6 +197,26 @@ void amiga_flush_audio(void);
 
 int amiga_set_option(const char *option, const char *value);
 
+/* Opens the hard drive image at path read-only and sends writes to a
+ * sparse overlay file instead. Must be called before the drive is
+ * mounted. */
+int amiga_set_hard_drive_overlay(const char *path, const char *overlay_path);
+/* Writes the blocks changed in the overlay back to the image and empties
+ * the overlay. The drive must not be in use. */
+int amiga_commit_hard_drive_overlay(const char *path,
+        const char *overlay_path);
+/* Empties the overlay, so the drive is reset to the image. */
+int amiga_discard_hard_drive_overlay(const char *overlay_path);
+
+/* Export video frames and audio to a POSIX shared memory object, see
+ * uae/shmexport.h for the layout. An existing object with the same name
+ * is only removed (and replaced) if replace is set. */
+int amiga_shm_export_init(const char *name, int slots, int replace);
+
+/* Record video and audio to <path>.y4m and <path>.wav. The recording is
+ * finalized when the emulation ends. */
+int amiga_avrecord_start(const char *path);
+
 typedef void (*amiga_free_function)(void* data);
 int amiga_set_option_and_free(const char *option, char *value,
     amiga_free_function free_function);
@@ -10,6 +10,7 @@
 #include "uae/memory.h"
 #include "autoconf.h"
 #include "options.h"
+#include "filesys.h"
 #include "blkdev.h"
 #include "clipboard.h"
 #include "custom.h"
@@ -624,6 +625,22 @@ int amiga_set_int_option(const char *option, int value) {
     return result;
 }
 
+int amiga_set_hard_drive_overlay(const char *path, const char *overlay_path)
+{
+    return hdf_overlay_set(path, overlay_path);
+}
+
+int amiga_commit_hard_drive_overlay(const char *path,
+        const char *overlay_path)
+{
+    return hdf_overlay_commit(path, overlay_path);
+}
+
+int amiga_discard_hard_drive_overlay(const char *overlay_path)
+{
+    return hdf_overlay_discard(overlay_path);
+}
+
 int amiga_quit()
 {
     printf("UAE: Calling uae_quit\n");
@@ -0,0 +1,216 @@
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#include "uae/fs.h"
+#include "uae/glib.h"
+#include "uae/shmexport.h"
+
+#ifdef HAVE_SHM_OPEN
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Large enough for the chipset frame buffer and for RTG screens up to
+// 3840x2160 in 32-bit.
+#define SHM_EXPORT_SLOT_BYTES (3840 * 2160 * 4)
+#define SHM_EXPORT_AUDIO_BYTES (1024 * 1024)
+
+static struct {
+    uae_shm_export_header *header;
+    uint8_t *base;
+    size_t size;
+    char *name;
+    bool warned;
+} g_shm_export;
+
+static void shm_export_cleanup(void)
+{
+#ifdef HAVE_SHM_OPEN
+    if (g_shm_export.base) {
+        munmap(g_shm_export.base, g_shm_export.size);
+        g_shm_export.base = NULL;
+        g_shm_export.header = NULL;
+    }
+    if (g_shm_export.name) {
+        shm_unlink(g_shm_export.name);
+        g_free(g_shm_export.name);
+        g_shm_export.name = NULL;
+    }
+#endif
+}
+
+int amiga_shm_export_init(const char *name, int slots, int replace)
+{
+#ifdef HAVE_SHM_OPEN
+    if (g_shm_export.header) {
+        write_log("SHM: export already initialized\n");
+        return 0;
+    }
+    if (slots <= 0) {
+        slots = 3;
+    } else if (slots > UAE_SHM_EXPORT_MAX_SLOTS) {
+        slots = UAE_SHM_EXPORT_MAX_SLOTS;
+    }
+    // POSIX shared memory object names must start with a slash
+    char *shm_name;
+    if (name[0] == '/') {
+        shm_name = g_strdup(name);
+    } else {
+        shm_name = g_strdup_printf("/%s", name);
+    }
+
+    size_t header_size = (sizeof(uae_shm_export_header) + 4095) & ~4095;
+    size_t video_offset = header_size;
+    size_t audio_offset = video_offset + (size_t) slots * SHM_EXPORT_SLOT_BYTES;
+    size_t size = audio_offset + SHM_EXPORT_AUDIO_BYTES;
+
+    // Another instance or a reader may still map an existing object, it
+    // must not be truncated under them
+    if (replace && shm_unlink(shm_name) == 0) {
+        write_log("SHM: removed existing %s\n", shm_name);
+    }
+    int fd = shm_open(shm_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1) {
+        if (errno == EEXIST) {
+            write_log("SHM: %s already exists (used by another instance? "
+                      "set shm_export_replace to replace it)\n", shm_name);
+        } else {
+            write_log("SHM: could not create %s (%s)\n", shm_name,
+                      strerror(errno));
+        }
+        g_free(shm_name);
+        return 0;
+    }
+    // The object is sparse, only the pages actually written use memory
+    if (ftruncate(fd, size) == -1) {
+        write_log("SHM: could not resize %s (%s)\n", shm_name,
+                  strerror(errno));
+        close(fd);
+        shm_unlink(shm_name);
+        g_free(shm_name);
+        return 0;
+    }
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        write_log("SHM: could not map %s (%s)\n", shm_name, strerror(errno));
+        shm_unlink(shm_name);
+        g_free(shm_name);
+        return 0;
+    }
+
+    g_shm_export.base = (uint8_t *) base;
+    g_shm_export.size = size;
+    g_shm_export.name = shm_name;
+    g_shm_export.header = (uae_shm_export_header *) base;
+
+    uae_shm_export_header *h = g_shm_export.header;
+    h->version = UAE_SHM_EXPORT_VERSION;
+    h->header_size = sizeof(uae_shm_export_header);
+    h->video_slots = slots;
+    h->video_offset = video_offset;
+    h->video_slot_bytes = SHM_EXPORT_SLOT_BYTES;
+    h->audio_offset = audio_offset;
+    h->audio_bytes = SHM_EXPORT_AUDIO_BYTES;
+    h->audio_channels = 2;
+    // Readers check the magic value last, when the header is complete
+    __sync_synchronize();
+    h->magic = UAE_SHM_EXPORT_MAGIC;
+
+    atexit(shm_export_cleanup);
+    write_log("SHM: exporting video and audio to %s (%d slots, %zu bytes)\n",
+              shm_name, slots, size);
+    return 1;
+#else
+    write_log("SHM: shared memory export is not supported on this system\n");
+    return 0;
+#endif
+}
+
+void uae_shm_export_video(const uint8_t *pixels, int width, int height,
+                          int stride, int bpp, int crop_x, int crop_y,
+                          int crop_w, int crop_h, int flags)
+{
+    uae_shm_export_header *h = g_shm_export.header;
+    if (h == NULL || pixels == NULL || width <= 0 || height <= 0) {
+        return;
+    }
+    int line_bytes = width * bpp;
+    if ((uint64_t) line_bytes * height > h->video_slot_bytes) {
+        if (!g_shm_export.warned) {
+            write_log("SHM: %dx%d frame does not fit in slot, skipping\n",
+                      width, height);
+            g_shm_export.warned = true;
+        }
+        return;
+    }
+
+    uint64_t frame = h->video_frame + 1;
+    int index = frame % h->video_slots;
+    uae_shm_export_slot *slot = h->slots + index;
+    uint8_t *dst = g_shm_export.base + h->video_offset +
+                   index * h->video_slot_bytes;
+
+    // Odd sequence number: slot is being written
+    slot->seq++;
+    __sync_synchronize();
+
+    slot->flags = flags;
+    slot->frame = frame;
+    slot->time = g_get_monotonic_time();
+    slot->width = width;
+    slot->height = height;
+    slot->stride = line_bytes;
+    slot->format = g_amiga_video_format;
+    slot->crop_x = crop_x;
+    slot->crop_y = crop_y;
+    slot->crop_w = crop_w;
+    slot->crop_h = crop_h;
+    if (stride == line_bytes) {
+        memcpy(dst, pixels, (size_t) line_bytes * height);
+    } else {
+        for (int y = 0; y < height; y++) {
+            memcpy(dst, pixels, line_bytes);
+            dst += line_bytes;
+            pixels += stride;
+        }
+    }
+
+    __sync_synchronize();
+    slot->seq++;
+    __sync_synchronize();
+    h->video_frame = frame;
+}
+
+void uae_shm_export_audio(const int16_t *data, int bytes, int frequency,
+                          int channels)
+{
+    uae_shm_export_header *h = g_shm_export.header;
+    if (h == NULL || bytes <= 0) {
+        return;
+    }
+    uint8_t *ring = g_shm_export.base + h->audio_offset;
+    const uint8_t *src = (const uint8_t *) data;
+    h->audio_frequency = frequency;
+    h->audio_channels = channels;
+
+    uint64_t pos = h->audio_write_pos;
+    int left = bytes;
+    while (left > 0) {
+        size_t offset = pos % h->audio_bytes;
+        size_t chunk = h->audio_bytes - offset;
+        if (chunk > (size_t) left) {
+            chunk = left;
+        }
+        memcpy(ring + offset, src, chunk);
+        src += chunk;
+        pos += chunk;
+        left -= chunk;
+    }
+
+    __sync_synchronize();
+    h->audio_time = g_get_monotonic_time();
+    h->audio_write_pos = pos;
+}
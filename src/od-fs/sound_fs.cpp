@@ -278,6 +278,10 @@ void finish_sound_buffer (void)
 #endif
 	// must be after driveclick_mix
 	paula_sndbufpt = paula_sndbuffer;
+	uae_shm_export_audio((int16_t *) paula_sndbuffer, bufsize, g_frequency,
+			get_audio_nativechannels(currprefs.sound_stereo));
+	uae_avrecord_audio((int16_t *) paula_sndbuffer, bufsize, g_frequency,
+			get_audio_nativechannels(currprefs.sound_stereo));
 #ifdef AVIOUTPUT
 	if (avioutput_enabled && avioutput_audio) {
 		AVIOutput_WriteAudio((uae_u8*)paula_sndbuffer, bufsize);
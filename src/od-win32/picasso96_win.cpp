@@ -88,6 +88,7 @@ int debug_rtg_blitter = 3;
 
 #include "uae/byteswap.h"
 #include "uae/fs.h"
+#include "uae/vm.h"
 #include "picasso96.h"
 
 // FIXME: justing setting static value here -FS
@@ -1116,6 +1117,350 @@ int getconvert(int rgbformat, int pixbytes)
 	return v;
 }
 
+#ifdef FSUAE
+
+/*
+ * Vectorized versions of the most common copyrow conversions to 32-bit
+ * host pixels. The implementation is selected from the host CPU features
+ * by rtg_convert_init. rtg_convert_row converts as many pixels as it can
+ * (a multiple of the vector size) and returns the count, the remaining
+ * pixels are converted by the generic code.
+ */
+
+#if !defined(WORDS_BIGENDIAN) && defined(__GNUC__) && defined(__x86_64__)
+#define RTG_CONVERT_X86
+#include <immintrin.h>
+#elif !defined(WORDS_BIGENDIAN) && defined(__aarch64__)
+#define RTG_CONVERT_NEON
+#include <arm_neon.h>
+#endif
+
+struct rtg_rgb16_format {
+	bool swap;
+	int rshift, gshift, bshift;
+	int gbits;
+};
+
+/* In RGBFB_R5G6B5PC_32 .. RGBFB_B5G5R5PC_32 order */
+static const struct rtg_rgb16_format rtg_rgb16_formats[] = {
+	{ false, 11, 5, 0, 6 },
+	{ false, 10, 5, 0, 5 },
+	{ true, 11, 5, 0, 6 },
+	{ true, 10, 5, 0, 5 },
+	{ false, 0, 5, 11, 6 },
+	{ false, 0, 5, 10, 5 },
+};
+
+/* Source byte offsets of the blue, green and red components */
+static const uae_u8 rtg_order_rgb[3] = { 2, 1, 0 };
+static const uae_u8 rtg_order_argb[3] = { 3, 2, 1 };
+static const uae_u8 rtg_order_abgr[3] = { 1, 2, 3 };
+static const uae_u8 rtg_order_bgr[3] = { 0, 1, 2 };
+
+typedef int (*rtg_shuffle_func)(const uae_u8 *src, uae_u32 *dst, int width, const uae_u8 *order);
+typedef int (*rtg_rgb16_func)(const uae_u8 *src, uae_u32 *dst, int width, const struct rtg_rgb16_format *f, bool rgba);
+typedef int (*rtg_clut8_func)(const uae_u8 *src, uae_u32 *dst, int width, const uae_u32 *clut);
+
+struct rtg_convert_impl {
+	const TCHAR *name;
+	rtg_shuffle_func shuffle32;
+	rtg_shuffle_func shuffle24;
+	rtg_rgb16_func rgb16;
+	rtg_clut8_func clut8;
+};
+
+#ifdef RTG_CONVERT_X86
+
+__attribute__((target("ssse3")))
+static int rtg_shuffle32_ssse3(const uae_u8 *src, uae_u32 *dst, int width, const uae_u8 *order)
+{
+	uae_u8 m[16];
+	for (int i = 0; i < 16; i += 4) {
+		m[i + 0] = i + order[0];
+		m[i + 1] = i + order[1];
+		m[i + 2] = i + order[2];
+		m[i + 3] = 0x80;
+	}
+	__m128i mask = _mm_loadu_si128((const __m128i*)m);
+	int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + x * 4));
+		_mm_storeu_si128((__m128i*)(dst + x), _mm_shuffle_epi8(v, mask));
+	}
+	return x;
+}
+
+__attribute__((target("ssse3")))
+static int rtg_shuffle24_ssse3(const uae_u8 *src, uae_u32 *dst, int width, const uae_u8 *order)
+{
+	uae_u8 m[16];
+	for (int i = 0; i < 4; i++) {
+		m[i * 4 + 0] = i * 3 + order[0];
+		m[i * 4 + 1] = i * 3 + order[1];
+		m[i * 4 + 2] = i * 3 + order[2];
+		m[i * 4 + 3] = 0x80;
+	}
+	__m128i mask = _mm_loadu_si128((const __m128i*)m);
+	int x = 0;
+	/* 16 bytes are loaded for 4 pixels, do not read past the row */
+	for (; x + 6 <= width; x += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + x * 3));
+		_mm_storeu_si128((__m128i*)(dst + x), _mm_shuffle_epi8(v, mask));
+	}
+	return x;
+}
+
+__attribute__((target("avx2")))
+static int rtg_shuffle32_avx2(const uae_u8 *src, uae_u32 *dst, int width, const uae_u8 *order)
+{
+	/* vpshufb works within 128-bit lanes, the same mask for both */
+	uae_u8 m[32];
+	for (int i = 0; i < 32; i += 4) {
+		m[i + 0] = (i & 15) + order[0];
+		m[i + 1] = (i & 15) + order[1];
+		m[i + 2] = (i & 15) + order[2];
+		m[i + 3] = 0x80;
+	}
+	__m256i mask = _mm256_loadu_si256((const __m256i*)m);
+	int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(src + x * 4));
+		_mm256_storeu_si256((__m256i*)(dst + x), _mm256_shuffle_epi8(v, mask));
+	}
+	return x;
+}
+
+static int rtg_rgb16_sse2(const uae_u8 *src, uae_u32 *dst, int width, const struct rtg_rgb16_format *f, bool rgba)
+{
+	const __m128i rs = _mm_cvtsi32_si128(f->rshift);
+	const __m128i gs = _mm_cvtsi32_si128(f->gshift);
+	const __m128i bs = _mm_cvtsi32_si128(f->bshift);
+	const __m128i gl = _mm_cvtsi32_si128(8 - f->gbits);
+	const __m128i mask5 = _mm_set1_epi16(0x1f);
+	const __m128i gmask = _mm_set1_epi16((1 << f->gbits) - 1);
+	const __m128i low5 = _mm_set1_epi16(0x07);
+	const __m128i glow = _mm_set1_epi16((1 << (8 - f->gbits)) - 1);
+	int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + x * 2));
+		if (f->swap)
+			v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		/* Same expansion to 8 bits as alloc_colors_picasso */
+		__m128i r = _mm_and_si128(_mm_srl_epi16(v, rs), mask5);
+		__m128i g = _mm_and_si128(_mm_srl_epi16(v, gs), gmask);
+		__m128i b = _mm_and_si128(_mm_srl_epi16(v, bs), mask5);
+		r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_and_si128(r, low5));
+		g = _mm_or_si128(_mm_sll_epi16(g, gl), _mm_and_si128(g, glow));
+		b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_and_si128(b, low5));
+		if (rgba) {
+			__m128i t = r;
+			r = b;
+			b = t;
+		}
+		__m128i gb = _mm_or_si128(_mm_slli_epi16(g, 8), b);
+		_mm_storeu_si128((__m128i*)(dst + x), _mm_unpacklo_epi16(gb, r));
+		_mm_storeu_si128((__m128i*)(dst + x + 4), _mm_unpackhi_epi16(gb, r));
+	}
+	return x;
+}
+
+__attribute__((target("avx2")))
+static int rtg_rgb16_avx2(const uae_u8 *src, uae_u32 *dst, int width, const struct rtg_rgb16_format *f, bool rgba)
+{
+	const __m128i rs = _mm_cvtsi32_si128(f->rshift);
+	const __m128i gs = _mm_cvtsi32_si128(f->gshift);
+	const __m128i bs = _mm_cvtsi32_si128(f->bshift);
+	const __m128i gl = _mm_cvtsi32_si128(8 - f->gbits);
+	const __m256i mask5 = _mm256_set1_epi16(0x1f);
+	const __m256i gmask = _mm256_set1_epi16((1 << f->gbits) - 1);
+	const __m256i low5 = _mm256_set1_epi16(0x07);
+	const __m256i glow = _mm256_set1_epi16((1 << (8 - f->gbits)) - 1);
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(src + x * 2));
+		if (f->swap)
+			v = _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8));
+		__m256i r = _mm256_and_si256(_mm256_srl_epi16(v, rs), mask5);
+		__m256i g = _mm256_and_si256(_mm256_srl_epi16(v, gs), gmask);
+		__m256i b = _mm256_and_si256(_mm256_srl_epi16(v, bs), mask5);
+		r = _mm256_or_si256(_mm256_slli_epi16(r, 3), _mm256_and_si256(r, low5));
+		g = _mm256_or_si256(_mm256_sll_epi16(g, gl), _mm256_and_si256(g, glow));
+		b = _mm256_or_si256(_mm256_slli_epi16(b, 3), _mm256_and_si256(b, low5));
+		if (rgba) {
+			__m256i t = r;
+			r = b;
+			b = t;
+		}
+		__m256i gb = _mm256_or_si256(_mm256_slli_epi16(g, 8), b);
+		/* Unpacking is done per 128-bit lane, put the pixels back in order */
+		__m256i lo = _mm256_unpacklo_epi16(gb, r);
+		__m256i hi = _mm256_unpackhi_epi16(gb, r);
+		_mm256_storeu_si256((__m256i*)(dst + x), _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i*)(dst + x + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+	return x;
+}
+
+__attribute__((target("avx2")))
+static int rtg_clut8_avx2(const uae_u8 *src, uae_u32 *dst, int width, const uae_u32 *clut)
+{
+	int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + x)));
+		__m256i v = _mm256_i32gather_epi32((const int*)clut, idx, 4);
+		_mm256_storeu_si256((__m256i*)(dst + x), v);
+	}
+	return x;
+}
+
+#endif /* RTG_CONVERT_X86 */
+
+#ifdef RTG_CONVERT_NEON
+
+static int rtg_shuffle32_neon(const uae_u8 *src, uae_u32 *dst, int width, const uae_u8 *order)
+{
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		uint8x16x4_t v = vld4q_u8(src + x * 4);
+		uint8x16x4_t o;
+		o.val[0] = v.val[order[0]];
+		o.val[1] = v.val[order[1]];
+		o.val[2] = v.val[order[2]];
+		o.val[3] = vdupq_n_u8(0);
+		vst4q_u8((uae_u8*)(dst + x), o);
+	}
+	return x;
+}
+
+static int rtg_shuffle24_neon(const uae_u8 *src, uae_u32 *dst, int width, const uae_u8 *order)
+{
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		uint8x16x3_t v = vld3q_u8(src + x * 3);
+		uint8x16x4_t o;
+		o.val[0] = v.val[order[0]];
+		o.val[1] = v.val[order[1]];
+		o.val[2] = v.val[order[2]];
+		o.val[3] = vdupq_n_u8(0);
+		vst4q_u8((uae_u8*)(dst + x), o);
+	}
+	return x;
+}
+
+static int rtg_rgb16_neon(const uae_u8 *src, uae_u32 *dst, int width, const struct rtg_rgb16_format *f, bool rgba)
+{
+	/* vshlq with a negative count shifts right */
+	const int16x8_t rs = vdupq_n_s16(-f->rshift);
+	const int16x8_t gs = vdupq_n_s16(-f->gshift);
+	const int16x8_t bs = vdupq_n_s16(-f->bshift);
+	const int16x8_t gl = vdupq_n_s16(8 - f->gbits);
+	const uint16x8_t mask5 = vdupq_n_u16(0x1f);
+	const uint16x8_t gmask = vdupq_n_u16((1 << f->gbits) - 1);
+	const uint16x8_t low5 = vdupq_n_u16(0x07);
+	const uint16x8_t glow = vdupq_n_u16((1 << (8 - f->gbits)) - 1);
+	int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		uint16x8_t v = vld1q_u16((const uae_u16*)(src + x * 2));
+		if (f->swap)
+			v = vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(v)));
+		uint16x8_t r = vandq_u16(vshlq_u16(v, rs), mask5);
+		uint16x8_t g = vandq_u16(vshlq_u16(v, gs), gmask);
+		uint16x8_t b = vandq_u16(vshlq_u16(v, bs), mask5);
+		r = vorrq_u16(vshlq_n_u16(r, 3), vandq_u16(r, low5));
+		g = vorrq_u16(vshlq_u16(g, gl), vandq_u16(g, glow));
+		b = vorrq_u16(vshlq_n_u16(b, 3), vandq_u16(b, low5));
+		uint8x8x4_t o;
+		o.val[0] = vmovn_u16(rgba ? r : b);
+		o.val[1] = vmovn_u16(g);
+		o.val[2] = vmovn_u16(rgba ? b : r);
+		o.val[3] = vdup_n_u8(0);
+		vst4_u8((uae_u8*)(dst + x), o);
+	}
+	return x;
+}
+
+#endif /* RTG_CONVERT_NEON */
+
+static const struct rtg_convert_impl *rtg_convert_impl;
+
+static void rtg_convert_init(void)
+{
+#if defined(RTG_CONVERT_X86)
+	static const struct rtg_convert_impl sse2 = {
+		_T("SSE2"), NULL, NULL, rtg_rgb16_sse2, NULL
+	};
+	static const struct rtg_convert_impl ssse3 = {
+		_T("SSSE3"), rtg_shuffle32_ssse3, rtg_shuffle24_ssse3, rtg_rgb16_sse2, NULL
+	};
+	static const struct rtg_convert_impl avx2 = {
+		_T("AVX2"), rtg_shuffle32_avx2, rtg_shuffle24_ssse3, rtg_rgb16_avx2, rtg_clut8_avx2
+	};
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		rtg_convert_impl = &avx2;
+	else if (__builtin_cpu_supports("ssse3"))
+		rtg_convert_impl = &ssse3;
+	else
+		rtg_convert_impl = &sse2;
+#elif defined(RTG_CONVERT_NEON)
+	/* No gather instruction, CLUT modes use the generic code */
+	static const struct rtg_convert_impl neon = {
+		_T("NEON"), rtg_shuffle32_neon, rtg_shuffle24_neon, rtg_rgb16_neon, NULL
+	};
+	rtg_convert_impl = &neon;
+#else
+	static const struct rtg_convert_impl generic = { _T("generic") };
+	rtg_convert_impl = &generic;
+#endif
+	write_log(_T("RTG: using %s pixel conversion\n"), rtg_convert_impl->name);
+}
+
+/* The 16-bit conversion writes the component order of the rgbx16 table,
+ * which is RGBA for video_format=rgba (except for screenshots) */
+static bool rtg_rgb16_is_rgba(const struct rtg_rgb16_format *f, const uae_u32 *rgbx16)
+{
+	uae_u16 red = 0x1f << f->rshift;
+	if (f->swap)
+		red = (uae_u16) ((red >> 8) | (red << 8));
+	return !(rgbx16[red] & 0x00ff0000);
+}
+
+static int rtg_convert_row(int convert_mode, const uae_u8 *src, uae_u32 *dst, int width, const uae_u32 *clut, const uae_u32 *rgbx16)
+{
+	const struct rtg_convert_impl *impl = rtg_convert_impl;
+	if (impl == NULL)
+		return 0;
+	switch (convert_mode)
+	{
+	case RGBFB_R8G8B8A8_32:
+		return impl->shuffle32 ? impl->shuffle32(src, dst, width, rtg_order_rgb) : 0;
+	case RGBFB_A8R8G8B8_32:
+		return impl->shuffle32 ? impl->shuffle32(src, dst, width, rtg_order_argb) : 0;
+	case RGBFB_A8B8G8R8_32:
+		return impl->shuffle32 ? impl->shuffle32(src, dst, width, rtg_order_abgr) : 0;
+	case RGBFB_R8G8B8_32:
+		return impl->shuffle24 ? impl->shuffle24(src, dst, width, rtg_order_rgb) : 0;
+	case RGBFB_B8G8R8_32:
+		return impl->shuffle24 ? impl->shuffle24(src, dst, width, rtg_order_bgr) : 0;
+	case RGBFB_R5G6B5PC_32:
+	case RGBFB_R5G5B5PC_32:
+	case RGBFB_R5G6B5_32:
+	case RGBFB_R5G5B5_32:
+	case RGBFB_B5G6R5PC_32:
+	case RGBFB_B5G5R5PC_32:
+		if (impl->rgb16) {
+			const struct rtg_rgb16_format *f = &rtg_rgb16_formats[convert_mode - RGBFB_R5G6B5PC_32];
+			return impl->rgb16(src, dst, width, f, rtg_rgb16_is_rgba(f, rgbx16));
+		}
+		return 0;
+	case RGBFB_CLUT_RGBFB_32:
+		return impl->clut8 ? impl->clut8(src, dst, width, clut) : 0;
+	}
+	return 0;
+}
+
+#endif /* FSUAE */
+
 static void setconvert(int monid)
 {
 	lockrtg();
@@ -1124,6 +1469,8 @@ static void setconvert(int monid)
 
 	vidinfo->picasso_convert = getconvert(state->RGBFormat, picasso_vidinfo[monid].pixbytes);
 #ifdef FSUAE
+	if (rtg_convert_impl == NULL)
+		rtg_convert_init();
 	if (g_amiga_video_format == AMIGA_VIDEO_FORMAT_RGBA) {
 		vidinfo->host_mode = RGBFB_R8G8B8A8;
 	}
@@ -1642,6 +1989,168 @@ void picasso_handle_hsync(void)
 #undef BLT_SIZE
 #undef BLT_MULT
 
+#if defined(FSUAE) && defined(__GNUC__)
+
+/*
+ * Vector versions of the BlitRect minterms and of the template expansion
+ * and planar to chunky conversion. They use the GCC vector extensions,
+ * which are compiled to SSE2 or NEON instructions. VRAM rows need not be
+ * aligned, so loads and stores are done with memcpy.
+ */
+#define P96_VECTOR
+
+typedef uae_u32 p96_vec __attribute__((vector_size(16)));
+typedef uae_u16 p96_vec16 __attribute__((vector_size(16)));
+typedef uae_u8 p96_vec8 __attribute__((vector_size(16)));
+typedef uae_u8 p96_vec8x8 __attribute__((vector_size(8)));
+
+/* The minterms are bitwise operations, so the pixel size does not matter
+ * and all depths share the same functions. */
+#define P96_VECTOR_BLIT(NAME, OP) \
+static void NAME (unsigned long w, unsigned long h, uae_u8 *src, uae_u8 *dst, int srcpitch, int dstpitch) \
+{ \
+	for (unsigned long y = 0; y < h; y++, src += srcpitch, dst += dstpitch) { \
+		unsigned long x = 0; \
+		for (; x + sizeof(p96_vec) <= w; x += sizeof(p96_vec)) { \
+			p96_vec s, d; \
+			memcpy(&s, src + x, sizeof s); \
+			memcpy(&d, dst + x, sizeof d); \
+			(void)s; \
+			OP; \
+			memcpy(dst + x, &d, sizeof d); \
+		} \
+		for (; x < w; x++) { \
+			uae_u8 s = src[x], d = dst[x]; \
+			(void)s; \
+			OP; \
+			dst[x] = d; \
+		} \
+	} \
+}
+
+P96_VECTOR_BLIT(BLIT_NOR_VEC, d = ~(s | d))
+P96_VECTOR_BLIT(BLIT_ONLYDST_VEC, d = d & ~s)
+P96_VECTOR_BLIT(BLIT_NOTSRC_VEC, d = ~s)
+P96_VECTOR_BLIT(BLIT_ONLYSRC_VEC, d = s & ~d)
+P96_VECTOR_BLIT(BLIT_NOTDST_VEC, d = ~d)
+P96_VECTOR_BLIT(BLIT_EOR_VEC, d = s ^ d)
+P96_VECTOR_BLIT(BLIT_NAND_VEC, d = ~(s & d))
+P96_VECTOR_BLIT(BLIT_AND_VEC, d = s & d)
+P96_VECTOR_BLIT(BLIT_NEOR_VEC, d = ~(s ^ d))
+P96_VECTOR_BLIT(BLIT_NOTONLYSRC_VEC, d = ~s | d)
+P96_VECTOR_BLIT(BLIT_NOTONLYDST_VEC, d = ~d | s)
+P96_VECTOR_BLIT(BLIT_OR_VEC, d = s | d)
+
+static void BLIT_SWAP_VEC (unsigned long w, unsigned long h, uae_u8 *src, uae_u8 *dst, int srcpitch, int dstpitch)
+{
+	for (unsigned long y = 0; y < h; y++, src += srcpitch, dst += dstpitch) {
+		unsigned long x = 0;
+		for (; x + sizeof(p96_vec) <= w; x += sizeof(p96_vec)) {
+			p96_vec s, d;
+			memcpy(&s, src + x, sizeof s);
+			memcpy(&d, dst + x, sizeof d);
+			memcpy(dst + x, &s, sizeof s);
+			memcpy(src + x, &d, sizeof d);
+		}
+		for (; x < w; x++) {
+			uae_u8 tmp = dst[x];
+			dst[x] = src[x];
+			src[x] = tmp;
+		}
+	}
+}
+
+static bool do_blitrect_vector(uae_u8 *src, uae_u8 *dst, unsigned long w, unsigned long h, int srcpitch, int dstpitch, BLIT_OPCODE opcode)
+{
+	/* The word based functions process each row from left to right, so
+	 * with overlapping source and destination, later reads see earlier
+	 * writes. Vector results are identical unless the destination is
+	 * less than a vector ahead of the source. Swap needs disjoint areas. */
+	ptrdiff_t d0 = dst - src;
+	ptrdiff_t d1 = d0 + (ptrdiff_t)(h - 1) * (dstpitch - srcpitch);
+	ptrdiff_t dmin = d0 < d1 ? d0 : d1;
+	ptrdiff_t dmax = d0 < d1 ? d1 : d0;
+	if ((int)opcode == BLIT_SWAP) {
+		uae_u8 *src_end = src + (h - 1) * srcpitch + w;
+		uae_u8 *dst_end = dst + (h - 1) * dstpitch + w;
+		if (src < dst_end && dst < src_end)
+			return false;
+	} else if (dmax > 0 && dmin < (ptrdiff_t)sizeof(p96_vec)) {
+		return false;
+	}
+
+	switch (opcode)
+	{
+	case BLIT_FALSE:
+		for (unsigned long y = 0; y < h; y++, dst += dstpitch)
+			memset(dst, 0x00, w);
+		break;
+	case BLIT_TRUE:
+		for (unsigned long y = 0; y < h; y++, dst += dstpitch)
+			memset(dst, 0xff, w);
+		break;
+	case BLIT_NOR: BLIT_NOR_VEC (w, h, src, dst, srcpitch, dstpitch); break;
+	case BLIT_ONLYDST: BLIT_ONLYDST_VEC (w, h, src, dst, srcpitch, dstpitch); break;
+	case BLIT_NOTSRC: BLIT_NOTSRC_VEC (w, h, src, dst, srcpitch, dstpitch); break;
+	case BLIT_ONLYSRC: BLIT_ONLYSRC_VEC (w, h, src, dst, srcpitch, dstpitch); break;
+	case BLIT_NOTDST: BLIT_NOTDST_VEC (w, h, src, dst, srcpitch, dstpitch); break;
+	case BLIT_EOR: BLIT_EOR_VEC (w, h, src, dst, srcpitch, dstpitch); break;
+	case BLIT_NAND: BLIT_NAND_VEC (w, h, src, dst, srcpitch, dstpitch); break;
+	case BLIT_AND: BLIT_AND_VEC (w, h, src, dst, srcpitch, dstpitch); break;
+	case BLIT_NEOR: BLIT_NEOR_VEC (w, h, src, dst, srcpitch, dstpitch); break;
+	case BLIT_NOTONLYSRC: BLIT_NOTONLYSRC_VEC (w, h, src, dst, srcpitch, dstpitch); break;
+	case BLIT_NOTONLYDST: BLIT_NOTONLYDST_VEC (w, h, src, dst, srcpitch, dstpitch); break;
+	case BLIT_OR: BLIT_OR_VEC (w, h, src, dst, srcpitch, dstpitch); break;
+	case BLIT_SWAP: BLIT_SWAP_VEC (w, h, src, dst, srcpitch, dstpitch); break;
+	default:
+		return false;
+	}
+	return true;
+}
+
+#define P96_EXPAND(VTYPE, ETYPE, OFFSET, SEL) \
+	do { \
+		VTYPE m = (VTYPE)((((VTYPE){} + (ETYPE)data) & SEL) != 0); \
+		VTYPE d; \
+		memcpy(&d, mem + (OFFSET), sizeof d); \
+		if (drawmode == JAM1) \
+			d = (m & (ETYPE)fgpen) | (d & ~m); \
+		else if (drawmode == JAM2) \
+			d = (m & (ETYPE)fgpen) | (~m & (ETYPE)bgpen); \
+		else \
+			d ^= m; \
+		memcpy(mem + (OFFSET), &d, sizeof d); \
+	} while (0)
+
+/* Expand the 8 bits of data (msb first) to 8 pixels, same as the JAM1,
+ * JAM2 and COMP loops of BlitPattern and BlitTemplate with a full mask.
+ * Inversion must already be applied to data. Not used for 24-bit. */
+static void p96_expand8(uae_u8 *mem, unsigned int data, uae_u32 fgpen, uae_u32 bgpen, int drawmode, int Bpp)
+{
+	static const p96_vec sel32[2] = {
+		{ 0x80, 0x40, 0x20, 0x10 },
+		{ 0x08, 0x04, 0x02, 0x01 }
+	};
+	static const p96_vec16 sel16 = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+	static const p96_vec8x8 sel8 = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+
+	switch (Bpp)
+	{
+	case 1:
+		P96_EXPAND(p96_vec8x8, uae_u8, 0, sel8);
+		break;
+	case 2:
+		P96_EXPAND(p96_vec16, uae_u16, 0, sel16);
+		break;
+	case 4:
+		P96_EXPAND(p96_vec, uae_u32, 0, sel32[0]);
+		P96_EXPAND(p96_vec, uae_u32, 16, sel32[1]);
+		break;
+	}
+}
+
+#endif
+
 #define PARMS width, height, src, dst, ri->BytesPerRow, dstri->BytesPerRow
 
 /*
@@ -1686,6 +2195,10 @@ static int do_blitrect_frame_buffer (struct RenderInfo *ri, struct
 
 		} else {
 
+#ifdef P96_VECTOR
+			if (do_blitrect_vector(src, dst, total_width, height, ri->BytesPerRow, dstri->BytesPerRow, opcode))
+				return 1;
+#endif
 			if (Bpp == 4) {
 
 				/* 32-bit optimized */
@@ -2437,10 +2950,36 @@ static void CopyLibResolutionStructureU2A(TrapContext *ctx, struct LibResolution
 	trap_put_long(ctx, amigamemptr + PSSO_LibResolution_BoardInfo, libres->BoardInfo);
 }
 
+#ifdef FSUAE
+
+/* Write watch is emulated with page protection (see vm.cpp), and can only
+ * be used when VRAM is mapped into natmem. */
+static bool picasso_write_watch (int index)
+{
+	addrbank *ab = gfxmem_banks[index];
+	if (!natmem_offset || !ab || !ab->allocated_size || !gwwbuf[index]
+			|| gwwpagesize[index] != uae_vm_page_size())
+		return false;
+	if (ab->baseaddr != ab->start + natmem_offset)
+		return false;
+	return uae_vm_write_watch_enable (ab->start + natmem_offset, ab->allocated_size);
+}
+
+#endif
+
 void picasso_allocatewritewatch (int index, int gfxmemsize)
 {
 #ifdef FSUAE
-	/* FS-UAE does not support write watch. */
+	xfree (gwwbuf[index]);
+	gwwpagesize[index] = uae_vm_page_size ();
+	if (!natmem_offset) {
+		/* No write watch, use a large page size so full refreshes are
+		 * done with few copyrow calls. */
+		gwwpagesize[index] = 1024 * 1024 * 4;
+	}
+	gwwbufsize[index] = gfxmemsize / gwwpagesize[index] + 1;
+	gwwpagemask[index] = gwwpagesize[index] - 1;
+	gwwbuf[index] = xmalloc (void*, gwwbufsize[index]);
 #else
 	SYSTEM_INFO si;
 
@@ -2454,6 +2993,8 @@ void picasso_allocatewritewatch (int index, int gfxmemsize)
 }
 
 #ifdef FSUAE
+/* (uintptr_t) -1 means everything is dirty (no write watch) */
+static uintptr_t writewatchcount[MAX_RTG_BOARDS];
 #else
 static ULONG_PTR writewatchcount[MAX_RTG_BOARDS];
 #endif
@@ -2461,7 +3002,15 @@ static int watch_offset[MAX_RTG_BOARDS];
 void picasso_getwritewatch (int index, int offset)
 {
 #ifdef FSUAE
-	/* FS-UAE does not support write watch. */
+	watch_offset[index] = offset;
+	if (!picasso_write_watch (index)) {
+		writewatchcount[index] = (uintptr_t) -1;
+		return;
+	}
+	writewatchcount[index] = gwwbufsize[index];
+	if (!uae_vm_write_watch_get (gfxmem_banks[index]->start + natmem_offset + offset, (gwwbufsize[index] - 1) * gwwpagesize[index], gwwbuf[index], &writewatchcount[index], true)) {
+		writewatchcount[index] = (uintptr_t) -1;
+	}
 #else
 	ULONG ps;
 	writewatchcount[index] = gwwbufsize[index];
@@ -2473,19 +3022,32 @@ void picasso_getwritewatch (int index, int offset)
 	}
 #endif
 }
-bool picasso_is_vram_dirty (int index, uaecptr addr, int size)
+/* False if picasso_is_vram_dirty can not tell and reports everything as
+ * dirty. Only valid after picasso_getwritewatch. */
+bool picasso_has_write_watch (int index)
 {
 #ifdef FSUAE
-	/* FS-UAE does not support write watch. */
+	return writewatchcount[index] != (uintptr_t) -1;
+#else
 	return true;
+#endif
+}
+
+bool picasso_is_vram_dirty (int index, uaecptr addr, int size)
+{
+#ifdef FSUAE
+	if (writewatchcount[index] == (uintptr_t) -1)
+		return true;
+	static uintptr_t last;
 #else
 	static ULONG_PTR last;
+#endif
 	uae_u8 *a = addr + natmem_offset + watch_offset[index];
 	int s = size;
 	int ms = gwwpagesize[index];
 
 	for (;;) {
-		for (ULONG_PTR i = last; i < writewatchcount[index]; i++) {
+		for (uintptr_t i = last; i < writewatchcount[index]; i++) {
 			uae_u8 *ma = (uae_u8*)gwwbuf[index][i];
 			if (
 				(a < ma && a + s >= ma) ||
@@ -2500,7 +3062,6 @@ bool picasso_is_vram_dirty (int index, uaecptr addr, int size)
 		last = 0;
 	}
 	return false;
-#endif
 }
 
 static void init_alloc (TrapContext *ctx, int size)
@@ -2516,14 +3077,6 @@ static void init_alloc (TrapContext *ctx, int size)
 	picasso96_amemend = picasso96_amem + size;
 	write_log (_T("P96 RESINFO: %08X-%08X (%d,%d)\n"), picasso96_amem, picasso96_amemend, size / PSSO_ModeInfo_sizeof, size);
 	picasso_allocatewritewatch (0, gfxmem_bank.allocated_size);
-#ifdef FSUAE
-	printf("setting gwwpagesize to something...\n");
-	gwwpagesize[0] = 1024*1024*4; // FIXME:...
-
-	gwwbufsize[0] = gfxmem_bank.allocated_size / gwwpagesize[0] + 1;
-	gwwpagemask[0] = gwwpagesize[0] - 1;
-	gwwbuf[0] = xmalloc (void*, gwwbufsize[0]);
-#endif
 }
 
 static int p96depth (int depth)
@@ -3864,6 +4417,15 @@ static uae_u32 REGPARAM2 picasso_BlitPattern (TrapContext *ctx)
 					if (max > 16)
 						max = 16;
 
+#ifdef P96_VECTOR
+					if (max == 16 && Bpp != 3 && Mask == 0xFF && pattern.DrawMode <= COMP) {
+						if (inversion && pattern.DrawMode != COMP)
+							data = ~data;
+						p96_expand8(uae_mem2, (data >> 8) & 0xff, fgpen, bgpen, pattern.DrawMode, Bpp);
+						p96_expand8(uae_mem2 + Bpp * 8, data & 0xff, fgpen, bgpen, pattern.DrawMode, Bpp);
+						continue;
+					}
+#endif
 					switch (pattern.DrawMode)
 					{
 					case JAM1:
@@ -4049,6 +4611,14 @@ static uae_u32 REGPARAM2 picasso_BlitTemplate(TrapContext *ctx)
 
 					byte = data >> (8 - bitoffset);
 
+#ifdef P96_VECTOR
+					if (max == 8 && Bpp != 3 && Mask == 0xFF && tmp.DrawMode <= COMP) {
+						if (inversion && tmp.DrawMode != COMP)
+							byte = ~byte;
+						p96_expand8(uae_mem2, byte & 0xff, fgpen, bgpen, tmp.DrawMode, Bpp);
+						continue;
+					}
+#endif
 					switch (tmp.DrawMode)
 					{
 					case JAM1:
@@ -4227,6 +4797,31 @@ static void PlanarToChunky(TrapContext *ctx, struct RenderInfo *ri, struct BitMa
 			int k;
 			uae_u32 a = 0, b = 0;
 			unsigned int msk = 0xFF;
+#ifdef P96_VECTOR
+			/* 16 pixels at a time, bit k of each pixel from plane k */
+			if (!indirect && cols + 16 <= width) {
+				static const p96_vec8 sel0 = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+				static const p96_vec8 sel1 = { 0, 0, 0, 0, 0, 0, 0, 0, 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+				p96_vec8 out = {};
+				for (k = 0; k < Depth; k++) {
+					unsigned int d0, d1;
+					if (PLANAR[k] == &all_zeros_bitmap)
+						continue;
+					if (PLANAR[k] == &all_ones_bitmap) {
+						d0 = d1 = 0xFF;
+					} else {
+						d0 = (uae_u8)(do_get_mem_word ((uae_u16 *)PLANAR[k]) >> (8 - bitoffset));
+						d1 = (uae_u8)(do_get_mem_word ((uae_u16 *)(PLANAR[k] + 1)) >> (8 - bitoffset));
+						PLANAR[k] += 2;
+					}
+					p96_vec8 v = (((p96_vec8){} + (uae_u8)d0) & sel0) | (((p96_vec8){} + (uae_u8)d1) & sel1);
+					out |= (p96_vec8)(v != 0) & (uae_u8)(1 << k);
+				}
+				memcpy(image + cols, &out, sizeof out);
+				cols += 8;
+				continue;
+			}
+#endif
 			long tmp = cols + 8 - width;
 			if (tmp > 0) {
 				msk <<= tmp;
@@ -4601,6 +5196,14 @@ static void copyrow (int monid, uae_u8 *src, uae_u8 *dst, int x, int y, int widt
 		}
 	}
 
+#ifdef FSUAE
+	if (dstpix == 4) {
+		int done = rtg_convert_row(convert_mode, src2 + x * srcpix, (uae_u32*)dst2 + dx, width, vidinfo->clut, p96_rgbx16p);
+		x += done;
+		dx += done;
+	}
+#endif
+
 	endx4 = endx & ~3;
 
 	switch (convert_mode)
@@ -4915,6 +5518,16 @@ void copyrow_scale(int monid, uae_u8 *src, uae_u8 *src_screen, uae_u8 *dst,
 	ckbytes[1] = colorkey >> 8;
 	ckbytes[2] = colorkey >> 0;
 
+#ifdef FSUAE
+	/* Unscaled overlay without color key */
+	if (!ck && sxadd == 256 && dstpix == 4) {
+		x = sx >> 8;
+		int done = rtg_convert_row(convert_mode, src2 + x * srcpix, (uae_u32*)dst2 + dx, width, clut, p96_rgbx16p);
+		sx += done << 8;
+		dx += done;
+	}
+#endif
+
 	switch (convert_mode)
 	{
 		/* 24bit->32bit */
@@ -5510,6 +6123,7 @@ void freertgbuffer(int monid, uae_u8 *dst)
 void picasso_invalidate(int monid, int x, int y, int w, int h)
 {
 #ifdef FSUAE
+	uae_fsvideo_rtg_lines_updated(monid, y, h);
 #else
 	DX_Invalidate(&AMonitors[monid], x, y, w, h);
 #endif
@@ -5578,21 +6192,37 @@ void picasso_flushpixels(int index, uae_u8 *src, int off, bool render)
 			uae_u8 *ovr_start = src + (overlay_vram_offset & ~gwwpagemask[index]);
 			uae_u8 *ovr_end = src + ((overlay_vram_offset + overlay_src_width * overlay_src_height * overlay_pix + gwwpagesize[index] - 1) & ~gwwpagemask[index]);
 #ifdef FSUAE
+			if (picasso_write_watch(index))
+				uae_vm_write_watch_get(ovr_start, ovr_end - ovr_start, gwwbuf[index], &gwwcnt, true);
 #else
 			mman_GetWriteWatch(ovr_start, ovr_end - ovr_start, gwwbuf[index], &gwwcnt, &ps);
 #endif
 			overlay_updated = gwwcnt > 0;
 		}
 
+#ifdef FSUAE
+		bool watched = picasso_write_watch(index);
+#endif
 		if (vidinfo->full_refresh < 0 || overlay_updated) {
 			gwwcnt = (src_end - src_start) / gwwpagesize[index] + 1;
 			vidinfo->full_refresh = 1;
 			for (int i = 0; i < gwwcnt; i++)
 				gwwbuf[index][i] = src_start + i * gwwpagesize[index];
+#ifdef FSUAE
+			if (watched)
+				uae_vm_write_watch_reset(src_start, src_end - src_start);
+		} else if (!watched) {
+			/* No write watch, everything is assumed to be dirty */
+			gwwcnt = (src_end - src_start) / gwwpagesize[index] + 1;
+			for (int i = 0; i < gwwcnt; i++)
+				gwwbuf[index][i] = src_start + i * gwwpagesize[index];
+#endif
 		} else {
 			ULONG ps;
 			gwwcnt = gwwbufsize[index];
 #ifdef FSUAE
+			if (!uae_vm_write_watch_get(src_start, src_end - src_start, gwwbuf[index], &gwwcnt, true))
+				break;
 #else
 			if (mman_GetWriteWatch(src_start, src_end - src_start, gwwbuf[index], &gwwcnt, &ps))
 				break;
@@ -5635,6 +6265,9 @@ void picasso_flushpixels(int index, uae_u8 *src, int off, bool render)
 			miny = 0;
 			maxy = pheight;
 			flushlines = -1;
+#ifdef FSUAE
+			picasso_invalidate(monid, 0, 0, pwidth, pheight);
+#endif
 			break;
 		}
 
@@ -5659,6 +6292,9 @@ void picasso_flushpixels(int index, uae_u8 *src, int off, bool render)
 							state->BytesPerRow, state->BytesPerPixel,
 							x, y, vidinfo->rowbytes, vidinfo->pixbytes,
 							state->RGBFormat == vidinfo->host_mode, vidinfo->picasso_convert, p96_rgbx16);
+#ifdef FSUAE
+						picasso_invalidate(monid, x, y, pwidth - x, 1);
+#endif
 						flushlines++;
 					}
 					w = (gwwpagesize[index] - (state->BytesPerRow - x * state->BytesPerPixel)) / state->BytesPerPixel;
@@ -5671,6 +6307,9 @@ void picasso_flushpixels(int index, uae_u8 *src, int off, bool render)
 							state->BytesPerRow, state->BytesPerPixel,
 							0, y, vidinfo->rowbytes, vidinfo->pixbytes,
 							state->RGBFormat == vidinfo->host_mode, vidinfo->picasso_convert, p96_rgbx16);
+#ifdef FSUAE
+						picasso_invalidate(monid, 0, y, maxw, 1);
+#endif
 						w -= maxw;
 						y++;
 						flushlines++;
@@ -5714,7 +6353,12 @@ void picasso_flushpixels(int index, uae_u8 *src, int off, bool render)
 		if (doskip () && p96skipmode == 4) {
 			;
 		} else {
+#ifdef FSUAE
+			/* Updated lines have been invalidated one by one, lines
+			 * between them may not have been copied. */
+#else
 			picasso_invalidate(monid, 0, miny, pwidth, maxy - miny);
+#endif
 		}
 	}
 
@@ -42,13 +42,8 @@ static void NOINLINE BLT_NAME (unsigned int w, unsigned int h, uae_u8 *src, uae_
 	uae_u32 *dst2_32 = (uae_u32*)dst;
 	unsigned int y, x, ww, xxd;
 #ifdef BLT_TEMP
-#if BLT_SIZE == 4
+	/* Also used for the 32-bit words of 8-bit and 16-bit blits */
 	uae_u32 tmp;
-#elif BLT_SIZE == 2
-	uae_u16 tmp;
-#else
-	uae_u8 tmp;
-#endif
 #endif
 
 	if (w < 8 * BLT_MULT) {
@@ -272,6 +272,61 @@ static void cirrus_bitblt_fill_nop(CirrusVGAState *s,
 {
 }
 
+#ifdef __GNUC__
+/* Copy, transparent copy, fill and pattern fill process 16 bytes at a
+ * time with GCC vector extensions (SSE2 / NEON). The scalar loops are
+ * still used for the remaining bytes of each line and whenever the
+ * result could differ from them. */
+#define CIRRUS_VECTOR
+
+typedef uint32_t cirrus_vec __attribute__ ((vector_size (16)));
+typedef uint16_t cirrus_vec16 __attribute__ ((vector_size (16)));
+typedef uint8_t cirrus_vec8 __attribute__ ((vector_size (16)));
+
+#define CIRRUS_VEC_BYTES 16
+/* multiple of 16 and of the 8 pixel pattern line at every depth */
+#define CIRRUS_VEC_PATTERN 96
+
+STATIC_INLINE cirrus_vec cirrus_vec_load(const uint8_t *p)
+{
+	cirrus_vec v;
+	memcpy(&v, p, sizeof v);
+	return v;
+}
+
+STATIC_INLINE void cirrus_vec_store(uint8_t *p, cirrus_vec v)
+{
+	memcpy(p, &v, sizeof v);
+}
+
+/* The scalar forward (backward) ROPs read source bytes that an earlier
+ * step of the same line has already written when the destination is
+ * 1-15 bytes after (before) the source. A vector step would not see
+ * those writes. */
+STATIC_INLINE bool cirrus_vec_overlap(const uint8_t *dst, const uint8_t *src, int dir)
+{
+	intptr_t diff = (intptr_t)dst - (intptr_t)src;
+	if (dir < 0)
+		diff = -diff;
+	return diff > 0 && diff < CIRRUS_VEC_BYTES;
+}
+
+/* true if the 8 pattern lines at src are (partly) inside the blit
+ * destination, the scalar pattern fill would then read modified data. */
+STATIC_INLINE bool cirrus_vec_pattern_overlap(const uint8_t *dst, int dstpitch,
+	int bltwidth, int bltheight, const uint8_t *src, int pattern_bytes)
+{
+	intptr_t lo = (intptr_t)dst, hi = (intptr_t)dst + (intptr_t)dstpitch * (bltheight - 1);
+	if (hi < lo) {
+		intptr_t t = lo;
+		lo = hi;
+		hi = t;
+	}
+	hi += bltwidth;
+	return (intptr_t)src < hi && (intptr_t)src + pattern_bytes > lo;
+}
+#endif
+
 
 #define ROP_NAME 0
 #define ROP_FN(d, s) 0
@@ -598,18 +653,21 @@ static void cirrus_invalidate_region(CirrusVGAState * s, int off_begin,
 				     int off_pitch, int bytesperline,
 				     int lines)
 {
-#if 0
-	int y;
+    int y;
     int off_cur;
-    int off_cur_end;
+    int off_end = s->cirrus_addr_mask + 1;
 
     for (y = 0; y < lines; y++) {
-	off_cur = off_begin;
-	off_cur_end = (off_cur + bytesperline) & s->cirrus_addr_mask;
-        memory_region_set_dirty(&s->vga.vram, off_cur, off_cur_end - off_cur);
-	off_begin += off_pitch;
+        off_cur = off_begin & s->cirrus_addr_mask;
+        if (off_cur + bytesperline > off_end) {
+            /* the blit wraps around the end of VRAM */
+            linear_memory_region_set_dirty(&s->vga.vram, off_cur, off_end - off_cur);
+            linear_memory_region_set_dirty(&s->vga.vram, 0, off_cur + bytesperline - off_end);
+        } else {
+            linear_memory_region_set_dirty(&s->vga.vram, off_cur, bytesperline);
+        }
+        off_begin += off_pitch;
     }
-#endif
 }
 
 static int cirrus_bitblt_common_patterncopy(CirrusVGAState * s,
@@ -37,6 +37,34 @@ STATIC_INLINE void glue(rop_32_,ROP_NAME)(uint32_t *dst, uint32_t src)
     *dst = ROP_FN(*dst, src);
 }
 
+#ifdef CIRRUS_VECTOR
+STATIC_INLINE cirrus_vec glue(rop_vec_,ROP_NAME)(cirrus_vec dst, cirrus_vec src)
+{
+    const cirrus_vec zero = { 0 };
+    return zero | (ROP_FN(dst, src));
+}
+
+STATIC_INLINE void glue(rop_transp_8_vec_,ROP_NAME)(uint8_t *dst, cirrus_vec src, cirrus_vec8 key)
+{
+    cirrus_vec8 d = (cirrus_vec8)cirrus_vec_load(dst);
+    cirrus_vec8 p = (cirrus_vec8)glue(rop_vec_,ROP_NAME)((cirrus_vec)d, src);
+    cirrus_vec8 m = (cirrus_vec8)(p != key);
+    cirrus_vec_store(dst, (cirrus_vec)((p & m) | (d & ~m)));
+}
+
+STATIC_INLINE void glue(rop_transp_16_vec_,ROP_NAME)(uint8_t *dst, cirrus_vec src, cirrus_vec16 key)
+{
+    cirrus_vec16 d = (cirrus_vec16)cirrus_vec_load(dst);
+    cirrus_vec16 p = (cirrus_vec16)glue(rop_vec_,ROP_NAME)((cirrus_vec)d, src);
+    cirrus_vec16 m = (cirrus_vec16)(p != key);
+    cirrus_vec_store(dst, (cirrus_vec)((p & m) | (d & ~m)));
+}
+
+#define ROP_OP_VEC(d, s) cirrus_vec_store(d, glue(rop_vec_,ROP_NAME)(cirrus_vec_load(d), s))
+#define ROP_OP_TRANSP_8_VEC(d, s, k) glue(rop_transp_8_vec_,ROP_NAME)(d, s, k)
+#define ROP_OP_TRANSP_16_VEC(d, s, k) glue(rop_transp_16_vec_,ROP_NAME)(d, s, k)
+#endif
+
 #define ROP_OP(d, s) glue(rop_8_,ROP_NAME)(d, s)
 #define ROP_OP_16(d, s) glue(rop_16_,ROP_NAME)(d, s)
 #define ROP_OP_32(d, s) glue(rop_32_,ROP_NAME)(d, s)
@@ -57,7 +85,17 @@ glue(cirrus_bitblt_rop_fwd_, ROP_NAME)(CirrusVGAState *s,
     srcpitch -= bltwidth;
 
     for (y = 0; y < bltheight; y++) {
-  		for (x = 0; x < (bltwidth & ~3); x += 4) {
+		x = 0;
+#ifdef CIRRUS_VECTOR
+		if (!cirrus_vec_overlap(dst, src, 1)) {
+			for (; x + CIRRUS_VEC_BYTES <= bltwidth; x += CIRRUS_VEC_BYTES) {
+				ROP_OP_VEC(dst, cirrus_vec_load(src));
+				dst += CIRRUS_VEC_BYTES;
+				src += CIRRUS_VEC_BYTES;
+			}
+		}
+#endif
+  		for (; x < (bltwidth & ~3); x += 4) {
 			ROP_OP_32((uint32_t*)dst, *((uint32_t*)src));
 			dst += 4;
 			src += 4;
@@ -87,7 +125,19 @@ glue(cirrus_bitblt_rop_bkwd_, ROP_NAME)(CirrusVGAState *s,
     srcpitch += bltwidth;
 
 	for (y = 0; y < bltheight; y++) {
-  		for (x = 0; x < (bltwidth & ~3); x += 4) {
+		x = 0;
+#ifdef CIRRUS_VECTOR
+		if (!cirrus_vec_overlap(dst, src, -1)) {
+			for (; x + CIRRUS_VEC_BYTES <= bltwidth; x += CIRRUS_VEC_BYTES) {
+				dst -= CIRRUS_VEC_BYTES - 1;
+				src -= CIRRUS_VEC_BYTES - 1;
+				ROP_OP_VEC(dst, cirrus_vec_load(src));
+				dst -= 1;
+				src -= 1;
+			}
+		}
+#endif
+  		for (; x < (bltwidth & ~3); x += 4) {
 			dst -= 3;
 			src -= 3;
 			ROP_OP_32((uint32_t*)dst, *((uint32_t*)src));
@@ -115,12 +165,26 @@ glue(glue(cirrus_bitblt_rop_fwd_transp_, ROP_NAME),_8)(CirrusVGAState *s,
 
 	int x,y;
     uint8_t p;
+#ifdef CIRRUS_VECTOR
+    cirrus_vec8 key;
+    memset(&key, s->vga.gr[0x34], sizeof key);
+#endif
 
 	dstpitch -= bltwidth;
     srcpitch -= bltwidth;
     
 	for (y = 0; y < bltheight; y++) {
-        for (x = 0; x < bltwidth; x++) {
+		x = 0;
+#ifdef CIRRUS_VECTOR
+		if (!cirrus_vec_overlap(dst, src, 1)) {
+			for (; x + CIRRUS_VEC_BYTES <= bltwidth; x += CIRRUS_VEC_BYTES) {
+				ROP_OP_TRANSP_8_VEC(dst, cirrus_vec_load(src), key);
+				dst += CIRRUS_VEC_BYTES;
+				src += CIRRUS_VEC_BYTES;
+			}
+		}
+#endif
+        for (; x < bltwidth; x++) {
 	    p = *dst;
             ROP_OP(&p, *src);
 	    if (p != s->vga.gr[0x34]) *dst = p;
@@ -143,12 +207,28 @@ glue(glue(cirrus_bitblt_rop_bkwd_transp_, ROP_NAME),_8)(CirrusVGAState *s,
 	
 	int x,y;
     uint8_t p;
+#ifdef CIRRUS_VECTOR
+    cirrus_vec8 key;
+    memset(&key, s->vga.gr[0x34], sizeof key);
+#endif
 
 	dstpitch += bltwidth;
     srcpitch += bltwidth;
     
 	for (y = 0; y < bltheight; y++) {
-        for (x = 0; x < bltwidth; x++) {
+		x = 0;
+#ifdef CIRRUS_VECTOR
+		if (!cirrus_vec_overlap(dst, src, -1)) {
+			for (; x + CIRRUS_VEC_BYTES <= bltwidth; x += CIRRUS_VEC_BYTES) {
+				dst -= CIRRUS_VEC_BYTES - 1;
+				src -= CIRRUS_VEC_BYTES - 1;
+				ROP_OP_TRANSP_8_VEC(dst, cirrus_vec_load(src), key);
+				dst -= 1;
+				src -= 1;
+			}
+		}
+#endif
+        for (; x < bltwidth; x++) {
 	    p = *dst;
             ROP_OP(&p, *src);
 	    if (p != s->vga.gr[0x34]) *dst = p;
@@ -171,12 +251,31 @@ glue(glue(cirrus_bitblt_rop_fwd_transp_, ROP_NAME),_16)(CirrusVGAState *s,
 		
 	int x,y;
     uint8_t p1, p2;
+#ifdef CIRRUS_VECTOR
+    cirrus_vec16 key;
+    uint8_t k[CIRRUS_VEC_BYTES];
+    for (x = 0; x < CIRRUS_VEC_BYTES; x += 2) {
+        k[x] = s->vga.gr[0x34];
+        k[x + 1] = s->vga.gr[0x35];
+    }
+    memcpy(&key, k, sizeof key);
+#endif
     
 	dstpitch -= bltwidth;
     srcpitch -= bltwidth;
 
 	for (y = 0; y < bltheight; y++) {
-        for (x = 0; x < bltwidth; x+=2) {
+		x = 0;
+#ifdef CIRRUS_VECTOR
+		if (!cirrus_vec_overlap(dst, src, 1)) {
+			for (; x + CIRRUS_VEC_BYTES <= bltwidth; x += CIRRUS_VEC_BYTES) {
+				ROP_OP_TRANSP_16_VEC(dst, cirrus_vec_load(src), key);
+				dst += CIRRUS_VEC_BYTES;
+				src += CIRRUS_VEC_BYTES;
+			}
+		}
+#endif
+        for (; x < bltwidth; x+=2) {
 	    p1 = *dst;
 	    p2 = *(dst+1);
             ROP_OP(&p1, *src);
@@ -204,12 +303,33 @@ glue(glue(cirrus_bitblt_rop_bkwd_transp_, ROP_NAME),_16)(CirrusVGAState *s,
 
 	int x,y;
     uint8_t p1, p2;
+#ifdef CIRRUS_VECTOR
+    cirrus_vec16 key;
+    uint8_t k[CIRRUS_VEC_BYTES];
+    for (x = 0; x < CIRRUS_VEC_BYTES; x += 2) {
+        k[x] = s->vga.gr[0x34];
+        k[x + 1] = s->vga.gr[0x35];
+    }
+    memcpy(&key, k, sizeof key);
+#endif
     
 	dstpitch += bltwidth;
     srcpitch += bltwidth;
     
 	for (y = 0; y < bltheight; y++) {
-        for (x = 0; x < bltwidth; x+=2) {
+		x = 0;
+#ifdef CIRRUS_VECTOR
+		if (!cirrus_vec_overlap(dst, src, -1)) {
+			for (; x + CIRRUS_VEC_BYTES <= bltwidth; x += CIRRUS_VEC_BYTES) {
+				dst -= CIRRUS_VEC_BYTES - 1;
+				src -= CIRRUS_VEC_BYTES - 1;
+				ROP_OP_TRANSP_16_VEC(dst, cirrus_vec_load(src), key);
+				dst -= 1;
+				src -= 1;
+			}
+		}
+#endif
+        for (; x < bltwidth; x+=2) {
 	    p1 = *(dst-1);
 	    p2 = *dst;
             ROP_OP(&p1, *(src - 1));
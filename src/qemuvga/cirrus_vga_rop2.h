@@ -24,14 +24,35 @@
 
 #if DEPTH == 8
 #define PUTPIXEL()    ROP_OP(&d[0], col)
+#define STOREPIXEL(p) (p)[0] = col
+#define PATTERNPIXEL() \
+            col = src1[pattern_x]; \
+            pattern_x = (pattern_x + 1) & 7
 #elif DEPTH == 16
 #define PUTPIXEL()    ROP_OP_16((uint16_t *)&d[0], col)
+#define STOREPIXEL(p) *(uint16_t *)(p) = col
+#define PATTERNPIXEL() \
+            col = ((uint16_t *)(src1 + pattern_x))[0]; \
+            pattern_x = (pattern_x + 2) & 15
 #elif DEPTH == 24
 #define PUTPIXEL()    ROP_OP(&d[0], col);        \
                       ROP_OP(&d[1], (col >> 8)); \
                       ROP_OP(&d[2], (col >> 16))
+#define STOREPIXEL(p) (p)[0] = col; \
+                      (p)[1] = col >> 8; \
+                      (p)[2] = col >> 16
+#define PATTERNPIXEL() \
+            { \
+                const uint8_t *src2 = src1 + pattern_x * 3; \
+                col = src2[0] | (src2[1] << 8) | (src2[2] << 16); \
+                pattern_x = (pattern_x + 1) & 7; \
+            }
 #elif DEPTH == 32
 #define PUTPIXEL()    ROP_OP_32(((uint32_t *)&d[0]), col)
+#define STOREPIXEL(p) *(uint32_t *)(p) = col
+#define PATTERNPIXEL() \
+            col = ((uint32_t *)(src1 + pattern_x))[0]; \
+            pattern_x = (pattern_x + 4) & 31
 #else
 #error unsupported DEPTH
 #endif
@@ -63,29 +84,52 @@ glue(glue(glue(cirrus_patternfill_, ROP_NAME), _),DEPTH)
     pattern_pitch = 16;
 #else
     pattern_pitch = 32;
+#endif
+#ifdef CIRRUS_VECTOR
+    /* 8 pattern lines expanded to CIRRUS_VEC_PATTERN bytes starting at
+     * skipleft. The 24-bit pattern index is not wrapped for the first
+     * pixel, the expanded lines would not repeat if skipleft >= 8. */
+    uint8_t patternbuf[8][CIRRUS_VEC_PATTERN];
+    bool use_vector = bltwidth - skipleft >= 3 * CIRRUS_VEC_BYTES &&
+        (DEPTH != 24 || skipleft < 8) &&
+        !cirrus_vec_pattern_overlap(dst, dstpitch, bltwidth, bltheight, src, 8 * pattern_pitch);
+    if (use_vector) {
+        for (y = 0; y < 8; y++) {
+            pattern_x = skipleft;
+            src1 = src + y * pattern_pitch;
+            for (x = 0; x < CIRRUS_VEC_PATTERN; x += (DEPTH / 8)) {
+                PATTERNPIXEL();
+                STOREPIXEL(&patternbuf[y][x]);
+            }
+        }
+    }
 #endif
     pattern_y = s->cirrus_blt_srcaddr & 7;
     for(y = 0; y < bltheight; y++) {
         pattern_x = skipleft;
         d = dst + skipleft;
         src1 = src + pattern_y * pattern_pitch;
-        for (x = skipleft; x < bltwidth; x += (DEPTH / 8)) {
-#if DEPTH == 8
-            col = src1[pattern_x];
-            pattern_x = (pattern_x + 1) & 7;
-#elif DEPTH == 16
-            col = ((uint16_t *)(src1 + pattern_x))[0];
-            pattern_x = (pattern_x + 2) & 15;
-#elif DEPTH == 24
-            {
-                const uint8_t *src2 = src1 + pattern_x * 3;
-                col = src2[0] | (src2[1] << 8) | (src2[2] << 16);
-                pattern_x = (pattern_x + 1) & 7;
+        x = skipleft;
+#ifdef CIRRUS_VECTOR
+        if (use_vector) {
+            const uint8_t *p = patternbuf[pattern_y];
+            int i = 0;
+            for (; x + 3 * CIRRUS_VEC_BYTES <= bltwidth; x += 3 * CIRRUS_VEC_BYTES) {
+                ROP_OP_VEC(d, cirrus_vec_load(p + i));
+                ROP_OP_VEC(d + CIRRUS_VEC_BYTES, cirrus_vec_load(p + i + CIRRUS_VEC_BYTES));
+                ROP_OP_VEC(d + 2 * CIRRUS_VEC_BYTES, cirrus_vec_load(p + i + 2 * CIRRUS_VEC_BYTES));
+                d += 3 * CIRRUS_VEC_BYTES;
+                i = (i + 3 * CIRRUS_VEC_BYTES) % CIRRUS_VEC_PATTERN;
             }
+#if DEPTH == 24
+            pattern_x = (skipleft + (x - skipleft) / 3) & 7;
 #else
-            col = ((uint32_t *)(src1 + pattern_x))[0];
-            pattern_x = (pattern_x + 4) & 31;
+            pattern_x = x & (pattern_pitch - 1);
 #endif
+        }
+#endif
+        for (; x < bltwidth; x += (DEPTH / 8)) {
+            PATTERNPIXEL();
             PUTPIXEL();
             d += (DEPTH / 8);
         }
@@ -292,10 +336,31 @@ glue(glue(glue(cirrus_fill_, ROP_NAME), _),DEPTH)
 	
 	col = s->cirrus_blt_fgcol;
 
+#ifdef CIRRUS_VECTOR
+    /* 48 bytes hold a whole number of pixels at every depth */
+    uint8_t colbuf[3 * CIRRUS_VEC_BYTES];
+    cirrus_vec colvec[3];
+    for (x = 0; x < 3 * CIRRUS_VEC_BYTES; x += (DEPTH / 8)) {
+        STOREPIXEL(&colbuf[x]);
+    }
+    for (x = 0; x < 3; x++) {
+        colvec[x] = cirrus_vec_load(colbuf + x * CIRRUS_VEC_BYTES);
+    }
+#endif
+
     d1 = dst;
     for(y = 0; y < bltheight; y++) {
         d = d1;
-        for(x = 0; x < bltwidth; x += (DEPTH / 8)) {
+        x = 0;
+#ifdef CIRRUS_VECTOR
+        for (; x + 3 * CIRRUS_VEC_BYTES <= bltwidth; x += 3 * CIRRUS_VEC_BYTES) {
+            ROP_OP_VEC(d, colvec[0]);
+            ROP_OP_VEC(d + CIRRUS_VEC_BYTES, colvec[1]);
+            ROP_OP_VEC(d + 2 * CIRRUS_VEC_BYTES, colvec[2]);
+            d += 3 * CIRRUS_VEC_BYTES;
+        }
+#endif
+        for(; x < bltwidth; x += (DEPTH / 8)) {
             PUTPIXEL();
             d += (DEPTH / 8);
         }
@@ -305,3 +370,5 @@ glue(glue(glue(cirrus_fill_, ROP_NAME), _),DEPTH)
 
 #undef DEPTH
 #undef PUTPIXEL
+#undef STOREPIXEL
+#undef PATTERNPIXEL
@@ -14,6 +14,10 @@
 #include "zfile.h"
 #include "videograb.h"
 #include "arcadia.h"
+#include "threaddep/thread.h"
+#ifdef FSUAE
+#include "uae/glib.h"
+#endif
 
 #define VIDEOGRAB 1
 
@@ -329,6 +333,203 @@ static void blank_generic(struct vidbuffer *src, struct vidbuffer *dst, int oddl
 	}
 }
 
+/* Band worker pool.
+ *
+ * Converters whose lines can be drawn independently of each other split
+ * the visible lines into horizontal bands. Band 0 is converted by the calling
+ * thread, the others by worker threads. Converters are only called from
+ * the drawing code, so a single pool is enough.
+ */
+
+#define SM_MAX_BANDS 4
+
+typedef void (*sm_band_func)(void *data, int band, int first, int last, bool doublelines);
+
+static int sm_bands;
+static uae_sem_t sm_band_start[SM_MAX_BANDS], sm_band_done;
+static uae_thread_id sm_band_tid[SM_MAX_BANDS];
+static volatile bool sm_band_quit;
+static sm_band_func sm_band_job;
+static void *sm_band_data;
+static bool sm_band_doublelines, sm_band_overlap;
+static int sm_band_count;
+static int sm_band_first[SM_MAX_BANDS + 1];
+
+static void sm_band_run(int band)
+{
+	int first = sm_band_first[band];
+	int last = sm_band_first[band + 1];
+
+	if (sm_band_overlap && band < sm_band_count - 1) {
+		// doubled row of the last line belongs to the next band
+		sm_band_job(sm_band_data, band, first, last - 1, sm_band_doublelines);
+		sm_band_job(sm_band_data, band, last - 1, last, false);
+	} else {
+		sm_band_job(sm_band_data, band, first, last, sm_band_doublelines);
+	}
+}
+
+static void *sm_band_thread(void *arg)
+{
+	int band = (int)(uintptr_t)arg;
+
+	for (;;) {
+		uae_sem_wait(&sm_band_start[band]);
+		if (sm_band_quit)
+			break;
+		sm_band_run(band);
+		uae_sem_post(&sm_band_done);
+	}
+	return NULL;
+}
+
+static int sm_init_bands(void)
+{
+	int cpus = 1;
+
+	if (sm_bands)
+		return sm_bands;
+	sm_bands = 1;
+#ifdef FSUAE
+	cpus = g_get_num_processors();
+#endif
+	if (cpus > SM_MAX_BANDS)
+		cpus = SM_MAX_BANDS;
+	if (cpus > 1)
+		uae_sem_init(&sm_band_done, 0, 0);
+	sm_band_quit = false;
+	for (int i = 1; i < cpus; i++) {
+		uae_sem_init(&sm_band_start[i], 0, 0);
+		if (!uae_start_thread(_T("specialmonitor"), sm_band_thread, (void*)(uintptr_t)i, &sm_band_tid[i])) {
+			uae_sem_destroy(&sm_band_start[i]);
+			break;
+		}
+		sm_bands = i + 1;
+	}
+	write_log(_T("Special monitor emulation uses %d band(s)\n"), sm_bands);
+	return sm_bands;
+}
+
+/* Stops the band workers, they are started again when needed. No bands
+ * are being converted when this is called, sm_run_bands waits for them. */
+static void sm_free_bands(void)
+{
+	if (!sm_bands)
+		return;
+	sm_band_quit = true;
+	for (int i = 1; i < sm_bands; i++) {
+		uae_sem_post(&sm_band_start[i]);
+		uae_wait_thread(sm_band_tid[i]);
+		uae_end_thread(&sm_band_tid[i]);
+		uae_sem_destroy(&sm_band_start[i]);
+	}
+	uae_sem_destroy(&sm_band_done);
+	sm_bands = 0;
+}
+
+/* Call func for lines first to last - 1. If parallel is set, the lines
+ * are split into bands that are converted at the same time. overlap must
+ * be set if a doubled line also writes the destination row of the next
+ * line. The last line of each band is then converted without line
+ * doubling and once all bands are done, the lines around each band
+ * boundary are converted again in order, so that the shared row ends up
+ * as if all lines had been converted in order.
+ */
+static void sm_run_bands(sm_band_func func, void *data, int first, int last, bool doublelines, bool parallel, bool overlap)
+{
+	int bands = parallel ? sm_init_bands() : 1;
+
+	if (bands > (last - first) / 2)
+		bands = (last - first) / 2;
+	if (bands <= 1) {
+		if (last > first)
+			func(data, 0, first, last, doublelines);
+		return;
+	}
+	sm_band_job = func;
+	sm_band_data = data;
+	sm_band_doublelines = doublelines;
+	sm_band_overlap = overlap && doublelines;
+	sm_band_count = bands;
+	for (int i = 0; i < bands; i++)
+		sm_band_first[i] = first + (last - first) * i / bands;
+	sm_band_first[bands] = last;
+	for (int i = 1; i < bands; i++)
+		uae_sem_post(&sm_band_start[i]);
+	sm_band_run(0);
+	for (int i = 1; i < bands; i++)
+		uae_sem_wait(&sm_band_done);
+	if (sm_band_overlap) {
+		for (int i = 1; i < bands; i++) {
+			int y = sm_band_first[i];
+			func(data, 0, y - 1, y, true);
+			func(data, 0, y, y + 1, false);
+		}
+	}
+}
+
+/* Lines ystart to yend - 1 that have source data. yoff grows with y, so
+ * the lines that pass the usual yoff range check are contiguous. */
+static bool sm_visible_lines(struct vidbuffer *src, int oddlines, int vdbl, int *ystart, int *yend)
+{
+	int first = -1, last = -1;
+
+	for (int y = *ystart; y < *yend; y++) {
+		int yoff = (((y * 2 + oddlines) - src->yoffset) / vdbl);
+		if (yoff < 0 || yoff >= src->inheight)
+			continue;
+		if (first < 0)
+			first = y;
+		last = y + 1;
+	}
+	if (first < 0)
+		return false;
+	*ystart = first;
+	*yend = last;
+	return true;
+}
+
+#if defined(__GNUC__) && !defined(WORDS_BIGENDIAN) && (defined(__clang__) || __GNUC__ >= 9)
+#define SM_VECTOR 1
+typedef uae_u32 sm_vec __attribute__((vector_size(16)));
+typedef uae_u32 sm_vec16 __attribute__((vector_size(64)));
+typedef uae_u8 sm_vec16b __attribute__((vector_size(16)));
+#endif
+
+/* FIRGB() of each pixel of a line, out[x] is the value the converters
+ * read at step x. */
+static void sm_firgb_line(struct vidbuffer *src, uae_u8 *line, uae_u8 *out, int width, int hdbl)
+{
+	int x = 0;
+
+#ifdef SM_VECTOR
+	if (src->pixbytes == 4 && hdbl == 2) {
+		for (; x + 16 <= width; x += 16) {
+			sm_vec16 v;
+			memcpy(&v, line + x * 4, sizeof v);
+			v = ((v >> 4) & 1) | ((v >> 6) & 2) | ((v >> 13) & 4) | ((v >> 20) & 8);
+			sm_vec16b b = __builtin_convertvector(v, sm_vec16b);
+			memcpy(out + x, &b, sizeof b);
+		}
+	}
+#endif
+	for (; x < width; x++)
+		out[x] = FIRGB(src, line + ((x << 1) / hdbl) * src->pixbytes);
+}
+
+static uae_u8 *sm_line_bits;
+static int sm_line_bits_size;
+
+static uae_u8 *sm_get_line_bits(int size)
+{
+	if (size > sm_line_bits_size) {
+		xfree(sm_line_bits);
+		sm_line_bits = xmalloc(uae_u8, size);
+		sm_line_bits_size = size;
+	}
+	return sm_line_bits;
+}
+
 static const uae_u8 dctv_signature[] = {
 	0x93,0x0e,0x51,0xbc,0x22,0x17,0xdf,0xa4,0x19,0x1d,0x16,0x6a,0xb6,0xeb,0xd9,0x70,
 	0x52,0xd6,0x07,0xf2,0x57,0x68,0x69,0xdc,0xce,0x3c,0xf8,0x9e,0xa6,0xc6,0x2a
@@ -507,7 +708,18 @@ static const uae_u16 dctv_tables[] = {
 
 #define DCTV_BUFFER_SIZE 1000
 static uae_s8 dctv_chroma[2 * DCTV_BUFFER_SIZE];
-static uae_u8 dctv_luma[2 * DCTV_BUFFER_SIZE];
+/* Chroma of the previous line as it was when each line was decoded */
+static uae_s8 *dctv_chroma_lines;
+/* Per band chroma and luma line buffers, luma has two guard bytes in front */
+static uae_s8 dctv_band_chroma[SM_MAX_BANDS][DCTV_BUFFER_SIZE];
+static uae_u8 dctv_band_luma[SM_MAX_BANDS][DCTV_BUFFER_SIZE + 2];
+static int dctv_ycnt[MAXVPOS_PAL], dctv_decode[MAXVPOS_PAL];
+
+/* FIRGB() bit order to DCTV_FIRBG() bit order */
+static const uae_u8 dctv_firbg[16] = {
+	0x00, 0x40, 0x04, 0x44, 0x01, 0x41, 0x05, 0x45,
+	0x10, 0x50, 0x14, 0x54, 0x11, 0x51, 0x15, 0x55
+};
 
 
 STATIC_INLINE int minmax(int v, int min, int max)
@@ -524,12 +736,157 @@ STATIC_INLINE int minmax(int v, int min, int max)
 static int signature_test_y = 0x93;
 #endif
 
+struct dctv_frame
+{
+	struct vidbuffer *src, *dst;
+	int oddlines, vdbl, hdbl;
+	int ystart;
+	uae_u8 *bits;
+};
+
+/* Decode pixels 0 to decode - 1 of a line and copy the rest. Without
+ * lumabuf only the chroma of the line is written to chrbuf_w, this is
+ * all the next line needs. */
+static void dctv_line(struct vidbuffer *src, struct vidbuffer *dst, uae_u8 *line, uae_u8 *dstline, uae_u8 *bits, int hdbl,
+	int ycnt, int decode, uae_s8 *chrbuf_w, uae_s8 *chrbuf_r2, uae_u8 *lumabuf1, bool doublelines)
+{
+	int x;
+	int firstnz = -1;
+	bool sign = false;
+	int oddeven = 0;
+	uae_u8 prev = 0;
+	uae_u8 vals[3] = { 0x40, 0x40, 0x40 };
+	int zigzagoffset = 0;
+	uae_s8 *chrbuf_r1 = chrbuf_w;
+
+	for (x = 0; x < decode; x++) {
+		uae_u8 newval = bits[x];
+		uae_u8 *d = NULL, *d2 = NULL;
+
+		if (lumabuf1) {
+			d = dstline + ((x << 1) / hdbl) * dst->pixbytes + zigzagoffset;
+			d2 = d + dst->rowbytes;
+		}
+
+		uae_u8 val = prev | newval;
+		if (firstnz < 0 && newval) {
+			firstnz = 0;
+			zigzagoffset = (ycnt & 1) ? 0 : dst->pixbytes;
+			oddeven = -1;
+			sign = false;
+		}
+
+		if (oddeven > 0 && !firstnz) {
+			sign = !sign;
+
+			if (val == 0)
+				val = 64;
+
+			vals[2] = vals[1];
+			vals[1] = vals[0];
+			vals[0] = val;
+
+			int v0 = 2 * vals[1] - vals[2] - vals[0] + 2;
+			if (v0 < 0)
+				v0 += 3;
+			v0 /= 4;
+			int v1 = -v0;
+			if (sign)
+				v0 = -v0;
+			*chrbuf_w++ = minmax(v0, -127, 127);
+
+			if (lumabuf1) {
+				*lumabuf1 = minmax(vals[2] + v1, 64, 224);
+
+				int ch1 = chrbuf_r1[0] + chrbuf_r1[-1];
+				int ch2 = chrbuf_r2[0] + chrbuf_r2[-1];
+				ch1 /= 2;
+				ch2 /= 2;
+
+				int luma = lumabuf1[-1] * 2 + lumabuf1[-2] + lumabuf1[0];
+				luma /= 4;
+
+				int l = (uae_s16)dctv_tables[luma];
+
+				int rr = (uae_s16)dctv_tables[ch1 + 0x180] + l;
+				int gg = (uae_s16)dctv_tables[ch1 + 0x380] + (uae_s16)dctv_tables[ch2 + 0x480] + l;
+				int bb = (uae_s16)dctv_tables[ch2 + 0x280] + l;
+
+				uae_u8 r = minmax(rr >> 4, 0, 255);
+				uae_u8 g = minmax(gg >> 4, 0, 255);
+				uae_u8 b = minmax(bb >> 4, 0, 255);
+
+				PRGB(dst, d - dst->pixbytes, r, g, b);
+				PRGB(dst, d, r, g, b);
+				if (doublelines) {
+					PRGB(dst, d2 - dst->pixbytes, r, g, b);
+					PRGB(dst, d2, r, g, b);
+				}
+
+				chrbuf_r1++;
+				chrbuf_r2++;
+				lumabuf1++;
+			}
+
+		} else if (oddeven < 0 && lumabuf1) {
+
+			uae_u8 r = 0, b = 0, g = 0;
+			PRGB(dst, d - dst->pixbytes, r, g, b);
+			PRGB(dst, d, r, g, b);
+			if (doublelines) {
+				PRGB(dst, d2 - dst->pixbytes, r, g, b);
+				PRGB(dst, d2, r, g, b);
+			}
+
+		}
+
+		if (oddeven >= 0)
+			oddeven = oddeven ? 0 : 1;
+		else
+			oddeven++;
+		prev = newval << 1;
+	}
+
+	if (!lumabuf1)
+		return;
+
+	for (; x < src->inwidth; x++) {
+		uae_u8 *s = line + ((x << 1) / hdbl) * src->pixbytes;
+		uae_u8 *d = dstline + ((x << 1) / hdbl) * dst->pixbytes + zigzagoffset;
+		uae_u8 *s2 = s + src->rowbytes;
+		uae_u8 *d2 = d + dst->rowbytes;
+		PUT_AMIGARGB(d, s, d2, s2, dst, 0, doublelines, false);
+	}
+}
+
+static void dctv_lines(void *data, int band, int first, int last, bool doublelines)
+{
+	struct dctv_frame *f = (struct dctv_frame*)data;
+	struct vidbuffer *src = f->src;
+	struct vidbuffer *dst = f->dst;
+
+	for (int y = first; y < last; y++) {
+		int yoff = (((y * 2 + f->oddlines) - src->yoffset) / f->vdbl);
+		uae_u8 *line = src->bufmem + yoff * src->rowbytes;
+		uae_u8 *dstline = dst->bufmem + (((y * 2 + f->oddlines) - dst->yoffset) / f->vdbl) * dst->rowbytes;
+		uae_u8 *bits = f->bits + (y - f->ystart) * src->inwidth;
+
+		dctv_line(src, dst, line, dstline, bits, f->hdbl, dctv_ycnt[y], dctv_decode[y],
+			dctv_band_chroma[band] + 8, dctv_chroma_lines + y * DCTV_BUFFER_SIZE + 8,
+			dctv_band_luma[band] + 2, doublelines);
+	}
+}
+
+/* The signature scan and the chroma of each line depend on the previous
+ * lines, so they are done first, in order. The chroma of the other field
+ * line that each line reads is saved, after that the lines are decoded in
+ * bands. */
 static bool dctv(struct vidbuffer *src, struct vidbuffer *dst, bool doublelines, int oddlines)
 {
 	struct vidbuf_description *avidinfo = &adisplays[dst->monitor_id].gfxvidinfo;
+	struct dctv_frame f;
 	int y, x, vdbl, hdbl;
 	int ystart, yend, isntsc;
-	int xadd;
 
 	isntsc = (beamcon0 & 0x20) ? 0 : 1;
 	if (!(currprefs.chipset_mask & CSMASK_ECS_AGNUS))
@@ -538,36 +895,32 @@ static bool dctv(struct vidbuffer *src, struct vidbuffer *dst, bool doublelines,
 	vdbl = avidinfo->ychange;
 	hdbl = avidinfo->xchange;
 
-	xadd = ((1 << 1) / hdbl) * src->pixbytes;
-
 	ystart = isntsc ? VBLANK_ENDLINE_NTSC : VBLANK_ENDLINE_PAL;
 	yend = isntsc ? MAXVPOS_NTSC : MAXVPOS_PAL;
 
-	int signature_detected = -1;
 	int signature_cnt = 0;
 	bool dctv_enabled = false;
 	int ycnt = 0;
-	memset(dctv_luma, 64, sizeof DCTV_BUFFER_SIZE);
+
+	if (!sm_visible_lines(src, oddlines, vdbl, &ystart, &yend))
+		return false;
+	if (!dctv_chroma_lines)
+		dctv_chroma_lines = xcalloc(uae_s8, MAXVPOS_PAL * DCTV_BUFFER_SIZE);
+
+	f.src = src;
+	f.dst = dst;
+	f.oddlines = oddlines;
+	f.vdbl = vdbl;
+	f.hdbl = hdbl;
+	f.ystart = ystart;
+	f.bits = sm_get_line_bits((yend - ystart) * src->inwidth);
 
 	for (y = ystart; y < yend; y++) {
 		int yoff = (((y * 2 + oddlines) - src->yoffset) / vdbl);
-		if (yoff < 0)
-			continue;
-		if (yoff >= src->inheight)
-			continue;
 		uae_u8 *line = src->bufmem + yoff * src->rowbytes;
-		uae_u8 *dstline = dst->bufmem + (((y * 2 + oddlines) - dst->yoffset) / vdbl) * dst->rowbytes;
+		uae_u8 *bits = f.bits + (y - ystart) * src->inwidth;
+		int decode = dctv_enabled ? src->inwidth : 0;
 
-		int firstnz = -1;
-		bool sign = false;
-		int oddeven = 0;
-		uae_u8 prev = 0;
-		uae_u8 vals[3] = { 0x40, 0x40, 0x40 };
-		int zigzagoffset = 0;
-		int prevtval = 0;
-		uae_s8 *chrbuf_w = NULL, *chrbuf_r1 = NULL, *chrbuf_r2 = NULL;
-		uae_u8 *lumabuf1 = dctv_luma, *lumabuf2 = dctv_luma;
-	
 		ycnt++;
 
 #if DCTV_SIGNATURE_DEBUG
@@ -577,12 +930,10 @@ static bool dctv(struct vidbuffer *src, struct vidbuffer *dst, bool doublelines,
 			write_log(_T("\n"));
 #endif
 
+		sm_firgb_line(src, line, bits, src->inwidth, hdbl);
 		for (x = 0; x < src->inwidth; x++) {
-			uae_u8 *s = line + ((x << 1) / hdbl) * src->pixbytes;
-			uae_u8 *d = dstline + ((x << 1) / hdbl) * dst->pixbytes + zigzagoffset;
-			uae_u8 *s2 = s + src->rowbytes;
-			uae_u8 *d2 = d + dst->rowbytes;
-			uae_u8 newval = DCTV_FIRBG(src, s);
+			uae_u8 newval = dctv_firbg[bits[x]];
+			bits[x] = newval;
 
 			int mask = 1 << (7 - (signature_cnt & 7));
 			int bitval = (newval & 0x40) ? mask : 0;
@@ -590,7 +941,8 @@ static bool dctv(struct vidbuffer *src, struct vidbuffer *dst, bool doublelines,
 				signature_cnt++;
 				if (signature_cnt == sizeof (dctv_signature) * 8) {
 					dctv_enabled = true;
-					signature_detected = y;
+					if (decode > x)
+						decode = x;
 				}
 			} else {
 				signature_cnt = 0;
@@ -612,100 +964,23 @@ static bool dctv(struct vidbuffer *src, struct vidbuffer *dst, bool doublelines,
 				}
 			}
 #endif
-			if (!dctv_enabled || signature_detected == y) {
-				PUT_AMIGARGB(d, s, d2, s2, dst, 0, doublelines, false);
-				continue;
-			}
-
-			uae_u8 val = prev | newval;
-			if (firstnz < 0 && newval) {
-				firstnz = 0;
-				if (ycnt & 1) {
-					zigzagoffset = 0;
-					oddeven = -1;
-					chrbuf_w = dctv_chroma + 8;
-					chrbuf_r1 = dctv_chroma + 8;
-					chrbuf_r2 = dctv_chroma + DCTV_BUFFER_SIZE + 8;
-				} else {
-					zigzagoffset = dst->pixbytes;
-					oddeven = -1;
-					chrbuf_w = dctv_chroma + DCTV_BUFFER_SIZE + 8;
-					chrbuf_r2 = dctv_chroma + 8;
-					chrbuf_r1 = dctv_chroma + DCTV_BUFFER_SIZE + 8;
-				}
-				sign = false;
-			}
-
-			if (oddeven > 0 && !firstnz) {
-				sign = !sign;
-
-				if (val == 0)
-					val = 64;
-
-				vals[2] = vals[1];
-				vals[1] = vals[0];
-				vals[0] = val;
-
-				int v0 = 2 * vals[1] - vals[2] - vals[0] + 2;
-				if (v0 < 0)
-					v0 += 3;
-				v0 /= 4;
-				int v1 = -v0;
-				if (sign)
-					v0 = -v0;
-				*chrbuf_w = minmax(v0, -127, 127);
-				*lumabuf1 = minmax(vals[2] + v1, 64, 224);
-
-				int ch1 = chrbuf_r1[0] + chrbuf_r1[-1];
-				int ch2 = chrbuf_r2[0] + chrbuf_r2[-1];
-				ch1 /= 2;
-				ch2 /= 2;
-
-				int luma = lumabuf1[-1] * 2 + lumabuf1[-2] + lumabuf1[0];
-				luma /= 4;
-
-				int l = (uae_s16)dctv_tables[luma];
-
-				int rr = (uae_s16)dctv_tables[ch1 + 0x180] + l;
-				int gg = (uae_s16)dctv_tables[ch1 + 0x380] + (uae_s16)dctv_tables[ch2 + 0x480] + l;
-				int bb = (uae_s16)dctv_tables[ch2 + 0x280] + l;
-
-				uae_u8 r = minmax(rr >> 4, 0, 255);
-				uae_u8 g = minmax(gg >> 4, 0, 255);
-				uae_u8 b = minmax(bb >> 4, 0, 255);
-
-				PRGB(dst, d - dst->pixbytes, r, g, b);
-				PRGB(dst, d, r, g, b);
-				if (doublelines) {
-					PRGB(dst, d2 - dst->pixbytes, r, g, b);
-					PRGB(dst, d2, r, g, b);
-				}
-
-				chrbuf_r1++;
-				chrbuf_r2++;
-				chrbuf_w++;
-				lumabuf1++;
-
-			} else if (oddeven < 0) {
-
-				uae_u8 r = 0, b = 0, g = 0;
-				PRGB(dst, d - dst->pixbytes, r, g, b);
-				PRGB(dst, d, r, g, b);
-				if (doublelines) {
-					PRGB(dst, d2 - dst->pixbytes, r, g, b);
-					PRGB(dst, d2, r, g, b);
-				}
-
-			}
+		}
 
-			if (oddeven >= 0)
-				oddeven = oddeven ? 0 : 1;
-			else
-				oddeven++;
-			prev = newval << 1;
+		dctv_ycnt[y] = ycnt;
+		dctv_decode[y] = decode;
+		if (decode > 0) {
+			uae_s8 *chrbuf_w = dctv_chroma + ((ycnt & 1) ? 0 : DCTV_BUFFER_SIZE);
+			uae_s8 *chrbuf_r2 = dctv_chroma + ((ycnt & 1) ? DCTV_BUFFER_SIZE : 0);
+			int len = 8 + decode / 2 + 1;
+			if (len > DCTV_BUFFER_SIZE)
+				len = DCTV_BUFFER_SIZE;
+			memcpy(dctv_chroma_lines + y * DCTV_BUFFER_SIZE, chrbuf_r2, len);
+			dctv_line(src, dst, line, NULL, bits, hdbl, ycnt, decode, chrbuf_w + 8, NULL, NULL, false);
 		}
 	}
 
+	sm_run_bands(dctv_lines, &f, ystart, yend, doublelines, vdbl <= 2, vdbl == 2);
+
 	if (dctv_enabled) {
 		dst->nativepositioning = true;
 		if (monitor != MONITOREMU_DCTV) {
@@ -776,11 +1051,85 @@ STATIC_INLINE uae_u8 MAKEFCOVERLAY(uae_u8 v)
 	return v;
 }
 
+struct fc24_frame
+{
+	struct vidbuffer *src, *dst;
+	int oddlines, vdbl, hdbl;
+	int ystart;
+	int xadd, fc24_dx, fc24_xadd, fc24_xoffset;
+	int bufferoffset;
+};
+
+static void firecracker24_lines(void *data, int band, int first, int last, bool doublelines)
+{
+	struct fc24_frame *f = (struct fc24_frame*)data;
+	struct vidbuffer *src = f->src;
+	struct vidbuffer *dst = f->dst;
+	int hdbl = f->hdbl;
+	int x, fc24_x;
+
+	for (int y = first; y < last; y++) {
+		int fc24_y = (y - f->ystart) * 2;
+		int yoff = (((y * 2 + f->oddlines) - src->yoffset) / f->vdbl);
+		uae_u8 *line = src->bufmem + yoff * src->rowbytes;
+		uae_u8 *line_genlock = row_map_genlock[yoff];
+		uae_u8 *dstline = dst->bufmem + (((y * 2 + f->oddlines) - dst->yoffset) / f->vdbl) * dst->rowbytes;
+		uae_u8 *vramline = sm_frame_buffer + (fc24_y + f->oddlines) * SM_VRAM_WIDTH * SM_VRAM_BYTES + f->bufferoffset;
+		fc24_x = 0;
+		for (x = 0; x < src->inwidth; x++) {
+			uae_u8 r = 0, g = 0, b = 0;
+			uae_u8 *s = line + ((x << 1) / hdbl) * src->pixbytes;
+			uae_u8 *s_genlock = line_genlock + ((x << 1) / hdbl);
+			uae_u8 *d = dstline + ((x << 1) / hdbl) * dst->pixbytes;
+			int fc24_xx = (fc24_x >> f->fc24_dx) - f->fc24_xoffset;
+			uae_u8 *vramptr = NULL;
+			if (fc24_xx >= 0 && fc24_xx < fc24_width && fc24_y >= 0 && fc24_y < FC24_MAXHEIGHT) {
+				vramptr = vramline + fc24_xx * SM_VRAM_BYTES;
+				uae_u8 ax = vramptr[0];
+				if (ax & 0x40) {
+					r = MAKEFCOVERLAY(ax >> 4);
+					g = MAKEFCOVERLAY(ax >> 2);
+					b = MAKEFCOVERLAY(ax >> 0);
+				} else {
+					r = vramptr[1];
+					g = vramptr[2];
+					b = vramptr[3];
+				}
+			}
+			if (!(fc24_cr0 & 1) && (!(fc24_cr1 & 1) || (!is_transparent(s_genlock[0])))) {
+				uae_u8 *s2 = s + src->rowbytes;
+				uae_u8 *d2 = d + dst->rowbytes;
+				PUT_AMIGARGB(d, s, d2, s2, dst, f->xadd, doublelines, false);
+			} else {
+				PUT_PRGB(d, NULL, dst, r, g, b, 0, false, false);
+				if (doublelines) {
+					if (vramptr) {
+						vramptr += SM_VRAM_WIDTH * SM_VRAM_BYTES;
+						uae_u8 ax = vramptr[0];
+						if (ax & 0x40) {
+							r = MAKEFCOVERLAY(ax >> 4);
+							g = MAKEFCOVERLAY(ax >> 2);
+							b = MAKEFCOVERLAY(ax >> 0);
+						} else {
+							r = vramptr[1];
+							g = vramptr[2];
+							b = vramptr[3];
+						}
+					}
+					PUT_PRGB(d + dst->rowbytes, NULL, dst, r, g, b, 0, false, false);
+				}
+			}
+			fc24_x += f->fc24_xadd;
+		}
+	}
+}
+
 static bool firecracker24(struct vidbuffer *src, struct vidbuffer *dst, bool doublelines, int oddlines)
 {
 	struct vidbuf_description *avidinfo = &adisplays[dst->monitor_id].gfxvidinfo;
-	int y, x, vdbl, hdbl;
-	int fc24_y, fc24_x, fc24_dx, fc24_xadd, fc24_xmult, fc24_xoffset;
+	struct fc24_frame f;
+	int vdbl, hdbl;
+	int fc24_dx, fc24_xadd, fc24_xmult, fc24_xoffset;
 	int ystart, yend, isntsc;
 	int xadd, xaddfc;
 	int bufferoffset;
@@ -834,66 +1183,19 @@ static bool firecracker24(struct vidbuffer *src, struct vidbuffer *dst, bool dou
 
 	bufferoffset = (fc24_cr0 & 2) ? 512 * SM_VRAM_BYTES: 0;
 
-	fc24_y = 0;
-	for (y = ystart; y < yend; y++) {
-		int oddeven = 0;
-		uae_u8 prev = 0;
-		int yoff = (((y * 2 + oddlines) - src->yoffset) / vdbl);
-		if (yoff < 0)
-			continue;
-		if (yoff >= src->inheight)
-			continue;
-		uae_u8 *line = src->bufmem + yoff * src->rowbytes;
-		uae_u8 *line_genlock = row_map_genlock[yoff];
-		uae_u8 *dstline = dst->bufmem + (((y * 2 + oddlines) - dst->yoffset) / vdbl) * dst->rowbytes;
-		uae_u8 *vramline = sm_frame_buffer + (fc24_y + oddlines) * SM_VRAM_WIDTH * SM_VRAM_BYTES + bufferoffset;
-		fc24_x = 0;
-		for (x = 0; x < src->inwidth; x++) {
-			uae_u8 r = 0, g = 0, b = 0;
-			uae_u8 *s = line + ((x << 1) / hdbl) * src->pixbytes;
-			uae_u8 *s_genlock = line_genlock + ((x << 1) / hdbl);
-			uae_u8 *d = dstline + ((x << 1) / hdbl) * dst->pixbytes;
-			int fc24_xx = (fc24_x >> fc24_dx) - fc24_xoffset;
-			uae_u8 *vramptr = NULL;
-			if (fc24_xx >= 0 && fc24_xx < fc24_width && fc24_y >= 0 && fc24_y < FC24_MAXHEIGHT) {
-				vramptr = vramline + fc24_xx * SM_VRAM_BYTES;
-				uae_u8 ax = vramptr[0];
-				if (ax & 0x40) {
-					r = MAKEFCOVERLAY(ax >> 4);
-					g = MAKEFCOVERLAY(ax >> 2);
-					b = MAKEFCOVERLAY(ax >> 0);
-				} else {
-					r = vramptr[1];
-					g = vramptr[2];
-					b = vramptr[3];
-				}
-			}
-			if (!(fc24_cr0 & 1) && (!(fc24_cr1 & 1) || (!is_transparent(s_genlock[0])))) {
-				uae_u8 *s2 = s + src->rowbytes;
-				uae_u8 *d2 = d + dst->rowbytes;
-				PUT_AMIGARGB(d, s, d2, s2, dst, xadd, doublelines, false);
-			} else {
-				PUT_PRGB(d, NULL, dst, r, g, b, 0, false, false);
-				if (doublelines) {
-					if (vramptr) {
-						vramptr += SM_VRAM_WIDTH * SM_VRAM_BYTES;
-						uae_u8 ax = vramptr[0];
-						if (ax & 0x40) {
-							r = MAKEFCOVERLAY(ax >> 4);
-							g = MAKEFCOVERLAY(ax >> 2);
-							b = MAKEFCOVERLAY(ax >> 0);
-						} else {
-							r = vramptr[1];
-							g = vramptr[2];
-							b = vramptr[3];
-						}
-					}
-					PUT_PRGB(d + dst->rowbytes, NULL, dst, r, g, b, 0, false, false);
-				}
-			}
-			fc24_x += fc24_xadd;
-		}
-		fc24_y += 2;
+	if (sm_visible_lines(src, oddlines, vdbl, &ystart, &yend)) {
+		f.src = src;
+		f.dst = dst;
+		f.oddlines = oddlines;
+		f.vdbl = vdbl;
+		f.hdbl = hdbl;
+		f.ystart = ystart;
+		f.xadd = xadd;
+		f.fc24_dx = fc24_dx;
+		f.fc24_xadd = fc24_xadd;
+		f.fc24_xoffset = fc24_xoffset;
+		f.bufferoffset = bufferoffset;
+		sm_run_bands(firecracker24_lines, &f, ystart, yend, doublelines, vdbl <= 2, vdbl == 2);
 	}
 
 	dst->nativepositioning = true;
@@ -1724,13 +2026,15 @@ static bool ham_e(struct vidbuffer *src, struct vidbuffer *dst, bool doublelines
 		uae_u8 prev = 0;
 		bool zeroline = true;
 		int oddeven = 0;
+		uae_u8 *bits = sm_get_line_bits(src->inwidth);
+		sm_firgb_line(src, line, bits, src->inwidth, hdbl);
 		for (x = 0; x < src->inwidth; x++) {
 			uae_u8 *s = line + ((x << 1) / hdbl) * src->pixbytes;
 			uae_u8 *s_genlock = line_genlock + ((x << 1) / hdbl);
 			uae_u8 *d = dstline + ((x << 1) / hdbl) * dst->pixbytes;
 			uae_u8 *s2 = s + src->rowbytes;
 			uae_u8 *d2 = d + dst->rowbytes;
-			uae_u8 newval = FIRGB(src, s);
+			uae_u8 newval = bits[x];
 			uae_u8 val = prev | newval;
 
 			if (s_genlock[0])
@@ -2068,10 +2372,75 @@ static bool graffiti(struct vidbuffer *src, struct vidbuffer *dst)
 
 /* A2024 information comes from US patent 4851826 */
 
+struct a2024_frame
+{
+	struct vidbuffer *src, *dst;
+	uae_u8 *srcbuf, *dstbuf;
+	int dbl, panel_width_draw, xchange;
+	bool hires;
+	uae_u8 dpl;
+};
+
+static void a2024_lines(void *data, int band, int first, int last, bool doublelines)
+{
+	struct a2024_frame *f = (struct a2024_frame*)data;
+	struct vidbuffer *src = f->src;
+	struct vidbuffer *dst = f->dst;
+	int dbl = f->dbl;
+	uae_u8 dpl = f->dpl;
+
+	for (int y = first; y < last; y++) {
+		uae_u8 *srcp = f->srcbuf + y * src->rowbytes * dbl;
+		uae_u8 *dstp1 = f->dstbuf + y * dst->rowbytes * dbl;
+		uae_u8 *dstp2 = dstp1 + dst->rowbytes;
+		int x;
+		for (x = 0; x < (f->panel_width_draw * 2) / f->xchange; x++) {
+			uae_u8 c1 = 0, c2 = 0;
+			if (FR(src, srcp)) // R
+				c1 |= 2;
+			if (FG(src, srcp)) // G
+				c2 |= 2;
+			if (FB(src, srcp)) // B
+				c1 |= 1;
+			if (FI(src, srcp)) // I
+				c2 |= 1;
+			if (dpl == 0) {
+				c1 = c2 = 0;
+			} else if (dpl == 1) {
+				c1 &= 1;
+				c1 |= c1 << 1;
+				c2 &= 1;
+				c2 |= c2 << 1;
+			} else if (dpl == 2) {
+				c1 &= 2;
+				c1 |= c1 >> 1;
+				c2 &= 2;
+				c2 |= c2 >> 1;
+			}
+			if (dbl == 1) {
+				c1 = (c1 + c2 + 1) / 2;
+				c1 = (c1 << 6) | (c1 << 4) | (c1 << 2) | (c1 << 0);
+				PRGB(dst, dstp1, c1, c1, c1);
+			} else {
+				c1 = (c1 << 6) | (c1 << 4) | (c1 << 2) | (c1 << 0);
+				c2 = (c2 << 6) | (c2 << 4) | (c2 << 2) | (c2 << 0);
+				PRGB(dst, dstp1, c1, c1, c1);
+				PRGB(dst, dstp2, c2, c2, c2);
+				dstp2 += dst->pixbytes;
+			}
+			srcp += src->pixbytes;
+			if (!f->hires)
+				srcp += src->pixbytes;
+			dstp1 += dst->pixbytes;
+		}
+	}
+}
+
+
 static bool a2024(struct vidbuffer *src, struct vidbuffer *dst)
 {
 	struct vidbuf_description *avidinfo = &adisplays[dst->monitor_id].gfxvidinfo;
-	int y;
+	struct a2024_frame f;
 	uae_u8 *srcbuf, *dstbuf;
 	uae_u8 *dataline;
 	int px, py, doff, pxcnt, dbl;
@@ -2187,57 +2556,16 @@ static bool a2024(struct vidbuffer *src, struct vidbuffer *dst)
 	srcbuf = src->bufmem + (((44 << VRES_MAX) - src->yoffset) / avidinfo->ychange) * src->rowbytes + (((srcxoffset << RES_MAX) - src->xoffset) / avidinfo->xchange) * src->pixbytes;
 	dstbuf = dst->bufmem + py * (panel_height / avidinfo->ychange) * dst->rowbytes + px * ((panel_width * 2) / avidinfo->xchange) * dst->pixbytes;
 
-	for (y = 0; y < (panel_height / (dbl == 1 ? 1 : 2)) / avidinfo->ychange; y++) {
-#if 0
-		memcpy (dstbuf, srcbuf, ((panel_width * 2) / gfxvidinfo.xchange) * dst->pixbytes);
-#else
-		uae_u8 *srcp = srcbuf;
-		uae_u8 *dstp1 = dstbuf;
-		uae_u8 *dstp2 = dstbuf + dst->rowbytes;
-		int x;
-		for (x = 0; x < (panel_width_draw * 2) / avidinfo->xchange; x++) {
-			uae_u8 c1 = 0, c2 = 0;
-			if (FR(src, srcp)) // R
-				c1 |= 2;
-			if (FG(src, srcp)) // G
-				c2 |= 2;
-			if (FB(src, srcp)) // B
-				c1 |= 1;
-			if (FI(src, srcp)) // I
-				c2 |= 1;
-			if (dpl == 0) {
-				c1 = c2 = 0;
-			} else if (dpl == 1) {
-				c1 &= 1;
-				c1 |= c1 << 1;
-				c2 &= 1;
-				c2 |= c2 << 1;
-			} else if (dpl == 2) {
-				c1 &= 2;
-				c1 |= c1 >> 1;
-				c2 &= 2;
-				c2 |= c2 >> 1;
-			}
-			if (dbl == 1) {
-				c1 = (c1 + c2 + 1) / 2;
-				c1 = (c1 << 6) | (c1 << 4) | (c1 << 2) | (c1 << 0);
-				PRGB(dst, dstp1, c1, c1, c1);
-			} else {
-				c1 = (c1 << 6) | (c1 << 4) | (c1 << 2) | (c1 << 0);
-				c2 = (c2 << 6) | (c2 << 4) | (c2 << 2) | (c2 << 0);
-				PRGB(dst, dstp1, c1, c1, c1);
-				PRGB(dst, dstp2, c2, c2, c2);
-				dstp2 += dst->pixbytes;
-			}
-			srcp += src->pixbytes;
-			if (!hires)
-				srcp += src->pixbytes;
-			dstp1 += dst->pixbytes;
-		}
-#endif
-		srcbuf += src->rowbytes * dbl;
-		dstbuf += dst->rowbytes * dbl;
-	}
+	f.src = src;
+	f.dst = dst;
+	f.srcbuf = srcbuf;
+	f.dstbuf = dstbuf;
+	f.dbl = dbl;
+	f.panel_width_draw = panel_width_draw;
+	f.xchange = avidinfo->xchange;
+	f.hires = hires;
+	f.dpl = dpl;
+	sm_run_bands(a2024_lines, &f, 0, (panel_height / (dbl == 1 ? 1 : 2)) / avidinfo->ychange, false, true, false);
 
 	total_width /= 2;
 	total_width <<= currprefs.gfx_resolution;
@@ -2402,11 +2730,116 @@ end:
 	return ok;
 }
 
+/* Noise position and step of each line, the noise is the same as if the
+ * lines had been drawn in order. */
+static uae_u32 genlock_noise_index[MAXVPOS_PAL], genlock_noise_add[MAXVPOS_PAL];
+
+struct genlock_frame
+{
+	struct vidbuffer *src, *dst;
+	int oddlines;
+	uae_u8 *genlock_image;
+	int genlock_image_pixbytes;
+	int genlock_image_red_index, genlock_image_green_index, genlock_image_blue_index;
+	bool genlock_image_upsidedown;
+	int mix1, mix2;
+	uae_u8 amix1, amix2;
+	int deltax, deltay, offsetx, offsety;
+};
+
+static void genlock_lines(void *data, int band, int first, int last, bool doublelines)
+{
+	struct genlock_frame *f = (struct genlock_frame*)data;
+	struct vidbuffer *src = f->src;
+	struct vidbuffer *dst = f->dst;
+	uae_u8 *genlock_image = f->genlock_image;
+	int mix1 = f->mix1, mix2 = f->mix2;
+	int x;
+#ifdef SM_VECTOR
+	bool fast = src->pixbytes == 4 && dst->pixbytes == 4;
+#endif
+
+	for (int y = first; y < last; y++) {
+		int yoff = (y * 2 + f->oddlines) - src->yoffset;
+		uae_u8 *line = src->bufmem + yoff * src->rowbytes;
+		uae_u8 *dstline = dst->bufmem + ((y * 2 + f->oddlines) - dst->yoffset) * dst->rowbytes;
+		uae_u8 *line_genlock = row_map_genlock[yoff];
+		int gy = ((y * 2 + f->oddlines) - src->yoffset - f->offsety) * f->deltay / 65536;
+		if (f->genlock_image_upsidedown)
+			gy = (genlock_image_height - 1) - gy;
+		uae_u8 *image_genlock = genlock_image + gy * genlock_image_pitch;
+		uae_u32 index = genlock_noise_index[y];
+		uae_u32 add = genlock_noise_add[y];
+		uae_u8 r = 0, g = 0, b = 0, a = f->amix1;
+		for (x = 0; x < src->inwidth; x++) {
+			uae_u8 *s = line + x * src->pixbytes;
+			uae_u8 *d = dstline + x * dst->pixbytes;
+			uae_u8 *s_genlock = line_genlock + x;
+			uae_u8 *s2 = s + src->rowbytes;
+			uae_u8 *d2 = d + dst->rowbytes;
+
+#ifdef SM_VECTOR
+			// Four Amiga pixels at once if none of them is transparent
+			if (fast && x + 4 <= src->inwidth) {
+				uae_u32 v;
+				memcpy(&v, s_genlock, 4);
+				if (!((v - 0x01010101) & ~v & 0x80808080)) {
+					sm_vec p;
+					memcpy(&p, s, sizeof p);
+					p |= 0xff000000;
+					memcpy(d, &p, sizeof p);
+					if (doublelines) {
+						memcpy(&p, s2, sizeof p);
+						p |= 0xff000000;
+						memcpy(d2, &p, sizeof p);
+					}
+					x += 3;
+					continue;
+				}
+			}
+#endif
+
+			if (is_transparent(*s_genlock)) {
+				a = f->amix2;
+				if (genlock_error) {
+					r = 0x00;
+					g = 0x00;
+					b = 0xdd;
+				} else if (genlock_blank) {
+					r = g = b = 0;
+				} else if (genlock_image) {
+					int gx = (x - f->offsetx) * f->deltax / 65536;
+					if (gx >= 0 && gx < genlock_image_width && gy >= 0 && gy < genlock_image_height) {
+						uae_u8 *s_genlock_image = image_genlock + gx * f->genlock_image_pixbytes;
+						r = s_genlock_image[f->genlock_image_red_index];
+						g = s_genlock_image[f->genlock_image_green_index];
+						b = s_genlock_image[f->genlock_image_blue_index];
+					} else {
+						r = g = b = 0;
+					}
+				} else {
+					index = (index + add) & 1023;
+					r = g = b = noise_buffer[index];
+				}
+				if (mix2) {
+					r = (mix1 * r + mix2 * FVR(src, s)) / 256;
+					g = (mix1 * g + mix2 * FVG(src, s)) / 256;
+					b = (mix1 * b + mix2 * FVB(src, s)) / 256;
+				}
+				PUT_PRGBA(d, d2, dst, r, g, b, a, 0, doublelines, false);
+			} else {
+				PUT_AMIGARGBA(d, s, d2, s2, dst, 0, doublelines, false);
+			}
+		}
+	}
+}
+
 static bool do_genlock(struct vidbuffer *src, struct vidbuffer *dst, bool doublelines, int oddlines)
 {
 	struct vidbuf_description *avidinfo = &adisplays[dst->monitor_id].gfxvidinfo;
+	struct genlock_frame f;
 
-	int y, x, vdbl, hdbl;
+	int y, vdbl, hdbl;
 	int ystart, yend, isntsc;
 	int mix1 = 0, mix2 = 0;
 
@@ -2587,62 +3020,51 @@ skip:
 		}
 	}
 
-	uae_u8 r = 0, g = 0, b = 0, a = 0;
+	// Valid lines of this field: yoff is not divided by vdbl here
+	int yfirst = -1, ylast = -1;
+	bool noise = !genlock_error && !genlock_blank && !genlock_image;
 	for (y = ystart; y < yend; y++) {
 		int yoff = (y * 2 + oddlines) - src->yoffset;
 		if (yoff < 0)
 			continue;
 		if (yoff >= src->inheight)
 			continue;
-
-		uae_u8 *line = src->bufmem + yoff * src->rowbytes;
-		uae_u8 *dstline = dst->bufmem + ((y * 2 + oddlines) - dst->yoffset) * dst->rowbytes;
-		uae_u8 *line_genlock = row_map_genlock[yoff];
-		int gy = ((y * 2 + oddlines) - src->yoffset - offsety) * deltay / 65536;
-		if (genlock_image_upsidedown)
-			gy = (genlock_image_height - 1) - gy;
-		uae_u8 *image_genlock = genlock_image + gy * genlock_image_pitch;
-		r = g = b;
-		a = amix1;
+		if (yfirst < 0)
+			yfirst = y;
+		ylast = y + 1;
 		noise_add = (quickrand() & 15) | 1;
-		for (x = 0; x < src->inwidth; x++) {
-			uae_u8 *s = line + x * src->pixbytes;
-			uae_u8 *d = dstline + x * dst->pixbytes;
-			uae_u8 *s_genlock = line_genlock + x;
-			uae_u8 *s2 = s + src->rowbytes;
-			uae_u8 *d2 = d + dst->rowbytes;
-
-			if (is_transparent(*s_genlock)) {
-				a = amix2;
-				if (genlock_error) {
-					r = 0x00;
-					g = 0x00;
-					b = 0xdd;
-				} else if (genlock_blank) {
-					r = g = b = 0;
-				} else if (genlock_image) {
-					int gx = (x - offsetx) * deltax / 65536;
-					if (gx >= 0 && gx < genlock_image_width && gy >= 0 && gy < genlock_image_height) {
-						uae_u8 *s_genlock_image = image_genlock + gx * genlock_image_pixbytes;
-						r = s_genlock_image[genlock_image_red_index];
-						g = s_genlock_image[genlock_image_green_index];
-						b = s_genlock_image[genlock_image_blue_index];
-					} else {
-						r = g = b = 0;
-					}
-				} else {
-					r = g = b = get_noise();
-				}
-				if (mix2) {
-					r = (mix1 * r + mix2 * FVR(src, s)) / 256;
-					g = (mix1 * g + mix2 * FVG(src, s)) / 256;
-					b = (mix1 * b + mix2 * FVB(src, s)) / 256;
-				}
-				PUT_PRGBA(d, d2, dst, r, g, b, a, 0, doublelines, false);
-			} else {
-				PUT_AMIGARGBA(d, s, d2, s2, dst, 0, doublelines, false);
+		genlock_noise_add[y] = noise_add;
+		genlock_noise_index[y] = noise_index;
+		if (noise) {
+			uae_u8 *line_genlock = row_map_genlock[yoff];
+			int cnt = 0;
+			for (int x = 0; x < src->inwidth; x++) {
+				if (is_transparent(line_genlock[x]))
+					cnt++;
 			}
-		}
+			noise_index = (noise_index + cnt * noise_add) & 1023;
+		}
+	}
+
+	if (yfirst >= 0) {
+		f.src = src;
+		f.dst = dst;
+		f.oddlines = oddlines;
+		f.genlock_image = genlock_image;
+		f.genlock_image_pixbytes = genlock_image_pixbytes;
+		f.genlock_image_red_index = genlock_image_red_index;
+		f.genlock_image_green_index = genlock_image_green_index;
+		f.genlock_image_blue_index = genlock_image_blue_index;
+		f.genlock_image_upsidedown = genlock_image_upsidedown;
+		f.mix1 = mix1;
+		f.mix2 = mix2;
+		f.amix1 = amix1;
+		f.amix2 = amix2;
+		f.deltax = deltax;
+		f.deltay = deltay;
+		f.offsetx = offsetx;
+		f.offsety = offsety;
+		sm_run_bands(genlock_lines, &f, yfirst, ylast, doublelines, true, false);
 	}
 
 	dst->nativepositioning = true;
@@ -3610,6 +4032,7 @@ bool emulate_specialmonitors_line(struct vidbuffer *src, struct vidbuffer *dst,
 
 void specialmonitor_reset(void)
 {
+	sm_free_bands();
 	if (!currprefs.monitoremu)
 		return;
 	uninitvideograb();
@@ -3617,6 +4040,11 @@ void specialmonitor_reset(void)
 	fc24_reset();
 }
 
+void specialmonitor_free(void)
+{
+	sm_free_bands();
+}
+
 bool specialmonitor_need_genlock(void)
 {
 	switch (currprefs.monitoremu)
@@ -28,6 +28,11 @@
 #define HAVE_MAP_32BIT 1
 #endif
 
+#if !defined(_WIN32) && defined(HAVE_SIGACTION)
+#define USE_WRITE_WATCH 1
+#include <signal.h>
+#endif
+
 // #define CLEAR_MEMORY_ON_COMMIT
 
 // #define LOG_ALLOCATIONS
@@ -306,9 +311,18 @@ static bool do_free(void *address, int size)
 	return true;
 }
 
+#ifdef USE_WRITE_WATCH
+static void remove_write_watches(void *address, uae_u32 size);
+#else
+static void remove_write_watches(void *address, uae_u32 size)
+{
+}
+#endif
+
 bool uae_vm_free(void *address, int size)
 {
 	uae_log("VM: Free     0x%-8x bytes at %p\n", size, address);
+	remove_write_watches(address, size);
 	return do_free(address, size);
 }
 
@@ -427,6 +441,7 @@ void *uae_vm_commit(void *address, uae_u32 size, int protect)
 {
 	uae_log("VM: Commit   0x%-8x bytes at %p (%s)\n",
 			size, address, protect_description(protect));
+	remove_write_watches(address, size);
 #ifdef _WIN32
 	int va_type = MEM_COMMIT ;
 	int va_protect = protect_to_native(protect);
@@ -444,6 +459,7 @@ void *uae_vm_commit(void *address, uae_u32 size, int protect)
 bool uae_vm_decommit(void *address, uae_u32 size)
 {
 	uae_log("VM: Decommit 0x%-8x bytes at %p\n", size, address);
+	remove_write_watches(address, size);
 #ifdef _WIN32
 	return VirtualFree (address, size, MEM_DECOMMIT) != 0;
 #else
@@ -460,3 +476,370 @@ bool uae_vm_decommit(void *address, uae_u32 size)
     return result != MAP_FAILED;
 #endif
 }
+
+/* Write watch, a replacement for Windows' GetWriteWatch. Watched pages are
+ * made read-only; the first write to a page faults, the fault handler
+ * marks the page as dirty and makes it writable again. This also catches
+ * writes from JIT-compiled code, which bypasses the memory bank functions.
+ * System calls writing to a watched page fail with EFAULT instead of
+ * faulting, so every host call that writes directly into Amiga memory
+ * (my_read, my_pread, zfile_fread and the bsdsocket recv) is wrapped in
+ * uae_vm_write_watch_touch and uae_vm_write_watch_untouch, which keep
+ * the pages writable meanwhile. Only RTG VRAM is watched. */
+
+#ifdef USE_WRITE_WATCH
+
+#define MAX_WRITE_WATCHES 8
+
+struct write_watch {
+	uae_u8 *volatile address;
+	uae_u32 size;
+	int pages;
+	volatile uae_u8 *dirty;
+	/* Number of calls to skip re-protecting mostly dirty ranges */
+	int skip;
+	/* System calls writing to the watched memory in progress, the pages
+	 * are not re-protected while there are any */
+	int busy;
+};
+
+static struct write_watch write_watches[MAX_WRITE_WATCHES];
+/* Set before the handler is installed, the handler must not call
+ * uae_vm_page_size (sysconf is not async-signal-safe) */
+static int write_watch_page_size;
+/* Orders touch / untouch against re-protecting pages, host I/O threads and
+ * the emulation thread both use the watches */
+static volatile int write_watch_lock;
+
+static void lock_write_watches(void)
+{
+	while (__sync_lock_test_and_set(&write_watch_lock, 1)) {
+		while (write_watch_lock) {
+		}
+	}
+}
+
+static void unlock_write_watches(void)
+{
+	__sync_lock_release(&write_watch_lock);
+}
+static struct sigaction write_watch_old_segv;
+#ifdef MACOSX
+static struct sigaction write_watch_old_bus;
+#endif
+
+static void write_watch_handler(int signum, siginfo_t *info, void *context)
+{
+	uae_u8 *a = (uae_u8 *) info->si_addr;
+	int page_size = write_watch_page_size;
+	for (int i = 0; i < MAX_WRITE_WATCHES; i++) {
+		struct write_watch *w = write_watches + i;
+		uae_u8 *address = w->address;
+		if (address && a >= address && a < address + w->size) {
+			int page = (a - address) / page_size;
+			w->dirty[page] = 1;
+			mprotect(address + page * page_size, page_size,
+					 PROT_READ | PROT_WRITE);
+			return;
+		}
+	}
+	struct sigaction *old = &write_watch_old_segv;
+#ifdef MACOSX
+	if (signum == SIGBUS) {
+		old = &write_watch_old_bus;
+	}
+#endif
+	if (old->sa_flags & SA_SIGINFO) {
+		old->sa_sigaction(signum, info, context);
+	} else if (old->sa_handler != SIG_DFL && old->sa_handler != SIG_IGN) {
+		old->sa_handler(signum);
+	} else {
+		/* The faulting instruction is restarted and gets the default
+		 * action (i.e. crash) now. */
+		signal(signum, SIG_DFL);
+	}
+}
+
+static void install_write_watch_handler(int signum, struct sigaction *old)
+{
+	struct sigaction current;
+	sigaction(signum, NULL, &current);
+	if ((current.sa_flags & SA_SIGINFO) &&
+			current.sa_sigaction == write_watch_handler) {
+		return;
+	}
+	/* Not installed yet, or replaced (e.g. by the JIT) since then. Chain
+	 * to the current handler for faults outside watched memory. */
+	struct sigaction act;
+	memset(&act, 0, sizeof(act));
+	act.sa_sigaction = write_watch_handler;
+	sigemptyset(&act.sa_mask);
+	act.sa_flags = SA_SIGINFO;
+	sigaction(signum, &act, old);
+}
+
+static void install_write_watch_handlers(void)
+{
+	install_write_watch_handler(SIGSEGV, &write_watch_old_segv);
+#ifdef MACOSX
+	install_write_watch_handler(SIGBUS, &write_watch_old_bus);
+#endif
+}
+
+static struct write_watch *find_write_watch(void *address)
+{
+	uae_u8 *a = (uae_u8 *) address;
+	for (int i = 0; i < MAX_WRITE_WATCHES; i++) {
+		struct write_watch *w = write_watches + i;
+		if (w->address && a >= w->address && a < w->address + w->size) {
+			return w;
+		}
+	}
+	return NULL;
+}
+
+static void remove_write_watch(struct write_watch *w)
+{
+	mprotect(w->address, w->size, PROT_READ | PROT_WRITE);
+	volatile uae_u8 *dirty = w->dirty;
+	w->address = NULL;
+	__sync_synchronize();
+	w->dirty = NULL;
+	xfree((void *) dirty);
+}
+
+static void remove_write_watches(void *address, uae_u32 size)
+{
+	uae_u8 *a = (uae_u8 *) address;
+	for (int i = 0; i < MAX_WRITE_WATCHES; i++) {
+		struct write_watch *w = write_watches + i;
+		if (w->address && a < w->address + w->size && a + size > w->address) {
+			uae_log("VM: Removing write watch at %p\n", w->address);
+			remove_write_watch(w);
+		}
+	}
+}
+
+/* Clip address / size to the watched region and convert to page range */
+static bool write_watch_range(struct write_watch *w, void *address, int size,
+							  int *first, int *last)
+{
+	int page_size = uae_vm_page_size();
+	uae_u8 *a = (uae_u8 *) address;
+	uae_u8 *end = a + size;
+	if (end > w->address + w->size) {
+		end = w->address + w->size;
+	}
+	if (end <= a) {
+		return false;
+	}
+	*first = (a - w->address) / page_size;
+	*last = (end - w->address + page_size - 1) / page_size;
+	return true;
+}
+
+static void protect_pages(struct write_watch *w, int first, int last)
+{
+	int page_size = uae_vm_page_size();
+	mprotect(w->address + first * page_size, (last - first) * page_size,
+			 PROT_READ);
+}
+
+#endif /* USE_WRITE_WATCH */
+
+bool uae_vm_write_watch_enable(void *address, uae_u32 size)
+{
+#ifdef USE_WRITE_WATCH
+	int page_size = uae_vm_page_size();
+	if ((uintptr_t) address % page_size != 0) {
+		return false;
+	}
+	write_watch_page_size = page_size;
+	size = (size + page_size - 1) & ~(page_size - 1);
+	struct write_watch *w = find_write_watch(address);
+	if (w && w->address == address && w->size == size) {
+		install_write_watch_handlers();
+		return true;
+	}
+	remove_write_watches(address, size);
+	for (int i = 0; i < MAX_WRITE_WATCHES; i++) {
+		w = write_watches + i;
+		if (w->address == NULL) {
+			break;
+		}
+		w = NULL;
+	}
+	if (w == NULL) {
+		uae_log("VM: Too many write watches\n");
+		return false;
+	}
+	uae_log("VM: Write watch  0x%-8x bytes at %p\n", size, address);
+	w->pages = size / page_size;
+	w->size = size;
+	/* Start with all pages dirty and writable, they are protected when
+	 * the caller first reads and resets the dirty state. */
+	w->dirty = xmalloc(uae_u8, w->pages);
+	memset((void *) w->dirty, 1, w->pages);
+	w->skip = 1;
+	w->busy = 0;
+	install_write_watch_handlers();
+	__sync_synchronize();
+	w->address = (uae_u8 *) address;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void uae_vm_write_watch_disable(void *address)
+{
+#ifdef USE_WRITE_WATCH
+	struct write_watch *w = find_write_watch(address);
+	if (w) {
+		remove_write_watch(w);
+	}
+#endif
+}
+
+bool uae_vm_write_watch_get(void *address, int size, void **addresses,
+							uintptr_t *count, bool reset)
+{
+#ifdef USE_WRITE_WATCH
+	struct write_watch *w = find_write_watch(address);
+	int first, last;
+	if (w == NULL || !write_watch_range(w, address, size, &first, &last)) {
+		return false;
+	}
+	install_write_watch_handlers();
+	int page_size = uae_vm_page_size();
+	uintptr_t n = 0;
+	for (int i = first; i < last && n < *count; i++) {
+		if (w->dirty[i]) {
+			addresses[n++] = w->address + i * page_size;
+		}
+	}
+	*count = n;
+	if (!reset) {
+		return true;
+	}
+	if (w->skip > 0) {
+		/* Leave the pages dirty and writable for now */
+		if (--w->skip > 0) {
+			return true;
+		}
+	} else if (n >= (uintptr_t) (last - first) * 3 / 4) {
+		/* Nearly everything changes (e.g. animation or video playback).
+		 * Faulting on every page each frame costs more than it saves, so
+		 * stop watching the dirty pages for a while. */
+		w->skip = 25;
+		return true;
+	}
+	lock_write_watches();
+	if (w->busy) {
+		/* Host I/O into the range is in progress, keep the pages dirty
+		 * and writable until it has finished */
+		unlock_write_watches();
+		return true;
+	}
+	/* Clear the dirty state before protecting, so writes in between are
+	 * not lost (the caller copies the pages after this returns). */
+	int run = -1;
+	for (int i = first; i < last; i++) {
+		if (w->dirty[i]) {
+			w->dirty[i] = 0;
+			if (run < 0) {
+				run = i;
+			}
+		} else if (run >= 0) {
+			protect_pages(w, run, i);
+			run = -1;
+		}
+	}
+	if (run >= 0) {
+		protect_pages(w, run, last);
+	}
+	unlock_write_watches();
+	return true;
+#else
+	return false;
+#endif
+}
+
+void uae_vm_write_watch_reset(void *address, int size)
+{
+#ifdef USE_WRITE_WATCH
+	struct write_watch *w = find_write_watch(address);
+	int first, last;
+	if (w == NULL || !write_watch_range(w, address, size, &first, &last)) {
+		return;
+	}
+	install_write_watch_handlers();
+	lock_write_watches();
+	if (!w->busy) {
+		for (int i = first; i < last; i++) {
+			w->dirty[i] = 0;
+		}
+		w->skip = 0;
+		protect_pages(w, first, last);
+	}
+	unlock_write_watches();
+#endif
+}
+
+bool uae_vm_write_watch_touch(void *address, int size)
+{
+#ifdef USE_WRITE_WATCH
+	bool touched = false;
+	uae_u8 *a = (uae_u8 *) address;
+	if (size <= 0) {
+		return false;
+	}
+	lock_write_watches();
+	for (int i = 0; i < MAX_WRITE_WATCHES; i++) {
+		struct write_watch *w = write_watches + i;
+		int first, last;
+		if (w->address == NULL || a + size <= w->address ||
+				a >= w->address + w->size) {
+			continue;
+		}
+		uae_u8 *start = a > w->address ? a : w->address;
+		if (!write_watch_range(w, start, a + size - start, &first, &last)) {
+			continue;
+		}
+		int page_size = uae_vm_page_size();
+		for (int j = first; j < last; j++) {
+			w->dirty[j] = 1;
+		}
+		mprotect(w->address + first * page_size,
+				 (last - first) * page_size, PROT_READ | PROT_WRITE);
+		w->busy++;
+		touched = true;
+	}
+	unlock_write_watches();
+	return touched;
+#else
+	return false;
+#endif
+}
+
+void uae_vm_write_watch_untouch(void *address, int size)
+{
+#ifdef USE_WRITE_WATCH
+	uae_u8 *a = (uae_u8 *) address;
+	if (size <= 0) {
+		return;
+	}
+	lock_write_watches();
+	for (int i = 0; i < MAX_WRITE_WATCHES; i++) {
+		struct write_watch *w = write_watches + i;
+		if (w->address == NULL || a + size <= w->address ||
+				a >= w->address + w->size) {
+			continue;
+		}
+		if (w->busy > 0) {
+			w->busy--;
+		}
+	}
+	unlock_write_watches();
+#endif
+}
@@ -32,6 +32,7 @@
 #ifdef FSUAE // NL
 #include "uae/fs.h"
 #include "uae/glib.h"
+#include "uae/vm.h"
 #include <fs/data.h>
 #undef _WIN32
 #endif
@@ -2274,7 +2275,16 @@ size_t zfile_fread  (void *b, size_t l1, size_t l2, struct zfile *z)
 		z->seek = v + l1 * ret;
 		return ret;
 	}
+#ifdef FSUAE
+	/* fread may read directly into b, which fails for write-watched
+	 * (RTG) memory */
+	uae_vm_write_watch_touch (b, l1 * l2);
+	size_t ret = fread (b, l1, l2, z->f);
+	uae_vm_write_watch_untouch (b, l1 * l2);
+	return ret;
+#else
 	return fread (b, l1, l2, z->f);
+#endif
 }
 
 size_t zfile_fwrite (const void *b, size_t l1, size_t l2, struct zfile *z)